@@ -21,15 +21,118 @@
 
 #ifndef _HAPROXY_RATE_LIMIT_H
 #define _HAPROXY_RATE_LIMIT_H
+#include <netinet/in.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 typedef enum { RL_UPLOAD, RL_DOWNLOAD } DataDirection;
 typedef enum { RL_THROTTLE, RL_NO_THROTTLE } ThrottleFlag;
-void rl_request_end(struct sockaddr_in* addr_in);
-int rl_speed_throttle(struct sockaddr_in* addr_in, DataDirection data_direction);
-void rl_data_transferred(struct sockaddr_in* addr_in, DataDirection data_direction, unsigned int done);
+
+// The longest access key (including its null-terminator) that we track connections for. set_ip_port_key() refuses
+// longer keys, so their bandwidth is neither limited nor reported.
+#define RL_MAX_KEY_LEN 256
+
+// A user's speed throttling policy for one direction, as received from the violation feed
+typedef struct {
+    uint32_t throttle;                /* 0: no, >0: yes */
+    uint32_t num_active_connections;  /* user's active conns when the this violation record found */
+    uint32_t received_epoch_sec;
+    float diff_ratio;
+    uint64_t elapsed_usec_in_the_epoch;
+    uint64_t allowed_run_time_usec;
+    float previous_diff_ratio;
+} speed_hash_value_t;
+
+// The identity of a connection: its source address and port. IPv4 addresses are held as IPv4-mapped IPv6 addresses
+// (::ffff:a.b.c.d), so that connections of either family share the same tables, without a slower path for IPv6.
+typedef struct {
+    uint64_t addr_hi; // the first 8 bytes of the address, in host order
+    uint64_t addr_lo; // the last 8 bytes
+    uint16_t port;
+} rl_conn_id_t;
+
+// The longest "<ipv4>:<port>" or "[<ipv6>]:<port>" string (including its null-terminator) of rl_format_conn()
+#define RL_CONN_STR_LEN (46 + 2 + 6 + 1)
+
+// What a stream last looked up about its connection: its access key and that key's policies. Each is reused for as
+// long as the generation of the map shard it was read from is unchanged, so that in the common case of a connection
+// whose user isn't being throttled, rl_speed_throttle() and rl_data_transferred() need neither a hash lookup nor a
+// lock. Must be zero-initialised before its first use.
+struct rl_conn_cache {
+    rl_conn_id_t conn_id;
+    uint64_t key_generation;
+    uint64_t policy_generation[2]; // indexed by DataDirection
+    int policy_exists[2];
+    speed_hash_value_t policy[2];
+    char access_key[RL_MAX_KEY_LEN];
+};
+
+// Fills <out> (of RL_CONN_STR_LEN bytes) with the address and port of <addr>, an AF_INET or AF_INET6 address, for logs
+const char* rl_format_conn(const struct sockaddr_storage* addr, char* out);
+void rl_request_end(const struct sockaddr_storage* addr);
+// Returns RL_THROTTLE if the connection mustn't send any data for now. Otherwise, <jitter_ms> (if not NULL) is set to
+// how long to wait before sending, to spread out the connections of a user that is close to their limit.
+int rl_speed_throttle(const struct sockaddr_storage* addr, DataDirection data_direction, struct rl_conn_cache* cache,
+                      uint32_t* jitter_ms);
+struct rl_telemetry;
+// <trace_send_usec> stamps the data_xfer message for latency tracing, unless it is 0
+// <telemetry> is where the data_xfer message is sent as a binary record, if it is open, see rl_telemetry_open()
+void rl_data_transferred(const struct rl_telemetry* telemetry, const struct sockaddr_storage* addr,
+                         DataDirection data_direction, unsigned int done, uint64_t trace_send_usec,
+                         struct rl_conn_cache* cache);
+// The two halves of rl_data_transferred(), for callers that sum up the transfers of a user before reporting them.
+// rl_conn_access_key() returns the connection's access key (valid until the cache is next refreshed), or NULL if it
+// hasn't got one; <data_direction> and <done> are only for its debug log.
+// rl_emit_data_xfer() sends one data_xfer message; <addr> is only for the request key of the text message.
+const char* rl_conn_access_key(const struct sockaddr_storage* addr, DataDirection data_direction, unsigned int done,
+                               struct rl_conn_cache* cache);
+void rl_emit_data_xfer(const struct rl_telemetry* telemetry, const struct sockaddr_storage* addr,
+                       const char* access_key, DataDirection data_direction, unsigned int done,
+                       uint64_t trace_send_usec);
 void set_jitter_range(uint32_t range);
 void set_throttle_epoch_us(const char* key, uint64_t epoch_us, DataDirection data_direction, float diff_ratio);
 void set_ip_port_key(const char* ip, const char* port, const char* key);
 void init_speed_epoch_hashmaps();
 void print_out_key_speed_table(DataDirection data_direction);
+
+// The weir filter's control messages can be sent to the syslog server as compact binary records over a UDP socket of
+// their own, rather than formatted as text and sent through HAProxy's logging, see docs/syslog-server-api.md
+enum {
+    RL_TELEMETRY_REQ_START = 1,
+    RL_TELEMETRY_REQ_END = 2,
+    RL_TELEMETRY_DATA_XFER = 3,
+    RL_TELEMETRY_ACTIVE_REQS = 4,
+};
+
+// One control message. The strings are sent in the order below, skipping those that are NULL, which are the ones
+// that its type doesn't have: a req has a verb, instance id and request class (which may be empty), a req_end or
+// active_reqs only an instance id and a data_xfer none.
+struct rl_telemetry_record {
+    uint8_t type;
+    DataDirection direction;
+    int32_t value;            // the active requests, or for a data_xfer the number of bytes transferred
+    uint64_t trace_send_usec; // stamps the message for latency tracing, unless it is 0
+    const char* user_key;
+    const char* verb;
+    const char* instance_id;
+    const char* request_class;
+};
+
+// Where the binary records of a weir filter are sent. Each filter has its own, so that the frontends of an HAProxy
+// instance can report to different syslog servers, or only some of them with binary records.
+// Set up while parsing the configuration, before any thread sends a record, and unchanged afterwards.
+struct rl_telemetry {
+    int fd; // -1 while binary records aren't enabled
+    struct sockaddr_in addr;
+};
+
+// Set up <telemetry> to send no binary records
+void rl_telemetry_init(struct rl_telemetry* telemetry);
+// Send control messages as binary records to <target>, an "<ipv4>:<port>" address, instead of any previous target.
+// Returns 0 on success, or -1 with errno set.
+int rl_telemetry_open(struct rl_telemetry* telemetry, const char* target);
+void rl_telemetry_close(struct rl_telemetry* telemetry);
+// Returns 1 if <record> was sent as a binary record, or 0 if binary records aren't enabled or one of its strings is
+// too long for them, in which case the caller should log it as text instead.
+int rl_telemetry_send(const struct rl_telemetry* telemetry, const struct rl_telemetry_record* record);
 #endif
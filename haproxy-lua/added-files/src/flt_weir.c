@@ -10,6 +10,7 @@
  *
  */
 #include <ctype.h>
+#include <errno.h>
 #include <stdbool.h>
 
 #include <haproxy/api.h>
@@ -37,16 +38,26 @@
 const char* weir_flt_id = "weir bandwidth limitation filter";
 const int USERMAP_CLEANUP_INTERVAL_MS = 30000;
 const int USERMAP_CLEANUP_MIN_MS_SINCE_DISCONNECT = 5000;
+// Each request admitted while a clean-up of the user-limit table is due checks this many of its buckets, so that the
+// clean-up is spread over many requests rather than stalling one of them (and every other under the lock)
+const khint_t USERMAP_CLEANUP_BUCKETS_PER_REQUEST = 64;
 const unsigned int DEFAULT_REFRESH_INTERVAL_MS = 10000;
 const unsigned int DEFAULT_UNKNOWN_USER_LIMIT =
     10 * 1024 * 1024; // Default to a 10Mbps limit when we've not received a limit for a user
 const unsigned int DEFAULT_MINIMUM_BANDWIDTH_LIMIT = 16 * 1024;
+// The token bucket counts the streams sending data for a user over periods of this length, see
+// apply_token_bucket_limit()
+const unsigned int TOKEN_BUCKET_SENDER_PERIOD_MS = 20;
+// The token bucket doesn't split its tokens into grants smaller than this, to keep the number of calls down
+const unsigned int TOKEN_BUCKET_MIN_GRANT = 1024;
 
 // These need to be `#define`s rather than `const int`s to be allowed to use the result as an array length
 #define MAX_PORT_STRING_LENGTH 5 // The largest valid port number is ~65k, or 5 decimal characters
 #define INSTANCE_ID_EXTRA_BUFFER_CAPACITY                                                                              \
     2 // Allow for a separator char (between hostname and port), plus a null-terminator
 #define MAX_INSTANCE_ID_LENGTH (MAX_HOSTNAME_LEN + MAX_PORT_STRING_LENGTH + INSTANCE_ID_EXTRA_BUFFER_CAPACITY)
+// The trace field appended to sampled messages: a delimiter, a 64-bit decimal number and a null-terminator
+#define TRACE_FIELD_LENGTH (3 + 20 + 1)
 
 // Simple wrapper around BUG_ON that also logs the failure to the log file.
 // This is useful to get debug info in easily accessible place like the log file
@@ -65,23 +76,60 @@ struct user_direction_limit {
 
     struct freq_ctr counter;
 
+    // Only ever accessed atomically, so that requests starting and ending needn't take the state lock for writing
     int active_requests;
 
     // The next tick at which we're allowed to emit a log about the user exceeding their limit
     unsigned int next_throttle_log_tick;
+
+    // The token bucket that paces the user's streams with the filter's `bandwidth-burst` option, see
+    // apply_token_bucket_limit()
+    __decl_thread(HA_SPINLOCK_T bucket_lock);
+    bool bucket_started;
+    int64_t bucket_tokens;
+    unsigned int bucket_refill_ms;
+    // What the time since <bucket_refill_ms> was worth beyond <bucket_tokens>, in thousandths of a token
+    uint64_t bucket_token_fraction;
+    // The streams that have asked the bucket for tokens during the current and the previous sender periods
+    unsigned int sender_period;
+    int senders;
+    int previous_senders;
 };
 
 struct user_limit {
     struct user_direction_limit upload;
     struct user_direction_limit download;
-    unsigned int last_request_end_tick;
+    unsigned int last_request_end_tick; // Likewise atomic
 };
 KHASH_MAP_INIT_STR(user_limit_hashtable_type, struct user_limit*)
 
+// The bytes that a user has transferred in one direction on this thread, which haven't been reported yet
+struct data_xfer_total {
+    uint64_t bytes;
+    // The stamp of the first of those transfers that was sampled for latency tracing, or 0
+    uint64_t trace_send_usec;
+    // The connection of the last of those transfers, for the (deprecated) request key of text messages
+    struct sockaddr_storage addr;
+};
+
+struct user_data_xfer {
+    struct data_xfer_total direction[2]; // indexed by DataDirection
+};
+KHASH_MAP_INIT_STR(data_xfer_hashtable_type, struct user_data_xfer)
+
+// Each thread sums up the transfers of a filter's streams by user, and has a task of its own to report them, so that
+// neither needs a lock. Both are created by the first transfer that the thread sees for the filter.
+struct data_xfer_thread {
+    khash_t(data_xfer_hashtable_type) * totals;
+    struct task* flush_task;
+};
+
 struct weir_filter_config {
     khash_t(user_limit_hashtable_type) * user_limit_state;
     HA_RWLOCK_T state_lock;
     int next_cleanup_tick;
+    // The bucket of user_limit_state that the clean-up carries on from
+    khint_t next_cleanup_bucket;
 
     struct task* refresh_task;
     int refresh_interval_ms;
@@ -89,10 +137,26 @@ struct weir_filter_config {
     unsigned int unknown_user_limit;
     unsigned int minimum_limit;
     char instance_id[MAX_INSTANCE_ID_LENGTH];
+
+    // One in this many req/data_xfer messages is stamped with the time it was sent, for latency tracing. 0 disables.
+    unsigned int trace_sample_rate;
+
+    // How often each thread reports the data its users have transferred, see add_data_xfer(). 0 reports every chunk
+    // as it is forwarded.
+    unsigned int data_xfer_flush_interval_ms;
+    // Indexed by thread id, with MAX_THREADS entries, or NULL without a flush interval
+    struct data_xfer_thread* data_xfer_threads;
+
+    // How much of its limit-share a user may send in a burst, in milliseconds-worth. 0 disables the local pacing of
+    // streams by apply_token_bucket_limit().
+    unsigned int bandwidth_burst_ms;
+
+    // Where this filter's control messages are sent as binary records, if its binary-telemetry option is set
+    struct rl_telemetry telemetry;
 };
 
 struct weir_lim_state {
-    struct sockaddr_in* remote_addr;
+    struct sockaddr_storage* remote_addr; // Either an IPv4 or an IPv6 address
 
     // To avoid having to look up the relevant hashtable entry every time, we store a pointer here instead.
     // This works because the hashtable itself stores pointers (rather than values), so we don't have to worry
@@ -102,10 +166,18 @@ struct weir_lim_state {
     // for that user has ended (at which point all filters for that user are gone).
     struct user_limit* limit;
 
+    // Likewise, the connection's access key and speed policies, which are only looked up again when they may have
+    // changed, see struct rl_conn_cache
+    struct rl_conn_cache rl_cache;
+
     char* limit_key;
     char* request_class;
     char* bandwidth_limit_direction;
     unsigned int next_allowed_send_tick;
+    // The sender period of its user's token bucket that the stream was last counted in, plus one (0 if never)
+    unsigned int bucket_sender_period;
+    // Whether the data waiting to be forwarded has already been deferred by the throttling jitter
+    bool jitter_served;
     bool enabled;
     bool headers_processed;
 };
@@ -116,32 +188,37 @@ DECLARE_STATIC_POOL(pool_head_weir_user_limit, "user_limit", sizeof(struct user_
 
 struct weir_filter_config* g_filter = NULL;
 
-int weir_ingest_limit_share_update(uint64_t timestamp, const char* user_key, const char* instance_id,
-                                   const char* direction, uint64_t new_limit_share) {
+static struct user_limit* new_user_limit() {
+    struct user_limit* user_limit = pool_zalloc(pool_head_weir_user_limit);
+
+    WEIR_BUG_ON(user_limit == NULL);
+    HA_SPIN_INIT(&user_limit->upload.bucket_lock);
+    HA_SPIN_INIT(&user_limit->download.bucket_lock);
+    return user_limit;
+}
+
+static void free_user_limit(struct user_limit* user_limit) {
+    HA_SPIN_DESTROY(&user_limit->upload.bucket_lock);
+    HA_SPIN_DESTROY(&user_limit->download.bucket_lock);
+    pool_free(pool_head_weir_user_limit, user_limit);
+}
+
+/* Applies a limit-share update for this instance. Must be called with the state lock held for writing. */
+static void apply_limit_share_update(struct weir_filter_config* conf, uint64_t timestamp, const char* user_key,
+                                     const char* direction, uint64_t new_limit_share) {
     khint_t iter;
     struct user_limit* user_limit = NULL;
 
-    if (g_filter == NULL) {
-        return 0;
-    }
-    if (strcmp(g_filter->instance_id, instance_id) != 0) {
-        return 0;
-    }
-    send_log(NULL, LOG_DEBUG, "Received a weir limit-share update for user %s/%s: %lubps = %lumbps", user_key,
-             direction, new_limit_share, new_limit_share / (1024 * 1024));
-
-    HA_RWLOCK_WRLOCK(OTHER_LOCK, &g_filter->state_lock);
-    iter = kh_get(user_limit_hashtable_type, g_filter->user_limit_state, user_key);
-    if (iter == kh_end(g_filter->user_limit_state)) {
+    iter = kh_get(user_limit_hashtable_type, conf->user_limit_state, user_key);
+    if (iter == kh_end(conf->user_limit_state)) {
         int insert_result;
         char* key_duplicate = strdup(user_key); // Freed when the entry is removed from the hashtable
 
-        user_limit = pool_zalloc(pool_head_weir_user_limit);
-        WEIR_BUG_ON(user_limit == NULL);
-        iter = kh_put(user_limit_hashtable_type, g_filter->user_limit_state, key_duplicate, &insert_result);
-        kh_value(g_filter->user_limit_state, iter) = user_limit;
+        user_limit = new_user_limit();
+        iter = kh_put(user_limit_hashtable_type, conf->user_limit_state, key_duplicate, &insert_result);
+        kh_value(conf->user_limit_state, iter) = user_limit;
     } else {
-        user_limit = kh_value(g_filter->user_limit_state, iter);
+        user_limit = kh_value(conf->user_limit_state, iter);
     }
 
     // The freq_ctr that we use, which accurately handles all of the abstract rate-limiting logic
@@ -176,11 +253,82 @@ int weir_ingest_limit_share_update(uint64_t timestamp, const char* user_key, con
     } else {
         send_log(NULL, LOG_WARNING, "Received a weir limit-share update with unrecognised direction '%s'\n", direction);
     }
+}
+
+int weir_ingest_limit_share_update(uint64_t timestamp, const char* user_key, const char* instance_id,
+                                   const char* direction, uint64_t new_limit_share) {
+    if (g_filter == NULL) {
+        return 0;
+    }
+    if (strcmp(g_filter->instance_id, instance_id) != 0) {
+        return 0;
+    }
+    send_log(NULL, LOG_DEBUG, "Received a weir limit-share update for user %s/%s: %lubps = %lumbps", user_key,
+             direction, new_limit_share, new_limit_share / (1024 * 1024));
+
+    HA_RWLOCK_WRLOCK(OTHER_LOCK, &g_filter->state_lock);
+    apply_limit_share_update(g_filter, timestamp, user_key, direction, new_limit_share);
     HA_RWLOCK_WRUNLOCK(OTHER_LOCK, &g_filter->state_lock);
 
     return 1;
 }
 
+/* Parses one line of a batch of limit-share updates, in the format that polygen sends to the ingest_policies Lua
+ * service: "<timestamp>,<user key>,<instance ID>_<direction>_<limit share>,...", and applies the updates for this
+ * instance, adding their number to <applied>. <line> is split up in place. Returns false if the line is invalid, in
+ * which case the updates before the invalid one have still been applied. Must be called with the state lock held for
+ * writing.
+ */
+static bool ingest_limit_share_line(struct weir_filter_config* conf, char* line, int* applied) {
+    uint64_t timestamp = 0;
+    char* end = NULL;
+    char* user_key = NULL;
+    char* share = NULL;
+    char* next_share = NULL;
+
+    timestamp = strtoull(line, &end, 10);
+    if ((end == line) || (*end != ',')) {
+        return false;
+    }
+    user_key = end + 1;
+    share = strchr(user_key, ',');
+    if (share == NULL) {
+        return false;
+    }
+    *share++ = '\0';
+
+    for (; share != NULL; share = next_share) {
+        char* direction = NULL;
+        char* limit = NULL;
+        uint64_t new_limit_share = 0;
+
+        next_share = strchr(share, ',');
+        if (next_share != NULL) {
+            *next_share++ = '\0';
+        }
+        direction = strchr(share, '_');
+        if (direction == NULL) {
+            return false;
+        }
+        *direction++ = '\0';
+        limit = strchr(direction, '_');
+        if (limit == NULL) {
+            return false;
+        }
+        *limit++ = '\0';
+        new_limit_share = strtoull(limit, &end, 10);
+        if ((end == limit) || (*end != '\0')) {
+            return false;
+        }
+
+        if (strcmp(share, conf->instance_id) == 0) {
+            apply_limit_share_update(conf, timestamp, user_key, direction, new_limit_share);
+            (*applied)++;
+        }
+    }
+    return true;
+}
+
 /***************************************************************************
  * Hooks that manage the filter lifecycle (init/check/deinit)
  **************************************************************************/
@@ -196,6 +344,24 @@ static void weir_deinit(struct proxy* px, struct flt_conf* fconf) {
     if (conf != NULL) {
         kh_destroy(user_limit_hashtable_type, conf->user_limit_state);
         HA_RWLOCK_DESTROY(&conf->state_lock);
+        rl_telemetry_close(&conf->telemetry);
+        if (conf->data_xfer_threads != NULL) {
+            for (int i = 0; i < MAX_THREADS; i++) {
+                struct data_xfer_thread* thread = &conf->data_xfer_threads[i];
+
+                if (thread->totals != NULL) {
+                    // The user keys were strdup'd by get_data_xfer_total()
+                    for (khint_t iter = kh_begin(thread->totals); iter != kh_end(thread->totals); iter++) {
+                        if (kh_exist(thread->totals, iter)) {
+                            free((char*)kh_key(thread->totals, iter));
+                        }
+                    }
+                    kh_destroy(data_xfer_hashtable_type, thread->totals);
+                }
+                task_destroy(thread->flush_task);
+            }
+            ha_free(&conf->data_xfer_threads);
+        }
         ha_free(&fconf->conf);
     }
 }
@@ -236,6 +402,11 @@ static DataDirection verb_direction(enum http_meth_t method) {
     }
 }
 
+// The direction of a stream's bandwidth limit, which activate_weir_limit() has checked is either "up" or "dwn"
+static DataDirection limit_direction(const struct weir_lim_state* st) {
+    return (strcmp(st->bandwidth_limit_direction, "dwn") == 0) ? RL_DOWNLOAD : RL_UPLOAD;
+}
+
 static const char* direction_name(DataDirection direction) {
     switch (direction) {
     case RL_UPLOAD:
@@ -247,6 +418,193 @@ static const char* direction_name(DataDirection direction) {
     return "unknown";
 }
 
+/* Returns the stamp for the next req/data_xfer message: either 0, or if this message is sampled for latency tracing
+ * then the current time in microseconds on the monotonic clock. The syslog server compares that to its own clock to
+ * see how long the message took to reach each stage of its processing, see docs/syslog-server-api.md.
+ * Each thread samples one in every <trace_sample_rate> of its messages, using its own countdown so that threads
+ * don't contend on a shared counter.
+ */
+static uint64_t sample_trace_usec(const struct weir_filter_config* conf) {
+    static THREAD_LOCAL unsigned int messages_until_trace = 0;
+    struct timespec t = {};
+
+    if (conf->trace_sample_rate == 0) {
+        return 0;
+    }
+    if (messages_until_trace > 0) {
+        messages_until_trace--;
+        return 0;
+    }
+    messages_until_trace = conf->trace_sample_rate - 1;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) {
+        return 0;
+    }
+    return ((uint64_t)t.tv_sec * 1000000) + (t.tv_nsec / 1000);
+}
+
+/* Fills <field> (of TRACE_FIELD_LENGTH bytes) with the suffix of a text message stamped with <trace_usec>, as
+ * returned by sample_trace_usec(): nothing if it is 0.
+ */
+static void format_trace_field(uint64_t trace_usec, char* field) {
+    field[0] = '\0';
+    if (trace_usec != 0) {
+        snprintf(field, TRACE_FIELD_LENGTH, "~|~%llu", (unsigned long long)trace_usec);
+    }
+}
+
+/* Reports <total> bytes transferred by <user_key> in <direction>, and resets it. A data_xfer message can hold up to
+ * 2GB, which a long enough flush interval could exceed, so the total is split over as many as are needed.
+ */
+static void flush_data_xfer_total(const struct weir_filter_config* conf, const char* user_key, DataDirection direction,
+                                  struct data_xfer_total* total) {
+    while (total->bytes > 0) {
+        const unsigned int done = MIN(total->bytes, (uint64_t)INT32_MAX);
+
+        rl_emit_data_xfer(&conf->telemetry, &total->addr, user_key, direction, done, total->trace_send_usec);
+        total->bytes -= done;
+        total->trace_send_usec = 0;
+    }
+}
+
+/* Runs every <data_xfer_flush_interval_ms> on each thread that has seen a transfer, to report the totals of that
+ * thread's users. Users who transferred nothing since the previous run are dropped, so that the table only holds the
+ * ones who are active.
+ */
+static struct task* flush_data_xfer_totals(struct task* t, void* ctx, unsigned int state) {
+    struct weir_filter_config* conf = (struct weir_filter_config*)ctx;
+    khash_t(data_xfer_hashtable_type)* data_xfer_totals = NULL;
+    WEIR_BUG_ON(conf == NULL);
+
+    // The task only ever runs on the thread that created it
+    data_xfer_totals = conf->data_xfer_threads[tid].totals;
+    for (khint_t iter = kh_begin(data_xfer_totals); iter != kh_end(data_xfer_totals); iter++) {
+        struct user_data_xfer* user = NULL;
+        const char* user_key = NULL;
+        if (!kh_exist(data_xfer_totals, iter)) {
+            continue;
+        }
+
+        user_key = kh_key(data_xfer_totals, iter);
+        user = &kh_value(data_xfer_totals, iter);
+        if ((user->direction[RL_UPLOAD].bytes == 0) && (user->direction[RL_DOWNLOAD].bytes == 0)) {
+            kh_del(data_xfer_hashtable_type, data_xfer_totals, iter);
+            free((char*)user_key);
+            continue;
+        }
+        flush_data_xfer_total(conf, user_key, RL_UPLOAD, &user->direction[RL_UPLOAD]);
+        flush_data_xfer_total(conf, user_key, RL_DOWNLOAD, &user->direction[RL_DOWNLOAD]);
+    }
+
+    t->expire = tick_add(now_ms, MS_TO_TICKS(conf->data_xfer_flush_interval_ms));
+    return t;
+}
+
+/* Returns this thread's total for <user_key> in <direction> of the filter <conf>, adding the user (and, on the
+ * thread's first transfer for the filter, creating its table and flush task) if need be. Returns NULL if out of
+ * memory.
+ */
+static struct data_xfer_total* get_data_xfer_total(struct weir_filter_config* conf, const char* user_key,
+                                                   DataDirection direction) {
+    struct data_xfer_thread* thread = &conf->data_xfer_threads[tid];
+    khash_t(data_xfer_hashtable_type)* data_xfer_totals = thread->totals;
+    khint_t iter;
+    int absent = 0;
+    char* key = NULL;
+
+    if (data_xfer_totals == NULL) {
+        data_xfer_totals = kh_init(data_xfer_hashtable_type);
+        thread->flush_task = task_new_here();
+        if ((data_xfer_totals == NULL) || (thread->flush_task == NULL)) {
+            kh_destroy(data_xfer_hashtable_type, data_xfer_totals);
+            task_destroy(thread->flush_task);
+            thread->flush_task = NULL;
+            return NULL;
+        }
+        thread->totals = data_xfer_totals;
+        thread->flush_task->process = flush_data_xfer_totals;
+        thread->flush_task->context = conf;
+        task_schedule(thread->flush_task, tick_add(now_ms, MS_TO_TICKS(conf->data_xfer_flush_interval_ms)));
+    }
+
+    iter = kh_get(data_xfer_hashtable_type, data_xfer_totals, user_key);
+    if (iter == kh_end(data_xfer_totals)) {
+        key = strdup(user_key);
+        if (key == NULL) {
+            return NULL;
+        }
+        iter = kh_put(data_xfer_hashtable_type, data_xfer_totals, key, &absent);
+        if (absent < 0) {
+            free(key);
+            return NULL;
+        }
+        memset(&kh_value(data_xfer_totals, iter), 0, sizeof(struct user_data_xfer));
+    }
+    return &kh_value(data_xfer_totals, iter).direction[direction];
+}
+
+/* Accounts for the stream having forwarded <len> bytes in <direction>. With a flush interval, the bytes are added to
+ * this thread's total for the stream's user, which is reported by the next flush (or when one of the user's requests
+ * ends), so that a user's traffic costs a data_xfer message per interval rather than one per chunk.
+ */
+static void add_data_xfer(struct weir_filter_config* conf, struct weir_lim_state* st, DataDirection direction,
+                          unsigned int len) {
+    const char* access_key = NULL;
+    struct data_xfer_total* total = NULL;
+    uint64_t trace_usec = 0;
+
+    if (conf->data_xfer_flush_interval_ms == 0) {
+        rl_data_transferred(&conf->telemetry, st->remote_addr, direction, len, sample_trace_usec(conf),
+                            &st->rl_cache);
+        return;
+    }
+
+    access_key = rl_conn_access_key(st->remote_addr, direction, len, &st->rl_cache);
+    if (access_key == NULL) {
+        return;
+    }
+    trace_usec = sample_trace_usec(conf);
+    total = get_data_xfer_total(conf, access_key, direction);
+    if (total == NULL) {
+        // Rather than lose track of the transfer, report it by itself
+        rl_emit_data_xfer(&conf->telemetry, st->remote_addr, access_key, direction, len, trace_usec);
+        return;
+    }
+    total->bytes += len;
+    total->addr = *st->remote_addr;
+    if (total->trace_send_usec == 0) {
+        total->trace_send_usec = trace_usec;
+    }
+}
+
+/* Reports this thread's totals for the stream's user straight away, so that the data of a request is accounted for by
+ * the time its req_end message is sent.
+ */
+static void flush_user_data_xfer(const struct weir_filter_config* conf, struct weir_lim_state* st) {
+    khash_t(data_xfer_hashtable_type)* data_xfer_totals = NULL;
+    khint_t iter;
+    struct user_data_xfer* user = NULL;
+    const char* user_key = NULL;
+
+    if (conf->data_xfer_threads == NULL) {
+        return;
+    }
+    data_xfer_totals = conf->data_xfer_threads[tid].totals;
+
+    // This is the key that the stream's transfers were added under, and is empty if it hasn't transferred anything
+    if ((data_xfer_totals == NULL) || (st->rl_cache.access_key[0] == '\0')) {
+        return;
+    }
+    iter = kh_get(data_xfer_hashtable_type, data_xfer_totals, st->rl_cache.access_key);
+    if (iter == kh_end(data_xfer_totals)) {
+        return;
+    }
+    user_key = kh_key(data_xfer_totals, iter);
+    user = &kh_value(data_xfer_totals, iter);
+    flush_data_xfer_total(conf, user_key, RL_UPLOAD, &user->direction[RL_UPLOAD]);
+    flush_data_xfer_total(conf, user_key, RL_DOWNLOAD, &user->direction[RL_DOWNLOAD]);
+}
+
 /* Called when a filter instance is created and attached to a stream */
 static int weir_attach(struct stream* s, struct filter* filter) {
     struct weir_lim_state* st = NULL;
@@ -257,13 +615,12 @@ static int weir_attach(struct stream* s, struct filter* filter) {
         return -1;
     filter->ctx = st;
 
-    // Weir uses the remote IP of the connection to identify it internally.
-    // If the stream does not have a connection, that connection doesn't have a source
-    // address, or the source address is not an instance of `sockaddr_in`, then weir
-    // can't limit the stream.
+    // Weir uses the remote IP and port of the connection to identify it internally.
+    // If the stream does not have a connection, or that connection doesn't have an IPv4 or IPv6
+    // source address, then weir can't limit the stream.
     conn = sc_conn(s->scf);
     if ((conn != NULL) && (conn->src != NULL) && is_inet_addr(conn->src)) {
-        st->remote_addr = (struct sockaddr_in*)conn->src;
+        st->remote_addr = conn->src;
     }
 
     return 1;
@@ -274,7 +631,9 @@ static int weir_attach(struct stream* s, struct filter* filter) {
 static void weir_detach(struct stream* s, struct filter* filter) {
     struct weir_filter_config* conf = FLT_CONF(filter);
     struct weir_lim_state* st = filter->ctx;
+    struct rl_telemetry_record record = {};
     int active_requests = 0;
+    char conn[RL_CONN_STR_LEN];
 
     if (!st)
         return;
@@ -290,21 +649,28 @@ static void weir_detach(struct stream* s, struct filter* filter) {
         WEIR_BUG_ON(st->limit_key == NULL);
         WEIR_BUG_ON(st->bandwidth_limit_direction == NULL);
 
-        HA_RWLOCK_WRLOCK(OTHER_LOCK, &conf->state_lock);
-        st->limit->last_request_end_tick = now_ms;
+        // No lock is needed, since the stream's active request keeps the user from being cleaned up until the
+        // decrement below. The end tick is stored first so that a clean-up which sees that decrement also sees
+        // the new tick, and so leaves the user be for a while longer.
+        HA_ATOMIC_STORE(&st->limit->last_request_end_tick, now_ms);
         if (verb_direction(s->txn->meth) == RL_DOWNLOAD) {
-            st->limit->download.active_requests -= 1;
-            active_requests = st->limit->download.active_requests;
+            active_requests = HA_ATOMIC_SUB_FETCH(&st->limit->download.active_requests, 1);
         } else {
-            st->limit->upload.active_requests -= 1;
-            active_requests = st->limit->upload.active_requests;
+            active_requests = HA_ATOMIC_SUB_FETCH(&st->limit->upload.active_requests, 1);
         }
-        HA_RWLOCK_WRUNLOCK(OTHER_LOCK, &conf->state_lock);
 
         WARN_ON(active_requests < 0);
-        send_log(NULL, LOG_INFO, "req_end~|~%s:%d~|~%s~|~%s~|~%s~|~%s~|~%d", inet_ntoa(st->remote_addr->sin_addr),
-                 ntohs(st->remote_addr->sin_port), st->limit_key, method_name(s->txn->meth),
-                 st->bandwidth_limit_direction, conf->instance_id, active_requests);
+        flush_user_data_xfer(conf, st);
+        record.type = RL_TELEMETRY_REQ_END;
+        record.direction = limit_direction(st);
+        record.value = active_requests;
+        record.user_key = st->limit_key;
+        record.instance_id = conf->instance_id;
+        if (!rl_telemetry_send(&conf->telemetry, &record)) {
+            send_log(NULL, LOG_INFO, "req_end~|~%s~|~%s~|~%s~|~%s~|~%s~|~%d", rl_format_conn(st->remote_addr, conn),
+                     st->limit_key, method_name(s->txn->meth), st->bandwidth_limit_direction, conf->instance_id,
+                     active_requests);
+        }
 
         rl_request_end(st->remote_addr);
     }
@@ -331,6 +697,9 @@ static int weir_http_headers(struct stream* s, struct filter* filter, struct htt
     CHECK_IF(s->txn == NULL);
     if (st->enabled && is_request && (s->txn != NULL) && (st->remote_addr != NULL)) {
         int active_requests = 0;
+        struct rl_telemetry_record record = {};
+        char trace_field[TRACE_FIELD_LENGTH];
+        char conn[RL_CONN_STR_LEN];
 
         // We need to flag that we've actually processed a request because this callback always runs after all of
         // the frontend lua/config processing is complete, but won't run if the request has been rejected.
@@ -339,13 +708,11 @@ static int weir_http_headers(struct stream* s, struct filter* filter, struct htt
         st->headers_processed = true;
 
         WEIR_BUG_ON(st->limit == NULL); // We should definitely have a limit if we've been enabled on this stream
-        HA_RWLOCK_RDLOCK(OTHER_LOCK, &conf->state_lock);
         if (verb_direction(s->txn->meth) == RL_DOWNLOAD) {
-            active_requests = st->limit->download.active_requests;
+            active_requests = HA_ATOMIC_LOAD(&st->limit->download.active_requests);
         } else {
-            active_requests = st->limit->upload.active_requests;
+            active_requests = HA_ATOMIC_LOAD(&st->limit->upload.active_requests);
         }
-        HA_RWLOCK_RDUNLOCK(OTHER_LOCK, &conf->state_lock);
 
         WEIR_BUG_ON(st->limit_key == NULL);
         WEIR_BUG_ON(st->bandwidth_limit_direction == NULL);
@@ -354,9 +721,20 @@ static int weir_http_headers(struct stream* s, struct filter* filter, struct htt
         if (st->request_class != NULL) {
             request_class = st->request_class;
         }
-        send_log(NULL, LOG_INFO, "req~|~%s:%d~|~%s~|~%s~|~%s~|~%s~|~%d~|~%s", inet_ntoa(st->remote_addr->sin_addr),
-                 ntohs(st->remote_addr->sin_port), st->limit_key, method_name(s->txn->meth),
-                 st->bandwidth_limit_direction, conf->instance_id, active_requests, request_class);
+        record.type = RL_TELEMETRY_REQ_START;
+        record.direction = limit_direction(st);
+        record.value = active_requests;
+        record.trace_send_usec = sample_trace_usec(conf);
+        record.user_key = st->limit_key;
+        record.verb = method_name(s->txn->meth);
+        record.instance_id = conf->instance_id;
+        record.request_class = request_class;
+        if (!rl_telemetry_send(&conf->telemetry, &record)) {
+            format_trace_field(record.trace_send_usec, trace_field);
+            send_log(NULL, LOG_INFO, "req~|~%s~|~%s~|~%s~|~%s~|~%s~|~%d~|~%s%s", rl_format_conn(st->remote_addr, conn),
+                     st->limit_key, method_name(s->txn->meth), st->bandwidth_limit_direction, conf->instance_id,
+                     active_requests, request_class, trace_field);
+        }
     }
 
     msg->chn->analyse_exp = TICK_ETERNITY;
@@ -427,11 +805,83 @@ static struct apply_limit_result apply_bandwidth_limit(struct freq_ctr* counter,
     return result;
 }
 
+/* Paces the stream's data in <direction>, of which <len> bytes can be forwarded right now, with a token bucket shared
+ * by all of its user's streams on this instance. The bucket fills at the user's limit-share (or the filter's limit for
+ * users without one yet), up to <bandwidth_burst_ms> of it, so that a user that has been below their limit can then
+ * briefly go faster than it.
+ * Rather than splitting the tokens evenly between all of the user's active requests, they are split between the
+ * streams that have asked for some lately, so that the share of streams that have nothing to send (e.g. those waiting
+ * on the backend) goes to those that do. A stream that is refused is told how long to wait for its next share, rather
+ * than retrying on every tick.
+ */
+static struct apply_limit_result apply_token_bucket_limit(const struct weir_filter_config* conf,
+                                                          struct weir_lim_state* st, DataDirection direction,
+                                                          unsigned int len) {
+    struct user_direction_limit* limit = (direction == RL_DOWNLOAD) ? &st->limit->download : &st->limit->upload;
+    struct apply_limit_result result = {.wait_ms = 0, .bytes_to_forward = 0};
+    const unsigned int period = now_ms / TOKEN_BUCKET_SENDER_PERIOD_MS;
+    uint64_t rate = 0;
+    int64_t capacity = 0;
+    int64_t share = 0;
+    int senders = 0;
+
+    rate = HA_ATOMIC_LOAD(&limit->limit_received) ? HA_ATOMIC_LOAD(&limit->bytes_per_second) : conf->unknown_user_limit;
+    rate = MAX(rate, conf->minimum_limit);
+    rate = MAX(rate, 1);
+    capacity = MAX((int64_t)(rate * conf->bandwidth_burst_ms / 1000), TOKEN_BUCKET_MIN_GRANT);
+
+    HA_SPIN_LOCK(OTHER_LOCK, &limit->bucket_lock);
+    if (!limit->bucket_started) {
+        // A new user starts with a full burst credit
+        limit->bucket_started = true;
+        limit->bucket_tokens = capacity;
+        limit->bucket_refill_ms = now_ms;
+    } else {
+        // The fraction of a token left over by each refill is carried over to the next, so that frequent refills
+        // at a low rate don't round the rate down
+        const uint64_t earned = rate * (unsigned int)(now_ms - limit->bucket_refill_ms) + limit->bucket_token_fraction;
+
+        limit->bucket_tokens += (int64_t)(earned / 1000);
+        limit->bucket_token_fraction = earned % 1000;
+        limit->bucket_refill_ms = now_ms;
+        if (limit->bucket_tokens >= capacity) {
+            limit->bucket_tokens = capacity;
+            limit->bucket_token_fraction = 0;
+        }
+    }
+
+    if (limit->sender_period != period) {
+        limit->previous_senders = (limit->sender_period + 1 == period) ? limit->senders : 0;
+        limit->senders = 0;
+        limit->sender_period = period;
+    }
+    if (st->bucket_sender_period != period + 1) {
+        st->bucket_sender_period = period + 1;
+        limit->senders++;
+    }
+    senders = MAX(1, MAX(limit->senders, limit->previous_senders));
+
+    share = MAX(limit->bucket_tokens / senders, MIN(limit->bucket_tokens, (int64_t)TOKEN_BUCKET_MIN_GRANT));
+    result.bytes_to_forward = (int)MIN((int64_t)len, MAX(share, 0));
+    limit->bucket_tokens -= result.bytes_to_forward;
+    HA_SPIN_UNLOCK(OTHER_LOCK, &limit->bucket_lock);
+
+    if (result.bytes_to_forward < len) {
+        // Wait for as long as the stream's share of the rate takes to provide its next grant
+        const uint64_t wanted = MIN(len - result.bytes_to_forward, TOKEN_BUCKET_MIN_GRANT);
+
+        result.wait_ms = (int)MIN((uint64_t)1000, MAX((uint64_t)1, (wanted * senders * 1000 + rate - 1) / rate));
+    }
+    return result;
+}
+
 static int weir_http_payload(struct stream* s, struct filter* filter, struct http_msg* msg, unsigned int offset,
                              unsigned int len) {
+    struct weir_filter_config* conf = FLT_CONF(filter);
     struct weir_lim_state* st = filter->ctx;
     const DataDirection direction = (msg->chn == &s->req) ? RL_UPLOAD : RL_DOWNLOAD;
     int bytes_to_forward = 0;
+    uint32_t jitter_ms = 0;
 
     WEIR_BUG_ON(!st->enabled); // We should only be registering the data callback when enabling the filter
     if (st->remote_addr == NULL) {
@@ -444,13 +894,14 @@ static int weir_http_payload(struct stream* s, struct filter* filter, struct htt
         WEIR_BUG_ON(st->bandwidth_limit_direction == NULL);
 
         // do not proceed with transferring data if we are throttling this connection
-        if (rl_speed_throttle(st->remote_addr, direction) == RL_THROTTLE) {
+        if (rl_speed_throttle(st->remote_addr, direction, &st->rl_cache, &jitter_ms) == RL_THROTTLE) {
             unsigned int* next_tick_ptr = (direction == RL_DOWNLOAD) ? &st->limit->download.next_throttle_log_tick
                                                                      : &st->limit->upload.next_throttle_log_tick;
             unsigned int next_throttle_log_tick = HA_ATOMIC_LOAD(next_tick_ptr);
+            char conn[RL_CONN_STR_LEN];
 
-            send_log(NULL, LOG_DEBUG, "Throttling %s connection to %s:%u", st->bandwidth_limit_direction,
-                     inet_ntoa(st->remote_addr->sin_addr), ntohs(st->remote_addr->sin_port));
+            send_log(NULL, LOG_DEBUG, "Throttling %s connection to %s", st->bandwidth_limit_direction,
+                     rl_format_conn(st->remote_addr, conn));
 
             st->next_allowed_send_tick = tick_add(now_ms, MS_TO_TICKS(1));
 
@@ -473,9 +924,26 @@ static int weir_http_payload(struct stream* s, struct filter* filter, struct htt
                              st->bandwidth_limit_direction, st->limit_key);
                 }
             }
+        } else if ((jitter_ms > 0) && !st->jitter_served) {
+            // Rather than sleeping (and so stalling every other stream on this thread), wait to be called again once
+            // the jitter has passed, and forward the data then without any further jitter
+            st->jitter_served = true;
+            st->next_allowed_send_tick = tick_add(now_ms, MS_TO_TICKS(jitter_ms));
         } else {
-            bytes_to_forward = len;
-            rl_data_transferred(st->remote_addr, direction, len);
+            struct apply_limit_result allowed = {.wait_ms = 0, .bytes_to_forward = len};
+
+            // A request is only limited in the direction of its bandwidth limit
+            if ((conf->bandwidth_burst_ms > 0) && (direction == limit_direction(st))) {
+                allowed = apply_token_bucket_limit(conf, st, direction, len);
+            }
+            if (allowed.wait_ms > 0) {
+                st->next_allowed_send_tick = tick_add(now_ms, MS_TO_TICKS(allowed.wait_ms));
+            }
+            if (allowed.bytes_to_forward > 0) {
+                st->jitter_served = false;
+                bytes_to_forward = allowed.bytes_to_forward;
+                add_data_xfer(conf, st, direction, bytes_to_forward);
+            }
         }
     }
 
@@ -508,6 +976,62 @@ static struct flt_ops weir_lim_ops = {
     .http_payload = weir_http_payload,
 };
 
+// Counts a new active request by the user of <limit>, in the direction of <method>. See weir_enable_filter() for
+// the locking.
+static void add_active_request(struct user_limit* limit, enum http_meth_t method) {
+    if (verb_direction(method) == RL_DOWNLOAD) {
+        HA_ATOMIC_INC(&limit->download.active_requests);
+    } else {
+        HA_ATOMIC_INC(&limit->upload.active_requests);
+    }
+}
+
+/* Cleans old entries out of the user-limit table, if a clean-up is due, a few buckets at a time. The table may grow
+ * between calls, in which case some entries are skipped or checked twice, which is harmless since they will be
+ * checked again by the next clean-up. Must be called with the state lock held for writing.
+ */
+static void clean_user_limits(struct weir_filter_config* conf) {
+    khint_t iter = conf->next_cleanup_bucket;
+    const khint_t end = MIN(kh_end(conf->user_limit_state), iter + USERMAP_CLEANUP_BUCKETS_PER_REQUEST);
+
+    if (!tick_is_expired(conf->next_cleanup_tick, now_ms)) {
+        return;
+    }
+
+    for (; iter < end; iter++) {
+        struct user_limit* user_limits;
+        int download_requests, upload_requests;
+        if (!kh_exist(conf->user_limit_state, iter)) {
+            continue;
+        }
+
+        user_limits = kh_value(conf->user_limit_state, iter);
+        download_requests = HA_ATOMIC_LOAD(&user_limits->download.active_requests);
+        upload_requests = HA_ATOMIC_LOAD(&user_limits->upload.active_requests);
+        WARN_ON(download_requests < 0);
+        WARN_ON(upload_requests < 0);
+        if ((download_requests <= 0) && (upload_requests <= 0)) {
+            // Even if the user has no active requests, make sure we've waited a few seconds since the last one
+            // ended before cleaning up their data. This ensures that if they quick make another request (e.g if
+            // they're doing many requests in serial), their bandwidth usage from previous requests is taken into
+            // account for the new requests.
+            const unsigned int user_expire_tick = tick_add(HA_ATOMIC_LOAD(&user_limits->last_request_end_tick),
+                                                           USERMAP_CLEANUP_MIN_MS_SINCE_DISCONNECT);
+            if (tick_is_expired(user_expire_tick, now_ms)) {
+                free_user_limit(user_limits);
+                ha_free((void**)&kh_key(conf->user_limit_state, iter));
+                kh_del(user_limit_hashtable_type, conf->user_limit_state, iter);
+            }
+        }
+    }
+
+    conf->next_cleanup_bucket = iter;
+    if (iter >= kh_end(conf->user_limit_state)) {
+        conf->next_cleanup_bucket = 0;
+        HA_ATOMIC_STORE(&conf->next_cleanup_tick, tick_add(now_ms, MS_TO_TICKS(USERMAP_CLEANUP_INTERVAL_MS)));
+    }
+}
+
 /* Enable the filter on a stream. It always returns ACT_RET_CONT. On error, the rule is ignored.
  */
 static enum act_return weir_enable_filter(struct act_rule* rule, struct proxy* px, struct session* sess,
@@ -603,55 +1127,41 @@ static enum act_return weir_enable_filter(struct act_rule* rule, struct proxy* p
     WEIR_BUG_ON(conf->user_limit_state == NULL);
     WEIR_BUG_ON(st->limit_key == NULL);
 
-    HA_RWLOCK_WRLOCK(OTHER_LOCK, &conf->state_lock);
+    // The active request is counted while the lock is held, even if only for reading, so that the user can't be
+    // cleaned up in between. Only a user's first request, or a clean-up, needs the table to itself.
+    HA_RWLOCK_RDLOCK(OTHER_LOCK, &conf->state_lock);
     iter = kh_get(user_limit_hashtable_type, conf->user_limit_state, st->limit_key);
-    if (iter == kh_end(conf->user_limit_state)) {
-        int insert_result;
-        char* key_duplicate = strdup(st->limit_key); // Freed when the entry is removed from the hashtable
-
-        st->limit = pool_zalloc(pool_head_weir_user_limit);
-        WEIR_BUG_ON(st->limit == NULL);
-        iter = kh_put(user_limit_hashtable_type, conf->user_limit_state, key_duplicate, &insert_result);
-        kh_value(conf->user_limit_state, iter) = st->limit;
-    } else {
+    if (iter != kh_end(conf->user_limit_state)) {
         st->limit = kh_value(conf->user_limit_state, iter);
         WEIR_BUG_ON(st->limit == NULL);
+        add_active_request(st->limit, s->txn->meth);
     }
-    if (verb_direction(s->txn->meth) == RL_DOWNLOAD) {
-        st->limit->download.active_requests += 1;
-    } else {
-        st->limit->upload.active_requests += 1;
-    }
-
-    // Clean old entries out of the user-limit table
-    if (tick_is_expired(conf->next_cleanup_tick, now_ms)) {
-        for (khint_t iter = kh_begin(conf->user_limit_state); iter != kh_end(conf->user_limit_state); iter++) {
-            struct user_limit* user_limits;
-            if (!kh_exist(conf->user_limit_state, iter)) {
-                continue;
-            }
+    HA_RWLOCK_RDUNLOCK(OTHER_LOCK, &conf->state_lock);
 
-            user_limits = kh_value(conf->user_limit_state, iter);
-            WARN_ON(user_limits->download.active_requests < 0);
-            WARN_ON(user_limits->upload.active_requests < 0);
-            if ((user_limits->download.active_requests <= 0) && (user_limits->upload.active_requests <= 0)) {
-                // Even if the user has no active requests, make sure we've waited a few seconds since the last one
-                // ended before cleaning up their data. This ensures that if they quick make another request (e.g if
-                // they're doing many requests in serial), their bandwidth usage from previous requests is taken into
-                // account for the new requests.
-                const unsigned int user_expire_tick =
-                    tick_add(user_limits->last_request_end_tick, USERMAP_CLEANUP_MIN_MS_SINCE_DISCONNECT);
-                if (tick_is_expired(user_expire_tick, now_ms)) {
-                    pool_free(pool_head_weir_user_limit, user_limits);
-                    ha_free((void**)&kh_key(conf->user_limit_state, iter));
-                    kh_del(user_limit_hashtable_type, conf->user_limit_state, iter);
-                }
-            }
+    if (st->limit == NULL) {
+        HA_RWLOCK_WRLOCK(OTHER_LOCK, &conf->state_lock);
+        // Another thread may have added the user since we looked
+        iter = kh_get(user_limit_hashtable_type, conf->user_limit_state, st->limit_key);
+        if (iter == kh_end(conf->user_limit_state)) {
+            int insert_result;
+            char* key_duplicate = strdup(st->limit_key); // Freed when the entry is removed from the hashtable
+
+            st->limit = new_user_limit();
+            iter = kh_put(user_limit_hashtable_type, conf->user_limit_state, key_duplicate, &insert_result);
+            kh_value(conf->user_limit_state, iter) = st->limit;
+        } else {
+            st->limit = kh_value(conf->user_limit_state, iter);
+            WEIR_BUG_ON(st->limit == NULL);
         }
-
-        conf->next_cleanup_tick = tick_add(now_ms, MS_TO_TICKS(USERMAP_CLEANUP_INTERVAL_MS));
+        add_active_request(st->limit, s->txn->meth);
+        clean_user_limits(conf);
+        HA_RWLOCK_WRUNLOCK(OTHER_LOCK, &conf->state_lock);
+    } else if (tick_is_expired(HA_ATOMIC_LOAD(&conf->next_cleanup_tick), now_ms) &&
+               (HA_RWLOCK_TRYWRLOCK(OTHER_LOCK, &conf->state_lock) == 0)) {
+        // If the lock is busy, the clean-up can just as well be carried on by a later request
+        clean_user_limits(conf);
+        HA_RWLOCK_WRUNLOCK(OTHER_LOCK, &conf->state_lock);
     }
-    HA_RWLOCK_WRUNLOCK(OTHER_LOCK, &conf->state_lock);
 
     return ACT_RET_CONT;
 }
@@ -760,6 +1270,21 @@ static struct action_kw_list http_res_actions = {.kw = {{"activate-weir", activa
 INITCALL1(STG_REGISTER, http_req_keywords_register, &http_req_actions);
 INITCALL1(STG_REGISTER, http_res_keywords_register, &http_res_actions);
 
+static void emit_active_requests(const struct weir_filter_config* conf, const char* user_key,
+                                 DataDirection direction, int active_requests) {
+    struct rl_telemetry_record record = {};
+
+    record.type = RL_TELEMETRY_ACTIVE_REQS;
+    record.direction = direction;
+    record.value = active_requests;
+    record.user_key = user_key;
+    record.instance_id = conf->instance_id;
+    if (!rl_telemetry_send(&conf->telemetry, &record)) {
+        send_log(NULL, LOG_INFO, "active_reqs~|~%s~|~%s~|~%s~|~%d", conf->instance_id, user_key,
+                 direction_name(direction), active_requests);
+    }
+}
+
 struct task* emit_active_request_refresh(struct task* t, void* ctx, unsigned int state) {
     struct weir_filter_config* conf = (struct weir_filter_config*)ctx;
     WEIR_BUG_ON(conf == NULL);
@@ -768,19 +1293,20 @@ struct task* emit_active_request_refresh(struct task* t, void* ctx, unsigned int
     for (khint_t iter = kh_begin(conf->user_limit_state); iter != kh_end(conf->user_limit_state); iter++) {
         struct user_limit* user_limits = NULL;
         const char* user_key = NULL;
+        int download_requests, upload_requests;
         if (!kh_exist(conf->user_limit_state, iter)) {
             continue;
         }
 
         user_key = kh_key(conf->user_limit_state, iter);
         user_limits = kh_value(conf->user_limit_state, iter);
-        if (user_limits->download.active_requests > 0) {
-            send_log(NULL, LOG_INFO, "active_reqs~|~%s~|~%s~|~%s~|~%d", conf->instance_id, user_key,
-                     direction_name(RL_DOWNLOAD), user_limits->download.active_requests);
+        download_requests = HA_ATOMIC_LOAD(&user_limits->download.active_requests);
+        upload_requests = HA_ATOMIC_LOAD(&user_limits->upload.active_requests);
+        if (download_requests > 0) {
+            emit_active_requests(conf, user_key, RL_DOWNLOAD, download_requests);
         }
-        if (user_limits->upload.active_requests > 0) {
-            send_log(NULL, LOG_INFO, "active_reqs~|~%s~|~%s~|~%s~|~%d", conf->instance_id, user_key,
-                     direction_name(RL_UPLOAD), user_limits->upload.active_requests);
+        if (upload_requests > 0) {
+            emit_active_requests(conf, user_key, RL_UPLOAD, upload_requests);
         }
     }
     HA_RWLOCK_RDUNLOCK(OTHER_LOCK, &conf->state_lock);
@@ -799,11 +1325,18 @@ static int parse_weir_flt(char** args, int* cur_arg, struct proxy* px, struct fl
     khash_t(user_limit_hashtable_type)* user_limit_state = NULL;
     struct listener* listener = NULL;
     struct task* refresh_task = NULL;
+    struct data_xfer_thread* data_xfer_threads = NULL;
     int pos = *cur_arg + 1;
     unsigned int refresh_interval_ms = DEFAULT_REFRESH_INTERVAL_MS;
     unsigned int unknown_user_limit =
         DEFAULT_UNKNOWN_USER_LIMIT; // Default to a 1Mbps limit when we've not received a limit for a user
     unsigned int minimum_limit = DEFAULT_MINIMUM_BANDWIDTH_LIMIT;
+    unsigned int trace_sample_rate = 0;
+    unsigned int data_xfer_flush_interval_ms = 0;
+    unsigned int bandwidth_burst_ms = 0;
+    struct rl_telemetry telemetry;
+
+    rl_telemetry_init(&telemetry);
 
     // Prevent declaration of multiple weir filters on the same frontend
     list_for_each_entry(fc, &px->filter_configs, list) {
@@ -868,6 +1401,56 @@ static int parse_weir_flt(char** args, int* cur_arg, struct proxy* px, struct fl
                 return -1;
             }
             pos += 2;
+        } else if (strcmp(args[pos], "binary-telemetry") == 0) {
+            if (!*args[pos + 1]) {
+                memprintf(err, "'%s': the value is missing for filter option '%s'", args[*cur_arg], args[pos]);
+                return -1;
+            }
+            if (rl_telemetry_open(&telemetry, args[pos + 1]) != 0) {
+                memprintf(err, "'%s' : invalid address '%s' for option '%s' (%s)", args[*cur_arg], args[pos + 1],
+                          args[pos], strerror(errno));
+                return -1;
+            }
+            pos += 2;
+        } else if (strcmp(args[pos], "trace-sample-rate") == 0) {
+            char* end = NULL;
+            if (!*args[pos + 1]) {
+                memprintf(err, "'%s': the value is missing for filter option '%s'", args[*cur_arg], args[pos]);
+                return -1;
+            }
+            trace_sample_rate = strtoul(args[pos + 1], &end, 10);
+            if (*end != '\0') {
+                memprintf(err, "'%s' : invalid integer value for option '%s' (unexpected character '%c')",
+                          args[*cur_arg], args[pos], *end);
+                return -1;
+            }
+            pos += 2;
+        } else if (strcmp(args[pos], "data-xfer-flush-interval") == 0) {
+            const char* res = NULL;
+            if (!*args[pos + 1]) {
+                memprintf(err, "'%s': the value is missing for filter option '%s'", args[*cur_arg], args[pos]);
+                return -1;
+            }
+            res = parse_time_err(args[pos + 1], &data_xfer_flush_interval_ms, TIME_UNIT_MS);
+            if (res != NULL) {
+                memprintf(err, "'%s' : invalid time value for option '%s' (unexpected character '%c')", args[*cur_arg],
+                          args[pos], *res);
+                return -1;
+            }
+            pos += 2;
+        } else if (strcmp(args[pos], "bandwidth-burst") == 0) {
+            const char* res = NULL;
+            if (!*args[pos + 1]) {
+                memprintf(err, "'%s': the value is missing for filter option '%s'", args[*cur_arg], args[pos]);
+                return -1;
+            }
+            res = parse_time_err(args[pos + 1], &bandwidth_burst_ms, TIME_UNIT_MS);
+            if (res != NULL) {
+                memprintf(err, "'%s' : invalid time value for option '%s' (unexpected character '%c')", args[*cur_arg],
+                          args[pos], *res);
+                return -1;
+            }
+            pos += 2;
         } else
             break;
     }
@@ -876,11 +1459,17 @@ static int parse_weir_flt(char** args, int* cur_arg, struct proxy* px, struct fl
     conf = calloc(1, sizeof(*conf));
     user_limit_state = kh_init(user_limit_hashtable_type);
     refresh_task = task_new_anywhere();
-    if ((conf == NULL) || (user_limit_state == NULL) || (refresh_task == NULL)) {
+    if (data_xfer_flush_interval_ms > 0) {
+        data_xfer_threads = calloc(MAX_THREADS, sizeof(*data_xfer_threads));
+    }
+    if ((conf == NULL) || (user_limit_state == NULL) || (refresh_task == NULL) ||
+        ((data_xfer_flush_interval_ms > 0) && (data_xfer_threads == NULL))) {
         memprintf(err, "%s: out of memory", args[*cur_arg]);
         ha_free(&conf);
         kh_destroy(user_limit_hashtable_type, user_limit_state);
         task_destroy(refresh_task);
+        ha_free(&data_xfer_threads);
+        rl_telemetry_close(&telemetry);
         return -1;
     }
 
@@ -889,6 +1478,11 @@ static int parse_weir_flt(char** args, int* cur_arg, struct proxy* px, struct fl
     conf->refresh_interval_ms = refresh_interval_ms;
     conf->unknown_user_limit = unknown_user_limit;
     conf->minimum_limit = minimum_limit;
+    conf->trace_sample_rate = trace_sample_rate;
+    conf->data_xfer_flush_interval_ms = data_xfer_flush_interval_ms;
+    conf->data_xfer_threads = data_xfer_threads;
+    conf->bandwidth_burst_ms = bandwidth_burst_ms;
+    conf->telemetry = telemetry;
     HA_RWLOCK_INIT(&conf->state_lock);
     snprintf(conf->instance_id, sizeof(conf->instance_id), "%s-%d", localpeer, get_host_port(&listener->rx.addr));
     // We use underscore as the separator between sections of the key in redis, so we need to make sure we don't clash
@@ -934,7 +1528,7 @@ struct show_lim_ctx {
 
 static void chunk_append_limits(struct buffer* out, struct user_direction_limit* limit) {
     chunk_appendf(out, "%d,%u,%lu,%d", limit->limit_received, limit->bytes_per_second, limit->limit_timestamp,
-                  limit->active_requests);
+                  HA_ATOMIC_LOAD(&limit->active_requests));
 }
 
 // This will be called repeatedly until we return 1. If we can't fit all the output into the applet output buffer
@@ -969,7 +1563,7 @@ static int cli_show_weir_limits(struct appctx* appctx) {
         user_limits = kh_value(g_filter->user_limit_state, iter);
 
         chunk_reset(&trash);
-        chunk_appendf(&trash, "%s,%d,", user_key, user_limits->last_request_end_tick);
+        chunk_appendf(&trash, "%s,%d,", user_key, HA_ATOMIC_LOAD(&user_limits->last_request_end_tick));
         chunk_append_limits(&trash, &user_limits->upload);
         chunk_strcat(&trash, ",");
         chunk_append_limits(&trash, &user_limits->download);
@@ -986,6 +1580,51 @@ static int cli_show_weir_limits(struct appctx* appctx) {
     return ret;
 }
 
+/* Applies a batch of limit-share updates given as the payload of the command, one line per user as for the
+ * ingest_policies Lua service, all under a single acquisition of the state lock. As for that service, an invalid line
+ * stops the processing of the batch.
+ */
+static int cli_parse_set_weir_limit_shares(char** args, char* payload, struct appctx* appctx, void* private) {
+    char* line = payload;
+    char* next_line = NULL;
+    int line_number = 0;
+    int applied = 0;
+    bool valid = true;
+    char* msg = NULL;
+
+    if (!cli_has_level(appctx, ACCESS_LVL_ADMIN)) {
+        return 1;
+    }
+    if (g_filter == NULL) {
+        return cli_err(appctx, "No weir filter is configured.\n");
+    }
+    if (payload == NULL) {
+        return cli_err(appctx, "Missing limit-share updates, expected as a payload: 'set weir limit-shares <<'.\n");
+    }
+
+    HA_RWLOCK_WRLOCK(OTHER_LOCK, &g_filter->state_lock);
+    for (; (line != NULL) && valid; line = next_line) {
+        next_line = strchr(line, '\n');
+        if (next_line != NULL) {
+            *next_line++ = '\0';
+        }
+        line_number++;
+        if (*line != '\0') {
+            valid = ingest_limit_share_line(g_filter, line, &applied);
+        }
+    }
+    HA_RWLOCK_WRUNLOCK(OTHER_LOCK, &g_filter->state_lock);
+
+    if (!valid) {
+        memprintf(&msg, "Invalid limit-share update on line %d, the rest of the batch was ignored (%d updates were "
+                        "applied).\n",
+                  line_number, applied);
+        return cli_dynerr(appctx, msg);
+    }
+    memprintf(&msg, "Applied %d limit-share updates.\n", applied);
+    return cli_dynmsg(appctx, LOG_INFO, msg);
+}
+
 /* register cli keywords */
 static struct cli_kw_list cli_kws = {{},
                                      {{{"show", "weir", "limits", NULL},
@@ -994,6 +1633,12 @@ static struct cli_kw_list cli_kws = {{},
                                        NULL,
                                        cli_show_weir_limits,
                                        NULL},
+                                      {{"set", "weir", "limit-shares", NULL},
+                                       "set weir limit-shares <<                : Apply a batch of limit-share "
+                                       "updates, one line per user in the format sent to the ingest_policies service",
+                                       cli_parse_set_weir_limit_shares,
+                                       NULL,
+                                       NULL},
                                       {
                                           {},
                                       }}};
@@ -11,6 +11,7 @@
  */
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <haproxy/khash.h>
 #include <haproxy/log.h>
 #include <haproxy/rate_limit.h>
@@ -20,21 +21,87 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
-static uint64_t ip_port_from_sockaddr(struct sockaddr_in* addr_in) {
-    uint16_t port = 0;
-    uint32_t ip = 0;
+// The first or last 8 bytes of an IPv6 address, which are in network order
+static inline uint64_t ipv6_half(const uint8_t* bytes) {
+    uint64_t half = 0;
+    int i;
 
-    if (addr_in == NULL)
+    for (i = 0; i < 8; i++)
+        half = (half << 8) | bytes[i];
+    return half;
+}
+
+static inline void conn_id_from_ipv4(rl_conn_id_t* id, const struct in_addr* addr, uint16_t port) {
+    id->addr_hi = 0;
+    id->addr_lo = 0xffff00000000ULL | ntohl(addr->s_addr);
+    id->port = port;
+}
+
+static inline void conn_id_from_ipv6(rl_conn_id_t* id, const struct in6_addr* addr, uint16_t port) {
+    id->addr_hi = ipv6_half(addr->s6_addr);
+    id->addr_lo = ipv6_half(addr->s6_addr + 8);
+    id->port = port;
+}
+
+// Returns 0 if <addr> is neither an IPv4 nor an IPv6 address
+static int conn_id_from_sockaddr(const struct sockaddr_storage* addr, rl_conn_id_t* id) {
+    if (addr == NULL)
         return 0;
-    port = ntohs(addr_in->sin_port);
-    ip = ntohl(addr_in->sin_addr.s_addr);
-    return (uint64_t)ip << 32 | port;
+    switch (addr->ss_family) {
+    case AF_INET: {
+        const struct sockaddr_in* addr_in = (const struct sockaddr_in*)addr;
+        conn_id_from_ipv4(id, &addr_in->sin_addr, ntohs(addr_in->sin_port));
+        return 1;
+    }
+    case AF_INET6: {
+        const struct sockaddr_in6* addr_in6 = (const struct sockaddr_in6*)addr;
+        conn_id_from_ipv6(id, &addr_in6->sin6_addr, ntohs(addr_in6->sin6_port));
+        return 1;
+    }
+    }
+    return 0;
 }
 
+const char* rl_format_conn(const struct sockaddr_storage* addr, char* out) {
+    char host[INET6_ADDRSTRLEN];
+
+    out[0] = '\0';
+    if (addr == NULL)
+        return out;
+    if (addr->ss_family == AF_INET) {
+        const struct sockaddr_in* addr_in = (const struct sockaddr_in*)addr;
+        if (inet_ntop(AF_INET, &addr_in->sin_addr, host, sizeof(host)) != NULL)
+            snprintf(out, RL_CONN_STR_LEN, "%s:%d", host, ntohs(addr_in->sin_port));
+    } else if (addr->ss_family == AF_INET6) {
+        const struct sockaddr_in6* addr_in6 = (const struct sockaddr_in6*)addr;
+        if (inet_ntop(AF_INET6, &addr_in6->sin6_addr, host, sizeof(host)) != NULL)
+            snprintf(out, RL_CONN_STR_LEN, "[%s]:%d", host, ntohs(addr_in6->sin6_port));
+    }
+    return out;
+}
+
+// Mixes all the bits of a connection id into each bit of the result (with MurmurHash3's finaliser), so that both the
+// shard index (from its top bits) and khash's bucket (from its bottom bits) are well spread
+static inline uint64_t conn_id_hash64(rl_conn_id_t id) {
+    uint64_t h = id.addr_hi ^ (id.addr_lo * 0x9e3779b97f4a7c15ULL) ^ ((uint64_t)id.port << 48);
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#define conn_id_hash_func(id) ((khint32_t)conn_id_hash64(id))
+#define conn_id_equal(a, b) (((a).addr_lo == (b).addr_lo) && ((a).port == (b).port) && ((a).addr_hi == (b).addr_hi))
+
 typedef enum units { UNIT_MB = 1024 * 1024, UNIT_USECS_IN_SEC = 1000000, UINT_USECS_IN_MILLISEC = 1000 } Units;
 
 typedef struct {
@@ -58,36 +125,72 @@ static const char* LOG_DELIMITER = "~|~";
 static volatile int BASE_JITTER_RANGE_MS = 2;
 static const int SPEED_TABLE_CLEANUP_PERIOD_USEC = 60 * UNIT_USECS_IN_SEC;
 static const int SPEED_TABLE_STALE_POLICY_AGE_SEC = 120;
+// The clean-up swaps a shard's lock between slices of this many buckets, so that it never holds it for long
+static const khint_t SPEED_TABLE_CLEANUP_BUCKETS_PER_LOCK = 256;
 // Throttling backoff settings:
 static const int BACKOFF_WINDOW_EPOCHS = 6;
 static const int MIN_RUN_TIME_USEC = 50 * UINT_USECS_IN_MILLISEC;
 static const float DIFF_RATIO_LOW_MARK_TO_JITTER = 1.5;
 
-// equal to c++: using  ip_port_key_hash = unordered_map<uint64_t, kh_cstr_t>
-KHASH_MAP_INIT_INT64(ip_port_key_hash, kh_cstr_t)
+// equal to c++: using  ip_port_key_hash = unordered_map<rl_conn_id_t, kh_cstr_t>
+KHASH_INIT(ip_port_key_hash, rl_conn_id_t, kh_cstr_t, 1, conn_id_hash_func, conn_id_equal)
 // equal to c++: using  key_ip_port_count_hash = unordered_map<kh_cstr_t, khint32_t>
 KHASH_MAP_INIT_STR(key_ip_port_count_hash, khint32_t)
-// equal to  c++: using speed_hash = unordered_map<kh_string_t, unit32_t>
-typedef struct {
-    uint32_t throttle;                /* 0: no, >0: yes */
-    khint32_t num_active_connections; /* user's active conns when the this violation record found */
-    uint32_t received_epoch_sec;
-    float diff_ratio;
-    uint64_t elapsed_usec_in_the_epoch;
-    uint64_t allowed_run_time_usec;
-    float previous_diff_ratio;
-} speed_hash_value_t;
+// equal to  c++: using speed_hash = unordered_map<kh_string_t, speed_hash_value_t>
 KHASH_MAP_INIT_STR(speed_hash, speed_hash_value_t)
 
-static khash_t(ip_port_key_hash) * ip_port_key_hashmap;
-static khash_t(key_ip_port_count_hash) * key_ip_port_count_hashmap;
-static pthread_rwlock_t ip_port_key_hashmap_lck;
-static khash_t(speed_hash) * key_upload_speed_epoch_hashmap;
-static pthread_rwlock_t key_upload_speed_epoch_hashmap_lck;
-static khash_t(speed_hash) * key_download_speed_epoch_hashmap;
-static pthread_rwlock_t key_download_speed_epoch_hashmap_lck;
+// Each of the maps below is split into RL_MAP_SHARDS shards, each with its own lock, so that HAProxy's threads only
+// contend when they look up the same shard at the same time rather than on every lookup. Each shard is on its own
+// cache line, so that taking one shard's lock doesn't invalidate its neighbours'.
+// The shards that streams cache lookups from (see struct rl_conn_cache) also count the changes that invalidate those
+// caches in <generation>, which is only modified with the shard's write lock held but may be read without any lock.
+#define RL_MAP_SHARD_BITS 6
+#define RL_MAP_SHARDS (1 << RL_MAP_SHARD_BITS)
+#define RL_CACHE_LINE_SIZE 64
+
+struct ip_port_key_shard {
+    pthread_rwlock_t lck;
+    uint64_t generation;
+    khash_t(ip_port_key_hash) * map;
+} __attribute__((aligned(RL_CACHE_LINE_SIZE)));
+
+struct key_ip_port_count_shard {
+    pthread_rwlock_t lck;
+    khash_t(key_ip_port_count_hash) * map;
+} __attribute__((aligned(RL_CACHE_LINE_SIZE)));
+
+struct speed_shard {
+    pthread_rwlock_t lck;
+    uint64_t generation;
+    khash_t(speed_hash) * map;
+} __attribute__((aligned(RL_CACHE_LINE_SIZE)));
+
+static int hashmaps_initialised;
+static struct ip_port_key_shard ip_port_key_shards[RL_MAP_SHARDS];
+static struct key_ip_port_count_shard key_ip_port_count_shards[RL_MAP_SHARDS];
+static struct speed_shard key_upload_speed_epoch_shards[RL_MAP_SHARDS];
+static struct speed_shard key_download_speed_epoch_shards[RL_MAP_SHARDS];
 static void* remove_old_epochs(void* unused);
 
+// The shards are chosen by the top bits of a multiplicative hash, since khash picks buckets within each shard by the
+// bottom bits of its own hash of the same key
+static inline unsigned int conn_shard_index(rl_conn_id_t conn_id) {
+    return (unsigned int)(conn_id_hash64(conn_id) >> (64 - RL_MAP_SHARD_BITS));
+}
+
+static inline unsigned int key_shard_index(const char* key) {
+    return (unsigned int)(((uint64_t)kh_str_hash_func(key) * 0x9e3779b97f4a7c15ULL) >> (64 - RL_MAP_SHARD_BITS));
+}
+
+// Generations start at 1, so that a zeroed cache never matches
+static inline void bump_generation(uint64_t* generation) {
+    __atomic_add_fetch(generation, 1, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t load_generation(const uint64_t* generation) {
+    return __atomic_load_n(generation, __ATOMIC_ACQUIRE);
+}
+
 static inline int is_valid_violation_policy(speed_hash_value_t* policy, uint32_t curr_sec) {
     uint32_t policy_age_epochs = curr_sec - policy->received_epoch_sec;
     return policy_age_epochs <= BACKOFF_WINDOW_EPOCHS;
@@ -96,21 +199,29 @@ static inline int is_valid_violation_policy(speed_hash_value_t* policy, uint32_t
 // init static variables defined above, this function should be called from main()
 void init_speed_epoch_hashmaps() {
     pthread_t tid;
+    int i;
 
     // Only initialise globals once
-    if (ip_port_key_hashmap != NULL) {
+    if (hashmaps_initialised) {
         return;
     }
-
-    ip_port_key_hashmap = kh_init(ip_port_key_hash);
-    key_ip_port_count_hashmap = kh_init(key_ip_port_count_hash);
-    key_upload_speed_epoch_hashmap = kh_init(speed_hash);
-    key_download_speed_epoch_hashmap = kh_init(speed_hash);
-    if (pthread_rwlock_init(&key_upload_speed_epoch_hashmap_lck, NULL) != 0 ||
-        pthread_rwlock_init(&key_download_speed_epoch_hashmap_lck, NULL) != 0 ||
-        pthread_rwlock_init(&ip_port_key_hashmap_lck, NULL) != 0) {
-        send_log(NULL, LOG_ERR, "failed to init ip_port/speed hashmap locks");
-        exit(1);
+    hashmaps_initialised = 1;
+
+    for (i = 0; i < RL_MAP_SHARDS; i++) {
+        ip_port_key_shards[i].generation = 1;
+        key_upload_speed_epoch_shards[i].generation = 1;
+        key_download_speed_epoch_shards[i].generation = 1;
+        ip_port_key_shards[i].map = kh_init(ip_port_key_hash);
+        key_ip_port_count_shards[i].map = kh_init(key_ip_port_count_hash);
+        key_upload_speed_epoch_shards[i].map = kh_init(speed_hash);
+        key_download_speed_epoch_shards[i].map = kh_init(speed_hash);
+        if (pthread_rwlock_init(&ip_port_key_shards[i].lck, NULL) != 0 ||
+            pthread_rwlock_init(&key_ip_port_count_shards[i].lck, NULL) != 0 ||
+            pthread_rwlock_init(&key_upload_speed_epoch_shards[i].lck, NULL) != 0 ||
+            pthread_rwlock_init(&key_download_speed_epoch_shards[i].lck, NULL) != 0) {
+            send_log(NULL, LOG_ERR, "failed to init ip_port/speed hashmap locks");
+            exit(1);
+        }
     }
     if (pthread_create(&tid, NULL, remove_old_epochs, NULL) != 0) {
         send_log(NULL, LOG_ERR, "failed to create clean-up thread");
@@ -118,118 +229,163 @@ void init_speed_epoch_hashmaps() {
     }
 }
 
-static void debug_print_key_speed_table(khash_t(speed_hash) * hash, pthread_rwlock_t* lck) {
+static void debug_print_key_speed_table(struct speed_shard* shards) {
     khint_t k;
+    int i;
 
-    if (hash == NULL || lck == NULL)
+    if (shards == NULL)
         return;
 
     send_log(NULL, LOG_DEBUG, "start of dumping speed table\n");
-    pthread_rwlock_rdlock(lck);
-    for (k = kh_begin(hash); k != kh_end(hash); ++k) {
-        if (kh_exist(hash, k)) {
-            speed_hash_value_t found = kh_value(hash, k);
-            send_log(NULL, LOG_DEBUG, "key: %s, epoch: %u, diff_ratio: %f\n", kh_key(hash, k), found.received_epoch_sec,
-                     found.diff_ratio);
+    for (i = 0; i < RL_MAP_SHARDS; i++) {
+        khash_t(speed_hash)* hash = shards[i].map;
+
+        pthread_rwlock_rdlock(&shards[i].lck);
+        for (k = kh_begin(hash); k != kh_end(hash); ++k) {
+            if (kh_exist(hash, k)) {
+                speed_hash_value_t found = kh_value(hash, k);
+                send_log(NULL, LOG_DEBUG, "key: %s, epoch: %u, diff_ratio: %f\n", kh_key(hash, k),
+                         found.received_epoch_sec, found.diff_ratio);
+            }
         }
+        pthread_rwlock_unlock(&shards[i].lck);
     }
-    pthread_rwlock_unlock(lck);
     send_log(NULL, LOG_DEBUG, "end of dumping speed table\n");
 }
 
-static inline khash_t(speed_hash) * get_key_speed_hash(DataDirection data_direction) {
+static inline struct speed_shard* get_key_speed_shards(DataDirection data_direction) {
     switch (data_direction) {
     case RL_DOWNLOAD:
-        return key_download_speed_epoch_hashmap;
+        return key_download_speed_epoch_shards;
     case RL_UPLOAD:
-        return key_upload_speed_epoch_hashmap;
-    }
-    return NULL;
-}
-
-static inline pthread_rwlock_t* get_key_speed_hash_lock(DataDirection data_direction) {
-    switch (data_direction) {
-    case RL_DOWNLOAD:
-        return &key_download_speed_epoch_hashmap_lck;
-    case RL_UPLOAD:
-        return &key_upload_speed_epoch_hashmap_lck;
+        return key_upload_speed_epoch_shards;
     }
     return NULL;
 }
 
 void print_out_key_speed_table(DataDirection data_direction) {
-    khash_t(speed_hash) * hash;
-    pthread_rwlock_t* lck;
-    hash = get_key_speed_hash(data_direction);
-    lck = get_key_speed_hash_lock(data_direction);
-    debug_print_key_speed_table(hash, lck);
+    debug_print_key_speed_table(get_key_speed_shards(data_direction));
 }
 
 static inline void incr_num_connections_of_a_key(const char* key) {
-    khint_t k = kh_get(key_ip_port_count_hash, key_ip_port_count_hashmap, key);
+    struct key_ip_port_count_shard* shard = &key_ip_port_count_shards[key_shard_index(key)];
+    khint_t k;
 
-    if (k == kh_end(key_ip_port_count_hashmap)) {
+    pthread_rwlock_wrlock(&shard->lck);
+    k = kh_get(key_ip_port_count_hash, shard->map, key);
+    if (k == kh_end(shard->map)) {
         const char* key_copy = strdup(key);
 
         if (key_copy != NULL) {
             int absent;
 
-            k = kh_put(key_ip_port_count_hash, key_ip_port_count_hashmap, key_copy, &absent);
-            kh_value(key_ip_port_count_hashmap, k) = 1;
+            k = kh_put(key_ip_port_count_hash, shard->map, key_copy, &absent);
+            kh_value(shard->map, k) = 1;
         }
     } else {
-        khint32_t v = kh_value(key_ip_port_count_hashmap, k);
+        khint32_t v = kh_value(shard->map, k);
 
-        kh_value(key_ip_port_count_hashmap, k) = v + 1;
+        kh_value(shard->map, k) = v + 1;
     }
+    pthread_rwlock_unlock(&shard->lck);
 }
 
 static inline void decr_num_connections_of_a_key(const char* key) {
-    khint_t k = kh_get(key_ip_port_count_hash, key_ip_port_count_hashmap, key);
+    struct key_ip_port_count_shard* shard = &key_ip_port_count_shards[key_shard_index(key)];
+    void* acckey = NULL;
+    khint_t k;
 
-    if (k != kh_end(key_ip_port_count_hashmap)) {
-        khint32_t v = kh_value(key_ip_port_count_hashmap, k);
+    pthread_rwlock_wrlock(&shard->lck);
+    k = kh_get(key_ip_port_count_hash, shard->map, key);
+    if (k != kh_end(shard->map)) {
+        khint32_t v = kh_value(shard->map, k);
 
         if (v == 0) {
+            pthread_rwlock_unlock(&shard->lck);
             send_log(NULL, LOG_ERR, "for %s there seems to be no pending conn", key);
             return;
         }
         if (v == 1) {
-            void* acckey = (void*)kh_key(key_ip_port_count_hashmap, k);
-
-            kh_del(key_ip_port_count_hash, key_ip_port_count_hashmap, k);
-            free(acckey);
+            acckey = (void*)kh_key(shard->map, k);
+            kh_del(key_ip_port_count_hash, shard->map, k);
         } else {
-            kh_value(key_ip_port_count_hashmap, k) = v - 1;
+            kh_value(shard->map, k) = v - 1;
         }
     }
+    pthread_rwlock_unlock(&shard->lck);
+    free(acckey);
 }
 
 static inline khint32_t get_ip_port_count_from_key(kh_cstr_t access_key) {
+    struct key_ip_port_count_shard* shard = &key_ip_port_count_shards[key_shard_index(access_key)];
     khint_t k;
     khint32_t count = 0;
 
-    pthread_rwlock_rdlock(&ip_port_key_hashmap_lck);
-    k = kh_get(key_ip_port_count_hash, key_ip_port_count_hashmap, access_key);
-    if (k != kh_end(key_ip_port_count_hashmap)) {
-        count = kh_value(key_ip_port_count_hashmap, k);
+    pthread_rwlock_rdlock(&shard->lck);
+    k = kh_get(key_ip_port_count_hash, shard->map, access_key);
+    if (k != kh_end(shard->map)) {
+        count = kh_value(shard->map, k);
     }
-    pthread_rwlock_unlock(&ip_port_key_hashmap_lck);
+    pthread_rwlock_unlock(&shard->lck);
 
     return count;
 }
 
-static inline kh_cstr_t get_key_from_ip_port(uint64_t ip_port) {
+// Make sure that <cache> holds the access key of the connection <conn_id>, looking it up only if the connection's
+// shard has changed since it was cached. The key is copied, rather than pointed to, because the connection's entry
+// may be replaced or removed by another thread as soon as we release the shard's lock.
+// The shard's generation only changes when a connection's key is replaced by a different one (see set_ip_port_key()),
+// so a connection without a key is looked up again every time, in case its key has been set since.
+// Returns 0 if the connection has no access key.
+static int refresh_cached_key(rl_conn_id_t conn_id, struct rl_conn_cache* cache) {
+    struct ip_port_key_shard* shard = &ip_port_key_shards[conn_shard_index(conn_id)];
+    char previous_key[RL_MAX_KEY_LEN];
     khint_t k;
-    kh_cstr_t access_key = NULL;
 
-    pthread_rwlock_rdlock(&ip_port_key_hashmap_lck);
-    k = kh_get(ip_port_key_hash, ip_port_key_hashmap, ip_port);
-    if (k != kh_end(ip_port_key_hashmap)) {
-        access_key = kh_value(ip_port_key_hashmap, k);
+    if (conn_id_equal(cache->conn_id, conn_id) && cache->access_key[0] != '\0' &&
+        cache->key_generation == load_generation(&shard->generation)) {
+        return 1;
+    }
+
+    strlcpy2(previous_key, cache->access_key, RL_MAX_KEY_LEN);
+    pthread_rwlock_rdlock(&shard->lck);
+    cache->conn_id = conn_id;
+    cache->key_generation = shard->generation;
+    cache->access_key[0] = '\0';
+    k = kh_get(ip_port_key_hash, shard->map, conn_id);
+    if (k != kh_end(shard->map)) {
+        strlcpy2(cache->access_key, kh_value(shard->map, k), RL_MAX_KEY_LEN);
+    }
+    pthread_rwlock_unlock(&shard->lck);
+
+    // The policies we cached were the previous key's
+    if (strcmp(previous_key, cache->access_key) != 0) {
+        cache->policy_generation[RL_UPLOAD] = 0;
+        cache->policy_generation[RL_DOWNLOAD] = 0;
+    }
+    return cache->access_key[0] != '\0';
+}
+
+// Make sure that <cache> holds a copy of the speed policy (if any) of its access key, looking it up only if the key's
+// shard has changed since it was cached
+static void refresh_cached_policy(DataDirection data_direction, struct speed_shard* shards,
+                                  struct rl_conn_cache* cache) {
+    struct speed_shard* shard = &shards[key_shard_index(cache->access_key)];
+    khint_t k;
+
+    if (cache->policy_generation[data_direction] == load_generation(&shard->generation)) {
+        return;
+    }
+
+    pthread_rwlock_rdlock(&shard->lck);
+    cache->policy_generation[data_direction] = shard->generation;
+    cache->policy_exists[data_direction] = 0;
+    k = kh_get(speed_hash, shard->map, cache->access_key);
+    if (k != kh_end(shard->map)) {
+        cache->policy[data_direction] = kh_value(shard->map, k);
+        cache->policy_exists[data_direction] = 1;
     }
-    pthread_rwlock_unlock(&ip_port_key_hashmap_lck);
-    return access_key;
+    pthread_rwlock_unlock(&shard->lck);
 }
 
 static void compute_allowed_run_time(speed_hash_value_t* policy, uint32_t curr_sec) {
@@ -248,72 +404,91 @@ static void compute_allowed_run_time(speed_hash_value_t* policy, uint32_t curr_s
     }
 }
 
-static speed_hash_value_t get_epoch_sec(uint64_t ip_port, DataDirection data_direction, uint32_t curr_sec,
-                                        kh_cstr_t* access_key) {
-    khint_t k;
-    pthread_rwlock_t* lck;
-    khash_t(speed_hash) * hash;
+static speed_hash_value_t get_epoch_sec(rl_conn_id_t conn_id, DataDirection data_direction, uint32_t curr_sec,
+                                        struct rl_conn_cache* cache) {
+    struct speed_shard* shards;
     speed_hash_value_t found = {.throttle = 0};
 
-    if (access_key == NULL) {
-        send_log(NULL, LOG_DEBUG, "Access key is null");
+    if (cache == NULL) {
+        send_log(NULL, LOG_DEBUG, "Connection cache is null");
         return found;
     }
 
-    *access_key = get_key_from_ip_port(ip_port);
-    if (*access_key == NULL || strlen(*access_key) == 0) {
+    if (!refresh_cached_key(conn_id, cache)) {
         send_log(NULL, LOG_DEBUG, "Can not get access key from ip_port_key_hashmap");
         return found;
     }
 
-    hash = get_key_speed_hash(data_direction);
-    lck = get_key_speed_hash_lock(data_direction);
-    if (hash == NULL || lck == NULL) {
+    shards = get_key_speed_shards(data_direction);
+    if (shards == NULL) {
         send_log(NULL, LOG_ERR, "Invalid speed hash map or lock.");
         return found;
     }
+    refresh_cached_policy(data_direction, shards, cache);
+    if (!cache->policy_exists[data_direction]) {
+        return found;
+    }
 
-    pthread_rwlock_rdlock(lck);
-    k = kh_get(speed_hash, hash, *access_key);
-    if (k != kh_end(hash)) {
-        found = kh_value(hash, k);
-        found.throttle = 0;
-        if (is_valid_violation_policy(&found, curr_sec)) {
-            found.throttle = 1;
-            found.num_active_connections = get_ip_port_count_from_key(*access_key);
-            compute_allowed_run_time(&found, curr_sec);
-        }
+    found = cache->policy[data_direction];
+    found.throttle = 0;
+    if (is_valid_violation_policy(&found, curr_sec)) {
+        found.throttle = 1;
+        found.num_active_connections = get_ip_port_count_from_key(cache->access_key);
+        compute_allowed_run_time(&found, curr_sec);
     }
-    pthread_rwlock_unlock(lck);
     return found;
 }
 
+// Removes the stale policies from up to SPEED_TABLE_CLEANUP_BUCKETS_PER_LOCK buckets of <shard>, starting at <begin>.
+// Returns the bucket to carry on from, or 0 once the end of the table has been reached. The table may have been
+// resized since the previous slice, in which case some entries are skipped or checked twice, which is harmless since
+// they'll be checked again on the next pass.
+static khint_t remove_stale_policies(struct speed_shard* shard, khint_t begin, time_t current_epoch) {
+    khash_t(speed_hash)* hash = shard->map;
+    khint_t k, end;
+    int removed = 0;
+
+    pthread_rwlock_wrlock(&shard->lck);
+    end = MIN(kh_end(hash), begin + SPEED_TABLE_CLEANUP_BUCKETS_PER_LOCK);
+    for (k = begin; k < end; k++) {
+        if (kh_exist(hash, k)) {
+            speed_hash_value_t v = kh_value(hash, k);
+            if (current_epoch > v.received_epoch_sec &&
+                current_epoch - v.received_epoch_sec > SPEED_TABLE_STALE_POLICY_AGE_SEC) {
+                free((char*)kh_key(hash, k));
+                kh_del(speed_hash, hash, k);
+                removed = 1;
+            }
+        }
+    }
+    if (removed) {
+        bump_generation(&shard->generation);
+    }
+    if (end >= kh_end(hash)) {
+        end = 0;
+    }
+    pthread_rwlock_unlock(&shard->lck);
+    return end;
+}
+
 static void* remove_old_epochs(void* unused) {
     time_t current_epoch;
-    khint_t k, k_next;
+    khint_t k;
     DataDirection dir = RL_DOWNLOAD;
-    pthread_rwlock_t* lck = NULL;
-    khash_t(speed_hash)* hash = NULL;
+    struct speed_shard* shards = NULL;
+    int i;
 
     while (1) {
-        lck = get_key_speed_hash_lock(dir);
-        hash = get_key_speed_hash(dir);
+        shards = get_key_speed_shards(dir);
         current_epoch = time(NULL);
 
-        pthread_rwlock_wrlock(lck);
-        k = kh_begin(hash);
-        while (k != kh_end(hash)) {
-            k_next = k + 1;
-            if (kh_exist(hash, k)) {
-                speed_hash_value_t v = kh_value(hash, k);
-                if (current_epoch > v.received_epoch_sec &&
-                    current_epoch - v.received_epoch_sec > SPEED_TABLE_STALE_POLICY_AGE_SEC) {
-                    kh_del(speed_hash, hash, k);
-                }
-            }
-            k = k_next;
+        // One slice of one shard at a time, so that lookups and updates can carry on in between
+        for (i = 0; i < RL_MAP_SHARDS; i++) {
+            k = 0;
+            do {
+                k = remove_stale_policies(&shards[i], k, current_epoch);
+            } while (k != 0);
         }
-        pthread_rwlock_unlock(lck);
 
         dir = dir == RL_DOWNLOAD ? RL_UPLOAD : RL_DOWNLOAD;
         usleep(SPEED_TABLE_CLEANUP_PERIOD_USEC);
@@ -322,52 +497,57 @@ static void* remove_old_epochs(void* unused) {
     return NULL;
 }
 
-static inline uint32_t get_jitter_usec(speed_hash_value_t* policy) {
+static inline uint32_t get_jitter_ms(speed_hash_value_t* policy) {
+    const int range_ms = BASE_JITTER_RANGE_MS;
     int jitter = MAX(policy->previous_diff_ratio, policy->diff_ratio) >= DIFF_RATIO_LOW_MARK_TO_JITTER ||
                  policy->diff_ratio - policy->previous_diff_ratio > 0;
 
-    return jitter ? (ha_random32() % BASE_JITTER_RANGE_MS) * UINT_USECS_IN_MILLISEC : 0;
+    return (jitter && range_ms > 0) ? ha_random32() % range_ms : 0;
 }
 
-int rl_speed_throttle(struct sockaddr_in* addr_in, DataDirection data_direction) {
-    uint64_t ip_port;
-    kh_cstr_t access_key;
+int rl_speed_throttle(const struct sockaddr_storage* addr, DataDirection data_direction, struct rl_conn_cache* cache,
+                      uint32_t* jitter_ms) {
+    rl_conn_id_t conn_id;
+    const char* access_key;
     speed_hash_value_t found;
     epoch_t current_epoch = get_current_epoch();
+    char conn[RL_CONN_STR_LEN];
 
-    if (addr_in == NULL)
+    if (jitter_ms != NULL)
+        *jitter_ms = 0;
+    if (!conn_id_from_sockaddr(addr, &conn_id))
         return RL_NO_THROTTLE;
 
-    ip_port = ip_port_from_sockaddr(addr_in);
+    found = get_epoch_sec(conn_id, data_direction, current_epoch.in_seconds, cache);
+    if (0 == found.throttle)
+        return RL_NO_THROTTLE;
 
-    found = get_epoch_sec(ip_port, data_direction, current_epoch.in_seconds, &access_key);
+    // Only logged for throttled users, since send_log formats its message whatever the log level
+    access_key = (cache != NULL) ? cache->access_key : "";
     send_log(NULL, LOG_DEBUG,
-             "in speed_throttle: throttle=%u key=%s curr_epoch=%d ip=%s port=%d "
+             "in speed_throttle: throttle=%u key=%s curr_epoch=%d conn=%s "
              "direction=%s violation_recv_sec=%d elapsed_in_epoch=%lu diff_ratio=%f allowed=%lu\n",
-             found.throttle, access_key, current_epoch.in_seconds, inet_ntoa(addr_in->sin_addr),
-             ntohs(addr_in->sin_port), (data_direction == RL_DOWNLOAD ? "download" : "upload"),
-             found.received_epoch_sec, found.elapsed_usec_in_the_epoch, found.diff_ratio, found.allowed_run_time_usec);
-
-    if (0 == found.throttle)
-        return RL_NO_THROTTLE;
+             found.throttle, access_key, current_epoch.in_seconds, rl_format_conn(addr, conn),
+             (data_direction == RL_DOWNLOAD ? "download" : "upload"), found.received_epoch_sec,
+             found.elapsed_usec_in_the_epoch, found.diff_ratio, found.allowed_run_time_usec);
 
-    // NOTE: extended sleeping in this thread would affect other connections as well.
+    // Sleeping in this thread would stall all of its other connections too, so the jitter is left to the caller
     if (current_epoch.elapsed_usec_in_the_epoch < found.allowed_run_time_usec) {
-        uint32_t jitter_us = get_jitter_usec(&found);
-
-        if (jitter_us > 0) {
-            send_log(NULL, LOG_DEBUG, "Sleeping: jitter=%u\n", jitter_us);
-            usleep(jitter_us);
+        if (jitter_ms != NULL) {
+            *jitter_ms = get_jitter_ms(&found);
+            if (*jitter_ms > 0) {
+                send_log(NULL, LOG_DEBUG, "Deferring: jitter=%ums\n", *jitter_ms);
+            }
         }
         return RL_NO_THROTTLE;
     }
 
     send_log(NULL, LOG_DEBUG,
-             "Slowing down: key=%s curr_epoch=%d ip=%s port=%d direction=%s "
+             "Slowing down: key=%s curr_epoch=%d conn=%s direction=%s "
              "policy_epoch=%u elapsed_in_epoch_us=%lu allowed_run_time_us=%lu diff_ratio=%f "
              "num_conns=%d\n",
-             access_key, current_epoch.in_seconds, inet_ntoa(addr_in->sin_addr), ntohs(addr_in->sin_port),
-             (data_direction == RL_DOWNLOAD ? "download" : "upload"), found.received_epoch_sec,
+             access_key, current_epoch.in_seconds, conn, (data_direction == RL_DOWNLOAD ? "download" : "upload"),
+             found.received_epoch_sec,
              found.elapsed_usec_in_the_epoch, found.allowed_run_time_usec, found.diff_ratio,
              found.num_active_connections);
 
@@ -375,33 +555,62 @@ int rl_speed_throttle(struct sockaddr_in* addr_in, DataDirection data_direction)
     return RL_THROTTLE;
 }
 
-void rl_data_transferred(struct sockaddr_in* addr_in, DataDirection data_direction, unsigned int done) {
-    uint64_t ip_port;
-    kh_cstr_t access_key;
+const char* rl_conn_access_key(const struct sockaddr_storage* addr, DataDirection data_direction, unsigned int done,
+                               struct rl_conn_cache* cache) {
+    rl_conn_id_t conn_id;
+    char conn[RL_CONN_STR_LEN];
 
-    if (addr_in == NULL)
-        return;
+    if (cache == NULL || !conn_id_from_sockaddr(addr, &conn_id))
+        return NULL;
 
-    ip_port = ip_port_from_sockaddr(addr_in);
+    if (!refresh_cached_key(conn_id, cache)) {
+        send_log(NULL, LOG_DEBUG, "Can not get access key from ip_port_key_hashmap: conn=%s direction=%s done=%u",
+                 rl_format_conn(addr, conn), (data_direction == RL_DOWNLOAD ? "download" : "upload"), done);
+        return NULL;
+    }
+    return cache->access_key;
+}
 
-    access_key = get_key_from_ip_port(ip_port);
-    if (access_key == NULL || strlen(access_key) == 0) {
-        send_log(NULL, LOG_DEBUG, "Can not get access key from ip_port_key_hashmap: conn=%s:%d direction=%s done=%u",
-                 inet_ntoa(addr_in->sin_addr), ntohs(addr_in->sin_port),
-                 (data_direction == RL_DOWNLOAD ? "download" : "upload"), done);
+void rl_emit_data_xfer(const struct rl_telemetry* telemetry, const struct sockaddr_storage* addr,
+                       const char* access_key, DataDirection data_direction, unsigned int done,
+                       uint64_t trace_send_usec) {
+    struct rl_telemetry_record record = {};
+    char trace_field[24]; // a delimiter, a 64-bit decimal number and a null-terminator
+    char conn[RL_CONN_STR_LEN];
+
+    record.type = RL_TELEMETRY_DATA_XFER;
+    record.direction = data_direction;
+    record.value = (int32_t)MIN(done, (unsigned int)INT32_MAX);
+    record.trace_send_usec = trace_send_usec;
+    record.user_key = access_key;
+    if (rl_telemetry_send(telemetry, &record)) {
         return;
     }
 
-    send_log(NULL, LOG_INFO, "data_xfer%s%s:%d%s%s%s%s%s%u", LOG_DELIMITER, inet_ntoa(addr_in->sin_addr),
-             ntohs(addr_in->sin_port), LOG_DELIMITER, access_key, LOG_DELIMITER,
-             (data_direction == RL_DOWNLOAD ? "dwn" : "up"), LOG_DELIMITER, done);
+    trace_field[0] = '\0';
+    if (trace_send_usec != 0) {
+        snprintf(trace_field, sizeof(trace_field), "%s%llu", LOG_DELIMITER, (unsigned long long)trace_send_usec);
+    }
+    send_log(NULL, LOG_INFO, "data_xfer%s%s%s%s%s%s%s%u%s", LOG_DELIMITER, rl_format_conn(addr, conn), LOG_DELIMITER,
+             access_key, LOG_DELIMITER, (data_direction == RL_DOWNLOAD ? "dwn" : "up"), LOG_DELIMITER, done,
+             trace_field);
+}
+
+void rl_data_transferred(const struct rl_telemetry* telemetry, const struct sockaddr_storage* addr,
+                         DataDirection data_direction, unsigned int done, uint64_t trace_send_usec,
+                         struct rl_conn_cache* cache) {
+    const char* access_key = rl_conn_access_key(addr, data_direction, done, cache);
+
+    if (access_key == NULL)
+        return;
+    rl_emit_data_xfer(telemetry, addr, access_key, data_direction, done, trace_send_usec);
 }
 
 void set_throttle_epoch_us(const char* key, uint64_t epoch_us, DataDirection data_direction, float diff_ratio) {
     khint_t k;
     int absent;
-    khash_t(speed_hash) * hash;
-    pthread_rwlock_t* lck;
+    struct speed_shard* shards;
+    struct speed_shard* shard;
     epoch_t current_epoch = get_current_epoch();
     speed_hash_value_t value = {
         .throttle = current_epoch.in_seconds,
@@ -421,44 +630,48 @@ void set_throttle_epoch_us(const char* key, uint64_t epoch_us, DataDirection dat
              "elapsed_usec_in_the_epoch=%lu diff_ratio=%f\n",
              key, epoch_us, value.received_epoch_sec, value.elapsed_usec_in_the_epoch, value.diff_ratio);
 
-    hash = get_key_speed_hash(data_direction);
-    lck = get_key_speed_hash_lock(data_direction);
-    if (hash == NULL || lck == NULL) {
+    shards = get_key_speed_shards(data_direction);
+    if (shards == NULL) {
         send_log(NULL, LOG_ERR, "Invalid speed hash map or lock.");
         return;
     }
+    shard = &shards[key_shard_index(key)];
 
-    pthread_rwlock_wrlock(lck);
-    k = kh_get(speed_hash, hash, key);
-    if (k != kh_end(hash)) {
-        speed_hash_value_t found = kh_value(hash, k);
+    pthread_rwlock_wrlock(&shard->lck);
+    k = kh_get(speed_hash, shard->map, key);
+    if (k != kh_end(shard->map)) {
+        speed_hash_value_t found = kh_value(shard->map, k);
 
         value.previous_diff_ratio = found.diff_ratio;
-        kh_value(hash, k) = value;
+        kh_value(shard->map, k) = value;
     } else {
         char* t = strdup(key); // we need to own the key in our hash maps.
         if (t != NULL) {
-            k = kh_put(speed_hash, hash, t, &absent);
-            kh_value(hash, k) = value;
+            k = kh_put(speed_hash, shard->map, t, &absent);
+            kh_value(shard->map, k) = value;
         } else {
             send_log(NULL, LOG_ERR, "Running out of memory");
         }
     }
-    pthread_rwlock_unlock(lck);
+    bump_generation(&shard->generation);
+    pthread_rwlock_unlock(&shard->lck);
 }
 
-static inline uint64_t get_ip_port(const char* ip_str, const char* port_str) {
+// Returns 0 if <ip_str> is neither an IPv4 nor an IPv6 address
+static inline int get_conn_id(const char* ip_str, const char* port_str, rl_conn_id_t* id) {
     struct in_addr addr;
-    uint16_t port;
-    uint32_t ip;
+    struct in6_addr addr6;
+    const uint16_t port = (uint16_t)atoi(port_str);
 
-    if (inet_pton(AF_INET, ip_str, &addr)) {
-        port = (uint16_t)atoi(port_str);
-        ip = ntohl(addr.s_addr);
-        return (uint64_t)ip << 32 | port;
-    } else {
-        return 0;
+    if (inet_pton(AF_INET, ip_str, &addr) == 1) {
+        conn_id_from_ipv4(id, &addr, port);
+        return 1;
+    }
+    if (inet_pton(AF_INET6, ip_str, &addr6) == 1) {
+        conn_id_from_ipv6(id, &addr6, port);
+        return 1;
     }
+    return 0;
 }
 
 void set_jitter_range(uint32_t range) {
@@ -467,7 +680,7 @@ void set_jitter_range(uint32_t range) {
 }
 
 void set_ip_port_key(const char* ip, const char* port, const char* key) {
-    uint64_t ip_port;
+    rl_conn_id_t conn_id;
     int absent;
     char* key_copy;
     khint_t k;
@@ -476,27 +689,40 @@ void set_ip_port_key(const char* ip, const char* port, const char* key) {
         send_log(NULL, LOG_WARNING, "Empty access key is used to set speed.");
         return;
     }
+    if (strlen(key) >= RL_MAX_KEY_LEN) {
+        // The key wouldn't fit in a stream's rl_conn_cache, so its connections are neither throttled nor reported
+        send_log(NULL, LOG_ERR, "Access key is longer than %d bytes, its bandwidth won't be limited: %.32s...",
+                 RL_MAX_KEY_LEN - 1, key);
+        return;
+    }
     send_log(NULL, LOG_DEBUG, "set_ip_port_key: ip=%s port=%s key=%s\n", ip, port, key);
 
     // In case of ip_port is reused (http-keep-alive) across multiple keys,
     // simply updating the ip_port -> key map should be enough.
-    ip_port = get_ip_port(ip, port);
-    if (ip_port != 0) {
+    if (get_conn_id(ip, port, &conn_id)) {
         key_copy = strdup(key);
         if (key_copy != NULL) {
+            struct ip_port_key_shard* shard = &ip_port_key_shards[conn_shard_index(conn_id)];
             void* p = NULL;
-            pthread_rwlock_wrlock(&ip_port_key_hashmap_lck);
-            k = kh_get(ip_port_key_hash, ip_port_key_hashmap, ip_port);
-            if (k != kh_end(ip_port_key_hashmap)) {
+
+            pthread_rwlock_wrlock(&shard->lck);
+            k = kh_get(ip_port_key_hash, shard->map, conn_id);
+            if (k != kh_end(shard->map)) {
                 // not reusing the key buffer is because the keys might have different lengths
-                p = (void*)kh_value(ip_port_key_hashmap, k);
+                p = (void*)kh_value(shard->map, k);
+                // Only the streams that cached the previous key need to look it up again. A new mapping needs no
+                // bump, since a connection without a key is never cached.
+                if (strcmp(p, key_copy) != 0) {
+                    bump_generation(&shard->generation);
+                }
             } else {
-                k = kh_put(ip_port_key_hash, ip_port_key_hashmap, ip_port, &absent);
+                k = kh_put(ip_port_key_hash, shard->map, conn_id, &absent);
             }
-            kh_value(ip_port_key_hashmap, k) = key_copy;
+            kh_value(shard->map, k) = key_copy;
+            pthread_rwlock_unlock(&shard->lck);
+
             incr_num_connections_of_a_key(key);
             send_log(NULL, LOG_DEBUG, "set_ip_port_key set: ip=%s port=%s key=%s\n", ip, port, key);
-            pthread_rwlock_unlock(&ip_port_key_hashmap_lck);
             free(p);
         } else {
             send_log(NULL, LOG_ERR, "Running out of memory");
@@ -506,29 +732,146 @@ void set_ip_port_key(const char* ip, const char* port, const char* key) {
     }
 }
 
-static void remove_from_ip_port_key_hash(uint64_t ip_port) {
+static void remove_from_ip_port_key_hash(rl_conn_id_t conn_id) {
+    struct ip_port_key_shard* shard = &ip_port_key_shards[conn_shard_index(conn_id)];
     khint_t k;
     kh_cstr_t access_key = NULL;
 
-    pthread_rwlock_wrlock(&ip_port_key_hashmap_lck);
-    k = kh_get(ip_port_key_hash, ip_port_key_hashmap, ip_port);
-    if (k != kh_end(ip_port_key_hashmap)) {
-        access_key = kh_value(ip_port_key_hashmap, k);
-        kh_del(ip_port_key_hash, ip_port_key_hashmap, k);
-        decr_num_connections_of_a_key(access_key);
+    pthread_rwlock_wrlock(&shard->lck);
+    // The generation is left alone: the mapping is removed when a stream on the connection ends, and any other
+    // stream still running on it carries on with the key it already has rather than with none
+    k = kh_get(ip_port_key_hash, shard->map, conn_id);
+    if (k != kh_end(shard->map)) {
+        access_key = kh_value(shard->map, k);
+        kh_del(ip_port_key_hash, shard->map, k);
     }
-    pthread_rwlock_unlock(&ip_port_key_hashmap_lck);
+    pthread_rwlock_unlock(&shard->lck);
 
+    if (access_key != NULL) {
+        decr_num_connections_of_a_key(access_key);
+    }
     free((void*)access_key);
 }
 
-static void remove_from_rate_limit_map(struct sockaddr_in* addr_in) {
-    uint64_t ip_port = ip_port_from_sockaddr(addr_in);
-    remove_from_ip_port_key_hash(ip_port);
-}
+void rl_request_end(const struct sockaddr_storage* addr) {
+    rl_conn_id_t conn_id;
 
-void rl_request_end(struct sockaddr_in* addr_in) {
-    if (addr_in == NULL)
+    if (!conn_id_from_sockaddr(addr, &conn_id))
         return;
-    remove_from_rate_limit_map(addr_in);
+    remove_from_ip_port_key_hash(conn_id);
+}
+
+// Binary records: a fixed header, then the strings of the record, each prefixed by its length. Multi-byte fields are
+// little-endian. The layout is given in full in docs/syslog-server-api.md.
+#define RL_TELEMETRY_MAGIC 0xfe
+#define RL_TELEMETRY_VERSION 1
+#define RL_TELEMETRY_FLAG_DOWNLOAD 0x01
+#define RL_TELEMETRY_FLAG_TRACED 0x02
+#define RL_TELEMETRY_MAX_STRING_LEN 255
+#define RL_TELEMETRY_MAX_RECORD_SIZE (16 + 4 * (1 + RL_TELEMETRY_MAX_STRING_LEN))
+
+void rl_telemetry_init(struct rl_telemetry* telemetry) {
+    memset(telemetry, 0, sizeof(*telemetry));
+    telemetry->fd = -1;
+}
+
+int rl_telemetry_open(struct rl_telemetry* telemetry, const char* target) {
+    char host[INET_ADDRSTRLEN];
+    const char* colon = strrchr(target, ':');
+    char* end = NULL;
+    struct sockaddr_in addr;
+    unsigned long port;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    if (colon == NULL || (size_t)(colon - target) >= sizeof(host)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(host, target, colon - target);
+    host[colon - target] = '\0';
+    port = strtoul(colon + 1, &end, 10);
+    if (*(colon + 1) == '\0' || *end != '\0' || port == 0 || port > 65535 ||
+        inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    addr.sin_port = htons((uint16_t)port);
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (fd < 0) {
+        return -1;
+    }
+    rl_telemetry_close(telemetry);
+    telemetry->fd = fd;
+    telemetry->addr = addr;
+    return 0;
+}
+
+void rl_telemetry_close(struct rl_telemetry* telemetry) {
+    if (telemetry->fd >= 0) {
+        close(telemetry->fd);
+    }
+    rl_telemetry_init(telemetry);
+}
+
+static inline char* put_le(char* pos, uint64_t value, int size) {
+    int i;
+
+    for (i = 0; i < size; i++) {
+        *pos++ = (char)(value >> (8 * i));
+    }
+    return pos;
+}
+
+static inline char* put_string(char* pos, const char* str, size_t len) {
+    *pos++ = (char)len;
+    memcpy(pos, str, len);
+    return pos + len;
+}
+
+int rl_telemetry_send(const struct rl_telemetry* telemetry, const struct rl_telemetry_record* record) {
+    char buf[RL_TELEMETRY_MAX_RECORD_SIZE];
+    const char* strings[4];
+    size_t lengths[4];
+    int string_count = 0;
+    char* pos = buf;
+    int i;
+
+    if (telemetry->fd < 0 || record->user_key == NULL) {
+        return 0;
+    }
+
+    strings[string_count++] = record->user_key;
+    if (record->verb != NULL)
+        strings[string_count++] = record->verb;
+    if (record->instance_id != NULL)
+        strings[string_count++] = record->instance_id;
+    if (record->request_class != NULL)
+        strings[string_count++] = record->request_class;
+    for (i = 0; i < string_count; i++) {
+        lengths[i] = strlen(strings[i]);
+        if (lengths[i] > RL_TELEMETRY_MAX_STRING_LEN) {
+            return 0;
+        }
+    }
+
+    *pos++ = (char)RL_TELEMETRY_MAGIC;
+    *pos++ = RL_TELEMETRY_VERSION;
+    *pos++ = (char)record->type;
+    *pos++ = (char)((record->direction == RL_DOWNLOAD ? RL_TELEMETRY_FLAG_DOWNLOAD : 0) |
+                    (record->trace_send_usec != 0 ? RL_TELEMETRY_FLAG_TRACED : 0));
+    pos = put_le(pos, (uint32_t)record->value, sizeof(uint32_t));
+    if (record->trace_send_usec != 0) {
+        pos = put_le(pos, record->trace_send_usec, sizeof(uint64_t));
+    }
+    for (i = 0; i < string_count; i++) {
+        pos = put_string(pos, strings[i], lengths[i]);
+    }
+
+    // Like HAProxy's own UDP logging, this never blocks: a record that the socket can't take right now is dropped
+    sendto(telemetry->fd, buf, pos - buf, MSG_DONTWAIT | MSG_NOSIGNAL, (const struct sockaddr*)&telemetry->addr,
+           sizeof(telemetry->addr));
+    return 1;
 }
@@ -32,6 +32,7 @@ from weir.models.user_metrics import (
 )
 from weir.models.violations import Violations
 from weir.services.metric_service import MetricService
+from weir.services.redis_shards import RedisShards
 
 MB = 1048576  # 1024*1024
 
@@ -361,15 +362,19 @@ class PolicyGenerator:
             DEFAULT_AREQ_LIMIT_IF_QOS_IS_NOT_CONFIGURED,
         )
 
-        # QoS redis server
-        redis_configs = self.config["redis_server"].split(":")
-        self.redis_server = redis.Redis(
-            host=redis_configs[0],
-            port=int(redis_configs[1]),
-            db=0,
-            decode_responses=True,
-        )
-        self.logger.info(f"Connecting to redisServer {self.config['redis_server']}")
+        # QoS redis servers. Each user's stats are all on one shard, so shards can be checked independently.
+        self.redis_servers: list[redis.Redis] = []
+        for redis_address in RedisShards.addresses_from_config(self.config):
+            redis_configs = redis_address.split(":")
+            self.redis_servers.append(
+                redis.Redis(
+                    host=redis_configs[0],
+                    port=int(redis_configs[1]),
+                    db=0,
+                    decode_responses=True,
+                )
+            )
+            self.logger.info(f"Connecting to redisServer {redis_address}")
 
         # thread pool for checking policy violations
         self.avgChkVioRunTimeList: list[float] = []
@@ -660,14 +665,18 @@ class PolicyGenerator:
                 del self.blocked_users[metric.access_key]
 
     def _check_violation(
-        self, keys: list[str], redis_key_type: str, epoch_time: float
+        self,
+        redis_server: redis.Redis,
+        keys: list[str],
+        redis_key_type: str,
+        epoch_time: float,
     ) -> None:
         self.logger.debug(f"_check_violation for {len(keys)} keys")
 
         @avg_time(self.avgChkVioRunTimeList, 5000, self.zone, self.logger, len(keys))
         def check_violation_key(keys: list[str], redis_key_type: str) -> None:
             redis_scan_result = self.call_redis_eval(
-                self.redis_get_lua, self.redis_get_sha1, keys
+                redis_server, self.redis_get_lua, self.redis_get_sha1, keys
             )
             self.logger.debug(f"redis result: {redis_scan_result}")
 
@@ -686,11 +695,13 @@ class PolicyGenerator:
 
         self.policies.prepare_message(self.haproxies_map, epoch_time)
 
-    def call_redis_eval(self, script: str, script_sha1: str, keys: list[str]) -> Any:
+    def call_redis_eval(
+        self, redis_server: redis.Redis, script: str, script_sha1: str, keys: list[str]
+    ) -> Any:
         try:
-            return self.redis_server.evalsha(script_sha1, len(keys), *keys)
+            return redis_server.evalsha(script_sha1, len(keys), *keys)
         except redis.exceptions.NoScriptError:
-            return self.redis_server.eval(script, len(keys), *keys)
+            return redis_server.eval(script, len(keys), *keys)
 
     def reload_limits(self) -> None:
         self.logger.info(f"Reloading limits from config file {self.key_limits_path}")
@@ -701,11 +712,15 @@ class PolicyGenerator:
         )
 
     def submit_violation_check(
-        self, keys: list[str], redis_key_type: str, epoch_time: float
+        self,
+        redis_server: redis.Redis,
+        keys: list[str],
+        redis_key_type: str,
+        epoch_time: float,
     ) -> None:
         if len(keys) > 0:
             self.vio_chk_executor.submit(
-                self._check_violation, keys, redis_key_type, epoch_time
+                self._check_violation, redis_server, keys, redis_key_type, epoch_time
             )
 
     def compute_bandwidth_limit_share(self, demand: DemandMap) -> DemandMap:
@@ -764,42 +779,47 @@ def check_loop(
         else:
             raise ValueError(f"Invalid redis key type: {redis_key_type}")
 
-        all_keys_to_check = set()
-        while True:
-            try:
-                redis_scan_result = policy_generator.redis_server.scan(
-                    cursor, match=scan_pattern, count=policy_generator.redis_keys_batch
-                )
-                # Redis mandates that SCAN will return 2 elements: the length of the result and an array of results
-                assert isinstance(redis_scan_result, tuple)
-                assert len(redis_scan_result) == 2
-            except Exception as e:
-                policy_generator.logger.warning(
-                    f"Redis SCAN failed with exception: {e}"
-                )
-                policy_generator.logger.warning(
-                    f"Redis result for epoch {epoch_sec}: {redis_scan_result}"
-                )
-                # We need to find the cause of the underlying problem if this happens.
-                # We break here since the cursor in redis_scan_result might
-                # have been messed up here.
-                break
-
-            epoch_time = time.time()
-            if int(epoch_time) != epoch_sec:
-                policy_generator.logger.debug(
-                    f"Redis scan started at {epoch_time} spilled over the next second"
-                )
-                return
+        # Each shard is checked separately, since all the keys of a user are on the same shard
+        for redis_server in policy_generator.redis_servers:
+            all_keys_to_check = set()
+            while True:
+                try:
+                    redis_scan_result = redis_server.scan(
+                        cursor,
+                        match=scan_pattern,
+                        count=policy_generator.redis_keys_batch,
+                    )
+                    # Redis mandates that SCAN will return 2 elements: the length of the result and an array of results
+                    assert isinstance(redis_scan_result, tuple)
+                    assert len(redis_scan_result) == 2
+                except Exception as e:
+                    policy_generator.logger.warning(
+                        f"Redis SCAN failed with exception: {e}"
+                    )
+                    policy_generator.logger.warning(
+                        f"Redis result for epoch {epoch_sec}: {redis_scan_result}"
+                    )
+                    # We need to find the cause of the underlying problem if this happens.
+                    # We break here since the cursor in redis_scan_result might
+                    # have been messed up here.
+                    break
 
-            all_keys_to_check.update(redis_scan_result[1])
-            cursor = int(redis_scan_result[0])
-            if cursor == 0:
-                break
-        if len(all_keys_to_check) > 0:
-            policy_generator.submit_violation_check(
-                list(all_keys_to_check), redis_key_type, epoch_time
-            )
+                epoch_time = time.time()
+                if int(epoch_time) != epoch_sec:
+                    policy_generator.logger.debug(
+                        f"Redis scan started at {epoch_time} spilled over the next second"
+                    )
+                    return
+
+                all_keys_to_check.update(redis_scan_result[1])
+                cursor = int(redis_scan_result[0])
+                if cursor == 0:
+                    break
+            cursor = 0
+            if len(all_keys_to_check) > 0:
+                policy_generator.submit_violation_check(
+                    redis_server, list(all_keys_to_check), redis_key_type, epoch_time
+                )
 
     while True:
         # check reload_limits
@@ -857,15 +877,22 @@ def demand_check_loop(
         try:
             # SCAN is permitted to return duplicates. So we need to filter those out and just keep
             # a list of unique keys, otherwise we can double-count some entries
-            conn_keys = list(
-                set(
-                    policy_generator.redis_server.scan_iter(
-                        match="conn_v2_*", count=policy_generator.redis_keys_batch
+            conn_keys: list[str] = []
+            conn_counts: list[str | None] = []
+            for redis_server in policy_generator.redis_servers:
+                shard_conn_keys = list(
+                    set(
+                        redis_server.scan_iter(
+                            match="conn_v2_*", count=policy_generator.redis_keys_batch
+                        )
                     )
                 )
-            )
-            conn_counts = policy_generator.redis_server.mget(conn_keys)
-            assert isinstance(conn_counts, list)
+                if len(shard_conn_keys) == 0:
+                    continue
+                shard_conn_counts = redis_server.mget(shard_conn_keys)
+                assert isinstance(shard_conn_counts, list)
+                conn_keys.extend(shard_conn_keys)
+                conn_counts.extend(shard_conn_counts)
         except Exception as e:
             policy_generator.logger.warning(
                 "Failed to collect demand info from redis", exc_info=e
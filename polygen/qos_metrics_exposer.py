@@ -19,6 +19,7 @@ import yaml
 from prometheus_client import Gauge, start_http_server
 from weir.models.user_metrics import Metric, UsageType, UserLevelUsage
 from weir.services.metric_service import MetricService
+from weir.services.redis_shards import RedisShards
 
 prometheus_client.REGISTRY.unregister(prometheus_client.GC_COLLECTOR)
 prometheus_client.REGISTRY.unregister(prometheus_client.PLATFORM_COLLECTOR)
@@ -159,21 +160,25 @@ MIN_SLEEP_TIME_SEC_PER_ROUND = 0.1  # 100 msec
 
 
 def redis_consumer_process(
-    metrics_queue: "MetricsQueue", redis_server: str
+    metrics_queue: "MetricsQueue", redis_servers: list[str]
 ) -> NoReturn:
-    rs_conn: redis.Redis | None = None
+    rs_conns: list[redis.Redis | None] = [None] * len(redis_servers)
 
     logger.info("redis consumer starting")
 
     while True:
         try:
-            if rs_conn is None or not rs_conn.ping():
-                rs_conn = get_redis_server_connection(redis_server)
-
             start_time = time.time()
             start_epoch = int(start_time)
 
-            redis_data = retrieve_data_from_redis(rs_conn, start_epoch)
+            # Every user's stats are on exactly one of the shards, so the data from all of them can simply be combined
+            redis_data: list[UserLevelUsage] = []
+            for i, redis_server in enumerate(redis_servers):
+                rs_conn = rs_conns[i]
+                if rs_conn is None or not rs_conn.ping():
+                    rs_conn = get_redis_server_connection(redis_server)
+                    rs_conns[i] = rs_conn
+                redis_data.extend(retrieve_data_from_redis(rs_conn, start_epoch))
             if len(redis_data) > 0:
                 metrics_queue.put(process_data_retrieved_from_redis(redis_data))
 
@@ -306,13 +311,13 @@ def run_publisher_process(metrics_queue: "MetricsQueue") -> None:
 #
 
 
-def main(qos_redis_server: str) -> None:
+def main(qos_redis_servers: list[str]) -> None:
     metrics_queue: "MetricsQueue" = multiprocessing.Queue()
     publisher_process = multiprocessing.Process(
         target=run_publisher_process, args=(metrics_queue,)
     )
     publisher_process.start()
-    redis_consumer_process(metrics_queue, qos_redis_server)
+    redis_consumer_process(metrics_queue, qos_redis_servers)
 
 
 def load_config_file(config_file: str) -> dict[str, Any]:
@@ -338,4 +343,4 @@ if __name__ == "__main__":
     )
     METRICS_ENDPOINT_PORT: int = config_file.get("qos_metrics_endpoint_port", -1)
 
-    main(config_file["redis_server"])
+    main(RedisShards.addresses_from_config(config_file))
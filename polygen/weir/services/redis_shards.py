@@ -0,0 +1,52 @@
+# Copyright 2024 Bloomberg Finance L.P.
+# Distributed under the terms of the Apache 2.0 license.
+from typing import Any
+
+FNV_OFFSET_BASIS = 0xCBF29CE484222325
+FNV_PRIME = 0x100000001B3
+UINT64_MASK = (1 << 64) - 1
+
+
+class RedisShards:
+    """
+    The QoS stats may be spread across several redis servers ("shards"). syslog_server writes all the stats of a
+    user to one shard, chosen with the same consistent hash as `shard_for_user` (see syslog_server's
+    redis_sharding.h), so the two must be configured with the same list of servers in the same order.
+    """
+
+    @staticmethod
+    def addresses_from_config(config: dict[str, Any]) -> list[str]:
+        """The `<host>:<port>` of every shard, from either `redis_servers` (a list) or `redis_server`"""
+        if "redis_servers" in config:
+            servers = config["redis_servers"]
+            if not isinstance(servers, list) or len(servers) == 0:
+                raise ValueError("redis_servers must be a non-empty list of addresses")
+            return [str(server) for server in servers]
+        return [config["redis_server"]]
+
+    @staticmethod
+    def fnv1a64(value: str) -> int:
+        value_hash = FNV_OFFSET_BASIS
+        for byte in value.encode("utf-8"):
+            value_hash ^= byte
+            value_hash = (value_hash * FNV_PRIME) & UINT64_MASK
+        return value_hash
+
+    @staticmethod
+    def jump_consistent_hash(key: int, bucket_count: int) -> int:
+        """Jump consistent hash (Lamping & Veach, https://arxiv.org/abs/1406.2294)"""
+        bucket = -1
+        next_bucket = 0
+        while next_bucket < bucket_count:
+            bucket = next_bucket
+            key = (key * 2862933555777941757 + 1) & UINT64_MASK
+            next_bucket = int((bucket + 1) * (float(1 << 31) / float((key >> 33) + 1)))
+        return bucket
+
+    @staticmethod
+    def shard_for_user(user_key: str, shard_count: int) -> int:
+        if shard_count <= 1:
+            return 0
+        return RedisShards.jump_consistent_hash(
+            RedisShards.fnv1a64(user_key), shard_count
+        )
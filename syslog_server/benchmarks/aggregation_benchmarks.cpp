@@ -0,0 +1,119 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+// Micro-benchmarks of the maps that the Processor aggregates events into between flushes to redis.
+// Each iteration simulates one flush period: a batch of updates spread over `users x verbs x seconds` distinct keys,
+// followed by a pass over every entry (as when sending to redis) and a clear.
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "flat_hash_map.h"
+
+namespace {
+
+constexpr uint32_t VERB_COUNT = 5;
+constexpr uint32_t SECOND_COUNT = 2;
+constexpr size_t UPDATES_PER_FLUSH = 250000;
+
+// Mirrors Processor::RedisCmdKey: interned user & category ids and the second the event happened in
+struct IdKey {
+    uint32_t m_user;
+    uint32_t m_second;
+    uint32_t m_cat;
+
+    bool operator==(const IdKey& other) const = default;
+};
+struct IdKeyHash {
+    std::size_t operator()(const IdKey& k) const {
+        uint64_t h = ((static_cast<uint64_t>(k.m_user) << 32) | k.m_cat) ^ (k.m_second * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h);
+    }
+};
+
+// The key the Processor used before interning, with the user and category stored as strings
+struct StringKey {
+    std::string m_user;
+    uint32_t m_second;
+    std::string m_cat;
+
+    bool operator==(const StringKey& other) const = default;
+};
+struct StringKeyHash {
+    std::size_t operator()(const StringKey& k) const {
+        return std::hash<std::string>()(k.m_user) ^ (std::hash<uint32_t>()(k.m_second) << 1) ^
+               (std::hash<std::string>()(k.m_cat) << 2);
+    }
+};
+
+std::vector<IdKey> makeUpdates(uint32_t user_count) {
+    std::mt19937 rng(1234);
+    std::vector<IdKey> updates(UPDATES_PER_FLUSH);
+    for (auto& key : updates) {
+        key = {static_cast<uint32_t>(rng() % user_count), static_cast<uint32_t>(rng() % SECOND_COUNT),
+               static_cast<uint32_t>(rng() % VERB_COUNT)};
+    }
+    return updates;
+}
+
+template <typename Map>
+void aggregateIdKeys(benchmark::State& state) {
+    const auto updates = makeUpdates(static_cast<uint32_t>(state.range(0)));
+    Map map;
+    for (auto _ : state) {
+        for (const auto& key : updates) {
+            map[key] += 1;
+        }
+        int64_t total = 0;
+        for (const auto& [key, value] : map) {
+            total += value;
+        }
+        benchmark::DoNotOptimize(total);
+        map.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * updates.size());
+}
+
+void BM_UnorderedMapIdKeys(benchmark::State& state) {
+    aggregateIdKeys<std::unordered_map<IdKey, int, IdKeyHash>>(state);
+}
+void BM_FlatHashMapIdKeys(benchmark::State& state) {
+    aggregateIdKeys<syslogsrv::FlatHashMap<IdKey, int, IdKeyHash>>(state);
+}
+
+// The original aggregation: string keys in a std::unordered_map, built from the message fields for every update
+void BM_UnorderedMapStringKeys(benchmark::State& state) {
+    const auto updates = makeUpdates(static_cast<uint32_t>(state.range(0)));
+    std::vector<std::string> users(state.range(0));
+    for (size_t i = 0; i < users.size(); ++i) {
+        users[i] = "AKIAIOSFODNN" + std::to_string(10000000 + i);
+    }
+    const std::string verbs[VERB_COUNT] = {"GET", "PUT", "HEAD", "DELETE", "POST"};
+
+    std::unordered_map<StringKey, int, StringKeyHash> map;
+    for (auto _ : state) {
+        for (const auto& key : updates) {
+            map[StringKey{"user_" + users[key.m_user], key.m_second, verbs[key.m_cat]}] += 1;
+        }
+        int64_t total = 0;
+        for (const auto& [key, value] : map) {
+            total += value;
+        }
+        benchmark::DoNotOptimize(total);
+        map.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * updates.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_UnorderedMapStringKeys)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_UnorderedMapIdKeys)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FlatHashMapIdKeys)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,322 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+// A workload generator for the Weir syslog server, see `--help`.
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/ip.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "message_queue.h"
+#include "processor_harness.h"
+#include "workload.h"
+
+using namespace syslogsrv::bench;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace {
+
+// Each sender cycles through its own pool of messages, so that generating them isn't part of the cost of sending
+constexpr size_t MESSAGE_POOL_SIZE = 100'000;
+constexpr size_t FLUSH_MESSAGES = 10'000;
+
+struct Options {
+    WorkloadOptions m_workload;
+    long m_msgs_per_second = 100'000;
+    long m_destination_port = 9003;
+    long m_threads = 1;
+    long m_burst = 10;
+    long m_duration_seconds = 0; // 0 runs forever
+    long m_in_process_messages = 0;
+    bool m_verbose = false;
+};
+
+size_t get_udp_error_count(bool print_error_counts) {
+    // We read all the stats from /proc/net/snmp and add together a few of the relevant values.
+    FILE* f = fopen("/proc/net/snmp", "r");
+    if (f == nullptr) {
+        return 0;
+    }
+    char buffer[4096] = {};
+    fread(buffer, sizeof(buffer) - 1, 1, f);
+    fclose(f);
+
+    const char* udp_header_line = strstr(buffer, "Udp: ");
+    assert(udp_header_line != nullptr);
+    const char* udp_stat_line = strstr(udp_header_line + 1, "Udp: ");
+    assert(udp_stat_line != nullptr);
+
+    size_t in_datagrams;
+    size_t no_ports;
+    size_t in_errors;
+    size_t out_datagrams;
+    size_t recvbuf_errors;
+    size_t sndbuf_errors;
+    size_t in_csum_errors;
+    size_t ignored_multi;
+    size_t mem_errors;
+    const int match_count =
+        sscanf(udp_stat_line, "Udp: %zu %zu %zu %zu %zu %zu %zu %zu %zu\n", &in_datagrams, &no_ports, &in_errors,
+               &out_datagrams, &recvbuf_errors, &sndbuf_errors, &in_csum_errors, &ignored_multi, &mem_errors);
+    if (match_count <= 0) {
+        printf("Failed to find recvbuf error count\n");
+        return 0;
+    }
+
+    if (print_error_counts) {
+        printf("UDP errors: %zu %zu %zu %zu %zu %zu %zu\n", no_ports, in_errors, recvbuf_errors, sndbuf_errors,
+               in_csum_errors, ignored_multi, mem_errors);
+    }
+    return no_ports + in_errors + recvbuf_errors + sndbuf_errors;
+}
+
+void printUsage() {
+    printf("syslog-server-loadgen: A workload generator for the Weir syslog server\n");
+    printf("Usage: syslog-server-loadgen [options]\n");
+    printf("\n");
+    printf("Workload:\n");
+    printf("--users <N>: The number of distinct users sending requests, defaults to 1000.\n");
+    printf("--skew <X>: The exponent of the Zipf distribution users are drawn from, defaults to 0 (uniform).\n");
+    printf("--mix <spec>: The relative frequency of each event type, defaults to\n");
+    printf("              req:1,req_end:1,data_xfer:8,active_reqs:0\n");
+    printf("--key-length <N>: The length of the user keys, defaults to 20.\n");
+    printf("--class-length <N>: The length of the request classes, defaults to 0 (none).\n");
+    printf("--seed <N>: Seeds the random workload, defaults to 1.\n");
+    printf("--binary: Send the events as binary records rather than as text.\n");
+    printf("\n");
+    printf("Sending over UDP (the default):\n");
+    printf("--msgs <N>: The total number of messages to send per second, defaults to 100,000.\n");
+    printf("--port <N>: The port to which the UDP messages should be sent, defaults to 9003.\n");
+    printf("--threads <N>: The number of threads sending messages, defaults to 1.\n");
+    printf("--burst <N>: The number of messages each thread sends back to back, defaults to 10.\n");
+    printf("--duration <N>: Stop after N seconds, defaults to 0 (never).\n");
+    printf("--verbose: Enable debugging output\n");
+    printf("\n");
+    printf("Processing in-process:\n");
+    printf("--in-process <N>: Instead of sending messages, process N of them with a syslog server processor\n");
+    printf("                  connected to a fake redis, and report the throughput, the p50/p99 time taken by\n");
+    printf("                  each message and the number of redis commands sent per flush of %zu messages.\n",
+           FLUSH_MESSAGES);
+    printf("\n");
+    printf("When sending over UDP, this tool will send control messages to the Weir syslog-server at a defined\n");
+    printf("rate and periodically report the number of UDP errors reported by kernel.\n");
+    printf("If the reported error count is not zero when sending many messages, it suggests that\n");
+    printf("the syslog server is unable to keep up with that workload on the current hardware, and\n");
+    printf("would need to either be reconfigured or optimised to be faster.\n");
+    printf("\n");
+    printf("In conjunction with the output of this tool, one should check the output of the\n");
+    printf("syslog server itself while running the test, because in addition to dropping packets\n");
+    printf("in the kernel, there is an internal fixed-size queue, which could fill up in extreme\n");
+    printf("circumstances, causing it to also drop messages.\n");
+}
+
+// Returns false (having explained why) if the arguments are invalid
+bool parseArgs(int argc, const char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--verbose") == 0) {
+            options.m_verbose = true;
+            continue;
+        }
+        if (strcmp(arg, "--binary") == 0) {
+            options.m_workload.m_binary = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printf("No value given for %s\n", arg);
+            return false;
+        }
+        const char* value = argv[++i];
+        char* end = nullptr;
+        const long number = strtol(value, &end, 10);
+        const bool is_number = (*value != '\0') && (*end == '\0');
+        const bool is_positive = is_number && (number > 0);
+
+        bool valid = true;
+        if (strcmp(arg, "--msgs") == 0) {
+            valid = is_positive;
+            options.m_msgs_per_second = number;
+        } else if (strcmp(arg, "--port") == 0) {
+            valid = is_positive;
+            options.m_destination_port = number;
+        } else if (strcmp(arg, "--threads") == 0) {
+            valid = is_positive;
+            options.m_threads = number;
+        } else if (strcmp(arg, "--burst") == 0) {
+            valid = is_positive;
+            options.m_burst = number;
+        } else if (strcmp(arg, "--duration") == 0) {
+            valid = is_number && (number >= 0);
+            options.m_duration_seconds = number;
+        } else if (strcmp(arg, "--in-process") == 0) {
+            valid = is_positive;
+            options.m_in_process_messages = number;
+        } else if (strcmp(arg, "--users") == 0) {
+            valid = is_positive;
+            options.m_workload.m_user_count = number;
+        } else if (strcmp(arg, "--key-length") == 0) {
+            valid = is_positive;
+            options.m_workload.m_user_key_length = number;
+        } else if (strcmp(arg, "--class-length") == 0) {
+            valid = is_number && (number >= 0);
+            options.m_workload.m_request_class_length = number;
+        } else if (strcmp(arg, "--seed") == 0) {
+            valid = is_number && (number >= 0);
+            options.m_workload.m_seed = number;
+        } else if (strcmp(arg, "--skew") == 0) {
+            options.m_workload.m_user_skew = strtod(value, &end);
+            valid = (*end == '\0') && (options.m_workload.m_user_skew >= 0);
+        } else if (strcmp(arg, "--mix") == 0) {
+            valid = parseEventMix(value, options.m_workload);
+        } else {
+            printf("Unknown option %s, see --help\n", arg);
+            return false;
+        }
+
+        if (!valid) {
+            printf("Invalid value given for %s\n", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+int runInProcess(const Options& options) {
+    printf("Generating %ld messages...\n", options.m_in_process_messages);
+    const std::vector<std::string> messages = generateMessages(options.m_workload, options.m_in_process_messages);
+    const std::vector<syslogsrv::QueuedMessage> queued = toQueuedMessages(messages);
+    ProcessorHarness harness("{ endpoint: loadgen.dc, redis_server: localhost:6379 }");
+
+    std::vector<uint64_t> message_nanos;
+    message_nanos.reserve(queued.size());
+    size_t commands = 0;
+    size_t flushes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queued.size(); ++i) {
+        const auto message_start = std::chrono::steady_clock::now();
+        harness.process(queued[i]);
+        message_nanos.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - message_start)
+                .count());
+        if ((i + 1) % FLUSH_MESSAGES == 0 || (i + 1) == queued.size()) {
+            commands += harness.flush();
+            ++flushes;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Processed %zu messages in %.3fs: %.0f msgs/s\n", queued.size(), seconds, queued.size() / seconds);
+    printf("Time per message: p50 %luns, p99 %luns\n", percentile(message_nanos, 0.5),
+           percentile(message_nanos, 0.99));
+    printf("Redis commands per flush: %.1f\n", static_cast<double>(commands) / flushes);
+    return 0;
+}
+
+void sendMessages(const Options& options, long thread_index, const std::atomic<bool>& running) {
+    WorkloadOptions workload = options.m_workload;
+    workload.m_seed += thread_index; // each thread sends different messages
+    std::vector<std::string> messages = generateMessages(workload, MESSAGE_POOL_SIZE);
+    if (!workload.m_binary) {
+        for (std::string& message : messages) {
+            message += "\r\n";
+        }
+    }
+    size_t msg_index = 0;
+
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const int send_flags = 0;
+    sockaddr_in dest_addr = {};
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(options.m_destination_port);
+    dest_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // Send messages in bursts, which also avoids running into timing issues when trying to divide a second into too
+    // many single-message timeslices.
+    const long msgs_per_second = std::max(1L, options.m_msgs_per_second / options.m_threads);
+    const long burst_size = std::min(options.m_burst, msgs_per_second);
+    const microseconds burst_interval = duration_cast<microseconds>(std::chrono::seconds(1)) * burst_size /
+                                        msgs_per_second;
+    auto next_burst_time = std::chrono::steady_clock::now();
+    while (running.load(std::memory_order_relaxed)) {
+        for (long i = 0; i < burst_size; i++) {
+            const std::string& msg = messages[msg_index];
+            msg_index = (msg_index + 1) % messages.size();
+            const ssize_t send_result =
+                sendto(sock, msg.data(), msg.size(), send_flags, (sockaddr*)&dest_addr, sizeof(dest_addr));
+            if (send_result < 0 && options.m_verbose) {
+                printf("Failed to send a message: %s\n", strerror(errno));
+            }
+        }
+
+        next_burst_time += burst_interval;
+        const int64_t us_till_next_burst =
+            duration_cast<microseconds>(next_burst_time - std::chrono::steady_clock::now()).count();
+        if (us_till_next_burst >= 100) {
+            usleep(us_till_next_burst);
+        }
+    }
+    close(sock);
+}
+
+int runUdp(const Options& options) {
+    printf("Sending commands to port %ld at a rate of %ld/s from %ld thread(s)...\n", options.m_destination_port,
+           options.m_msgs_per_second, options.m_threads);
+    std::atomic<bool> running = true;
+    std::vector<std::thread> senders;
+    for (long i = 0; i < options.m_threads; ++i) {
+        senders.emplace_back(sendMessages, std::cref(options), i, std::cref(running));
+    }
+
+    const bool forever = (options.m_duration_seconds == 0);
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(options.m_duration_seconds);
+    size_t previous_udp_errors = get_udp_error_count(options.m_verbose);
+    bool finished = false;
+    while (!finished) {
+        auto next_log_time = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        if (!forever && next_log_time >= end) {
+            next_log_time = end;
+            finished = true;
+        }
+        std::this_thread::sleep_until(next_log_time);
+
+        const size_t new_udp_errors = get_udp_error_count(options.m_verbose);
+        printf("OS reports %zu new UDP errors\n", new_udp_errors - previous_udp_errors);
+        previous_udp_errors = new_udp_errors;
+    }
+
+    running = false;
+    for (std::thread& sender : senders) {
+        sender.join();
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, const char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0) {
+            printUsage();
+            return 0;
+        }
+    }
+
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        return 1;
+    }
+    return (options.m_in_process_messages > 0) ? runInProcess(options) : runUdp(options);
+}
@@ -0,0 +1,193 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+// Micro-benchmarks of the per-message hot path: tokenizing events (generically and with the specialized FieldSplit)
+// and parsing each type of them, the conversions and validation applied to their fields, hashing the processor's
+// aggregation keys and the whole of processing a message.
+// Each iteration handles MESSAGE_COUNT generated messages of one type (see workload.h), so that the branch predictor
+// doesn't just learn a single message.
+
+#include <benchmark/benchmark.h>
+#include <charconv>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "binary_event.h"
+#include "common.h"
+#include "event_classifier.h"
+#include "event_parser.h"
+#include "field_split.h"
+#include "processor_harness.h"
+#include "stringsplit.h"
+#include "workload.h"
+
+namespace {
+
+using namespace syslogsrv;
+
+constexpr size_t MESSAGE_COUNT = 1024;
+const char* const EVENT_MIXES[] = {
+    "req:1,req_end:0,data_xfer:0,active_reqs:0",
+    "req:0,req_end:1,data_xfer:0,active_reqs:0",
+    "req:0,req_end:0,data_xfer:1,active_reqs:0",
+    "req:0,req_end:0,data_xfer:0,active_reqs:1",
+};
+
+// The payloads of MESSAGE_COUNT generated events of the given type, 0: req, 1: req_end, 2: data_xfer, 3: active_reqs,
+// either as text or as binary records
+std::vector<std::string> makePayloads(int64_t event_type, bool binary = false) {
+    bench::WorkloadOptions options;
+    bench::parseEventMix(EVENT_MIXES[event_type], options);
+    options.m_binary = binary;
+    std::vector<std::string> payloads;
+    for (std::string& message : bench::generateMessages(options, MESSAGE_COUNT)) {
+        if (binary) {
+            payloads.push_back(std::move(message));
+        } else {
+            payloads.emplace_back(classifyEvent(message).m_payload);
+        }
+    }
+    return payloads;
+}
+
+void BM_StringSplit(benchmark::State& state) {
+    const auto payloads = makePayloads(state.range(0));
+    for (auto _ : state) {
+        for (const auto& payload : payloads) {
+            StringSplit split(payload, DELIMITER);
+            while (!split.finishedSuccessfully()) {
+                benchmark::DoNotOptimize(split.next());
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * payloads.size());
+}
+
+void BM_FieldSplit(benchmark::State& state) {
+    const auto payloads = makePayloads(state.range(0));
+    for (auto _ : state) {
+        for (const auto& payload : payloads) {
+            FieldSplit split(payload);
+            while (!split.finishedSuccessfully()) {
+                benchmark::DoNotOptimize(split.next());
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * payloads.size());
+}
+
+template <typename PARSER>
+void parseAll(benchmark::State& state, PARSER parser, bool binary = false) {
+    const auto payloads = makePayloads(state.range(0), binary);
+    for (auto _ : state) {
+        for (const auto& payload : payloads) {
+            auto event = parser(payload);
+            benchmark::DoNotOptimize(event);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * payloads.size());
+}
+
+void BM_ParseRequestStart(benchmark::State& state) { parseAll(state, parseRequestStart); }
+void BM_ParseRequestEnd(benchmark::State& state) { parseAll(state, parseRequestEnd); }
+void BM_ParseDataXfer(benchmark::State& state) { parseAll(state, parseDataXfer); }
+void BM_ParseActiveRequests(benchmark::State& state) { parseAll(state, parseActiveRequests); }
+void BM_DecodeRequestStart(benchmark::State& state) { parseAll(state, decodeRequestStart, true); }
+void BM_DecodeRequestEnd(benchmark::State& state) { parseAll(state, decodeRequestEnd, true); }
+void BM_DecodeDataXfer(benchmark::State& state) { parseAll(state, decodeDataXfer, true); }
+void BM_DecodeActiveRequests(benchmark::State& state) { parseAll(state, decodeActiveRequests, true); }
+
+void BM_FromChars(benchmark::State& state) {
+    // Numbers of up to `range(0)` digits, like data_xfer lengths
+    std::mt19937_64 rng(1);
+    int64_t max_value = 1;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        max_value *= 10;
+    }
+    std::uniform_int_distribution<int64_t> pick_value(0, max_value - 1);
+    std::vector<std::string> numbers;
+    for (size_t i = 0; i < MESSAGE_COUNT; ++i) {
+        numbers.push_back(std::to_string(pick_value(rng)));
+    }
+
+    for (auto _ : state) {
+        for (const auto& number : numbers) {
+            int64_t value = 0;
+            benchmark::DoNotOptimize(std::from_chars(number.data(), number.data() + number.size(), value));
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * numbers.size());
+}
+
+void BM_IsPrintableASCII(benchmark::State& state) {
+    bench::WorkloadOptions options;
+    options.m_user_key_length = state.range(0);
+    std::vector<std::string> keys;
+    for (const std::string& message : bench::generateMessages(options, MESSAGE_COUNT)) {
+        keys.emplace_back(eventUserKey(classifyEvent(message).m_payload));
+    }
+
+    for (auto _ : state) {
+        for (const auto& key : keys) {
+            benchmark::DoNotOptimize(isPrintableASCII(key));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * keys.size() * options.m_user_key_length);
+}
+
+void BM_RedisCmdKeyHash(benchmark::State& state) {
+    using Key = bench::ProcessorHarness::RedisCmdKey;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<uint32_t> pick_id(0, state.range(0) - 1);
+    const auto now = std::chrono::system_clock::now();
+    std::vector<Key> keys;
+    for (size_t i = 0; i < MESSAGE_COUNT; ++i) {
+        keys.push_back(Key{pick_id(rng), now + std::chrono::milliseconds(i), pick_id(rng) % 8});
+    }
+
+    const bench::ProcessorHarness::RedisCmdKeyHash hash;
+    for (auto _ : state) {
+        for (const auto& key : keys) {
+            benchmark::DoNotOptimize(hash(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+void BM_ProcessMessage(benchmark::State& state) {
+    const auto payloads = makePayloads(state.range(0));
+    const std::vector<QueuedMessage> queued = bench::toQueuedMessages(payloads);
+    bench::ProcessorHarness harness("{ endpoint: bench.dc, redis_server: localhost:6379 }");
+    for (auto _ : state) {
+        for (const auto& msg : queued) {
+            harness.process(msg);
+        }
+        // Keep the processor's maps from growing across iterations, as a flush would
+        state.PauseTiming();
+        harness.flush();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * queued.size());
+}
+
+BENCHMARK(BM_StringSplit)->ArgName("type")->DenseRange(0, 3);
+BENCHMARK(BM_FieldSplit)->ArgName("type")->DenseRange(0, 3);
+BENCHMARK(BM_ParseRequestStart)->ArgName("type")->Arg(0);
+BENCHMARK(BM_ParseRequestEnd)->ArgName("type")->Arg(1);
+BENCHMARK(BM_ParseDataXfer)->ArgName("type")->Arg(2);
+BENCHMARK(BM_ParseActiveRequests)->ArgName("type")->Arg(3);
+BENCHMARK(BM_DecodeRequestStart)->ArgName("type")->Arg(0);
+BENCHMARK(BM_DecodeRequestEnd)->ArgName("type")->Arg(1);
+BENCHMARK(BM_DecodeDataXfer)->ArgName("type")->Arg(2);
+BENCHMARK(BM_DecodeActiveRequests)->ArgName("type")->Arg(3);
+BENCHMARK(BM_FromChars)->ArgName("digits")->Arg(1)->Arg(5)->Arg(10);
+BENCHMARK(BM_IsPrintableASCII)->ArgName("length")->Arg(20)->Arg(128);
+BENCHMARK(BM_RedisCmdKeyHash)->ArgName("ids")->Arg(1000)->Arg(1000000);
+BENCHMARK(BM_ProcessMessage)->ArgName("type")->DenseRange(0, 3);
+
+} // namespace
@@ -0,0 +1,68 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+// End-to-end benchmarks of the Processor: parsing & aggregating a flush worth of generated events and serializing the
+// result for redis, with the network replaced by a fake (see processor_harness.h).
+// Each iteration processes FLUSH_MESSAGES events from `users` users, with one of the event mixes below, then flushes.
+// Besides the throughput, this reports the median and 99th percentile time to process one message (which includes
+// reading the clock) and the number of redis commands sent per flush.
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "processor_harness.h"
+#include "workload.h"
+
+namespace {
+
+using namespace syslogsrv::bench;
+
+constexpr size_t FLUSH_MESSAGES = 10000;
+constexpr const char* CONFIG = "{ endpoint: bench.dc, redis_server: localhost:6379 }";
+
+WorkloadOptions makeWorkload(size_t users, int mix) {
+    WorkloadOptions options;
+    options.m_user_count = users;
+    if (mix == 0) {
+        parseEventMix("req:1,req_end:1,data_xfer:8,active_reqs:0", options); // bandwidth-heavy
+    } else {
+        parseEventMix("req:4,req_end:4,data_xfer:1,active_reqs:1", options); // request-heavy
+    }
+    return options;
+}
+
+void BM_ProcessorIngest(benchmark::State& state) {
+    const std::vector<std::string> messages =
+        generateMessages(makeWorkload(state.range(0), state.range(1)), FLUSH_MESSAGES);
+    const std::vector<syslogsrv::QueuedMessage> queued = toQueuedMessages(messages);
+    ProcessorHarness harness(CONFIG);
+
+    std::vector<uint64_t> message_nanos;
+    message_nanos.reserve(queued.size());
+    size_t commands = 0;
+    for (auto _ : state) {
+        message_nanos.clear();
+        for (const syslogsrv::QueuedMessage& msg : queued) {
+            const auto start = std::chrono::steady_clock::now();
+            harness.process(msg);
+            message_nanos.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                    .count());
+        }
+        commands += harness.flush();
+    }
+
+    state.SetItemsProcessed(state.iterations() * queued.size());
+    state.counters["p50_ns"] = static_cast<double>(percentile(message_nanos, 0.5));
+    state.counters["p99_ns"] = static_cast<double>(percentile(message_nanos, 0.99));
+    state.counters["cmds_per_flush"] = static_cast<double>(commands) / state.iterations();
+}
+
+BENCHMARK(BM_ProcessorIngest)
+    ->ArgNames({"users", "mix"})
+    ->ArgsProduct({{10, 1000, 100000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
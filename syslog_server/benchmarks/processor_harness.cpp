@@ -0,0 +1,136 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+#include <spdlog/sinks/null_sink.h>
+#include <utility>
+
+#include "binary_event.h"
+#include "common.h"
+#include "event_classifier.h"
+#include "processor_harness.h"
+#include "redis_utils.h"
+
+namespace syslogsrv {
+namespace bench {
+
+// Stands in for hiredis and the network: connections always succeed, and every command is answered successfully
+// (with the same string, so that script loads succeed too) when `answerAll()` is called.
+class FakeRedisNet : public NetInterface {
+  public:
+    FakeRedisNet() {
+        m_reply.type = REDIS_REPLY_STRING;
+        m_reply.str = m_reply_str;
+        m_reply.len = sizeof(m_reply_str) - 1;
+    }
+    ~FakeRedisNet() override {
+        for (redisAsyncContext* context : m_contexts) {
+            delete context;
+        }
+    }
+
+    int getaddrinfo(const char*, const char*, const addrinfo*, addrinfo**) override { return EAI_FAIL; }
+    void freeaddrinfo(addrinfo*) override {}
+    std::string getIpAddressBySockAddr(const sockaddr* const) override { return "127.0.0.1"; }
+    redisAsyncContext* redisAsyncConnect(const char*, int) override {
+        m_contexts.push_back(new redisAsyncContext{});
+        return m_contexts.back();
+    }
+    int redisLibevAttach(struct ev_loop*, redisAsyncContext*) override { return REDIS_OK; }
+    void redisAsyncDisconnect(redisAsyncContext*) override {}
+    int redisAsyncCommand(redisAsyncContext* ac, redisCallbackFn* fn, void* privdata, const char*) override {
+        m_unanswered.push_back({ac, fn, privdata});
+        return REDIS_OK;
+    }
+    int redisAsyncFormattedCommand(redisAsyncContext* ac, redisCallbackFn* fn, void* privdata, const char*,
+                                   size_t) override {
+        m_unanswered.push_back({ac, fn, privdata});
+        ++m_command_count;
+        return REDIS_OK;
+    }
+    // The contexts are freed along with the fake, since the processor's connections may outlive their use
+    void redisAsyncFree(redisAsyncContext*) override {}
+
+    // Complete the connection attempts made so far
+    void acceptConnections() {
+        for (redisAsyncContext* context : m_contexts) {
+            if (context->onConnect != nullptr) {
+                context->onConnect(context, REDIS_OK);
+            }
+        }
+    }
+
+    void answerAll() {
+        // Answering a command can send another (e.g. to reload a script), which must wait for the next call
+        std::vector<Command> commands;
+        std::swap(commands, m_unanswered);
+        for (const Command& command : commands) {
+            command.m_callback(command.m_context, &m_reply, command.m_privdata);
+        }
+    }
+
+    uint64_t commandCount() const { return m_command_count; }
+
+  private:
+    struct Command {
+        redisAsyncContext* m_context;
+        redisCallbackFn* m_callback;
+        void* m_privdata;
+    };
+
+    std::vector<redisAsyncContext*> m_contexts;
+    std::vector<Command> m_unanswered;
+    uint64_t m_command_count = 0;
+
+    char m_reply_str[41] = "d7d7d0dd5b7e1ec3b18ecd4bcc0bb8e2f82c0b33";
+    redisReply m_reply = {};
+};
+
+ProcessorHarness::ProcessorHarness(const std::string& config_yaml) : m_queue(1) {
+    if (!spdlog::get(SERVER_NAME)) {
+        spdlog::create<spdlog::sinks::null_sink_mt>(SERVER_NAME);
+    }
+
+    auto net = std::make_unique<FakeRedisNet>();
+    m_net = net.get();
+    m_processor = std::make_unique<Processor>(m_queue, YAML::Load(config_yaml), 0, TimeWrapper(), std::move(net));
+    for (auto& shard : m_processor->m_redis_shards) {
+        shard.m_conn->connect();
+    }
+    m_net->acceptConnections();
+    m_net->answerAll(); // e.g. script loads
+}
+
+ProcessorHarness::~ProcessorHarness() = default;
+
+size_t ProcessorHarness::flush() {
+    const uint64_t commands_before = m_net->commandCount();
+    m_processor->m_last_redis_flush_time = {}; // so that the flush period has always elapsed
+    m_processor->sendToRedisQos();
+    m_net->answerAll();
+    return m_net->commandCount() - commands_before;
+}
+
+std::vector<QueuedMessage> toQueuedMessages(const std::vector<std::string>& messages) {
+    std::vector<QueuedMessage> queued;
+    queued.reserve(messages.size());
+    for (const std::string& message : messages) {
+        const ClassifiedEvent event = isBinaryEvent(message) ? classifyBinaryEvent(message).m_event
+                                                             : classifyEvent(message);
+        queued.push_back(QueuedMessage{event.m_payload.data(), static_cast<uint32_t>(event.m_payload.size()), nullptr,
+                                       event.m_type});
+    }
+    return queued;
+}
+
+uint64_t percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0;
+    }
+    const size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+} // namespace bench
+} // namespace syslogsrv
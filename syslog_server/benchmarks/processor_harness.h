@@ -0,0 +1,63 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_PROCESSOR_HARNESS
+#define INCLUDED_PROCESSOR_HARNESS
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "message_queue.h"
+#include "msg_processor.h"
+
+namespace syslogsrv {
+namespace bench {
+
+class FakeRedisNet;
+
+// Drives a Processor from the calling thread, without its own threads, the network or a redis server, so that the
+// cost of parsing & aggregating events and serializing them for redis can be measured on its own.
+//
+// The processor's redis servers are all connected through a fake network interface, which counts the commands it is
+// given and answers each of them once the flush that sent it is over.
+class ProcessorHarness {
+  public:
+    // The processor's key for its aggregated counters, and its hash
+    using RedisCmdKey = Processor::RedisCmdKey;
+    using RedisCmdKeyHash = Processor::RedisCmdKeyHash;
+
+    // `config_yaml` is the processor's configuration, which must include an endpoint and redis server(s)
+    explicit ProcessorHarness(const std::string& config_yaml);
+    ~ProcessorHarness();
+
+    ProcessorHarness(const ProcessorHarness&) = delete;
+    ProcessorHarness& operator=(const ProcessorHarness&) = delete;
+
+    // Handle one message from HAProxy, as the consumer thread does when dequeuing it
+    void process(const QueuedMessage& msg) { m_processor->processMessage(msg); }
+
+    // Send all the pending updates to redis, as the consumer thread does once per flush period, and answer them.
+    // Returns the number of redis commands sent.
+    size_t flush();
+
+  private:
+    MessageQueue m_queue; // unused, processors must be given one
+    FakeRedisNet* m_net;  // owned by m_processor
+    std::unique_ptr<Processor> m_processor;
+};
+
+// The messages as they'd be handed to the Processor by its queue. They refer to the given strings, which must
+// outlive them.
+std::vector<QueuedMessage> toQueuedMessages(const std::vector<std::string>& messages);
+
+// The value below which `fraction` of `samples` fall, e.g. the median for 0.5. Reorders `samples`.
+uint64_t percentile(std::vector<uint64_t>& samples, double fraction);
+
+} // namespace bench
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,68 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+// Micro-benchmarks of serializing a flush worth of commands for redis.
+// Each iteration builds the hincrby/expire commands for `users x verbs` counters, either as one text command string
+// per command (to be parsed again by redisAsyncCommand) or straight into a reused RespBuffer.
+
+#include <benchmark/benchmark.h>
+#include <iterator>
+#include <spdlog/fmt/bundled/format.h>
+#include <string>
+#include <vector>
+
+#include "resp_buffer.h"
+
+namespace {
+
+const std::vector<std::string> VERBS = {"GET", "PUT", "HEAD", "DELETE", "LISTBUCKETS"};
+constexpr const char* ENDPOINT = "dev.dc";
+constexpr int TTL = 2;
+
+std::vector<std::string> makeUsers(size_t count) {
+    std::vector<std::string> users;
+    for (size_t i = 0; i < count; ++i) {
+        users.push_back(fmt::v10::format("AKIA{:016}", i));
+    }
+    return users;
+}
+
+void BM_TextCommands(benchmark::State& state) {
+    const auto users = makeUsers(state.range(0));
+    for (auto _ : state) {
+        std::vector<std::string> commands;
+        for (const auto& user : users) {
+            const auto key = fmt::v10::format("verb_{}_user_{}${}", 1599322430, user, ENDPOINT);
+            for (const auto& verb : VERBS) {
+                commands.push_back(fmt::v10::format("hincrby {} {} {}", key, verb, 1));
+            }
+            commands.push_back(fmt::v10::format("expire {} {}", key, TTL));
+        }
+        benchmark::DoNotOptimize(commands.data());
+    }
+    state.SetItemsProcessed(state.iterations() * users.size() * (VERBS.size() + 1));
+}
+
+void BM_RespBuffer(benchmark::State& state) {
+    const auto users = makeUsers(state.range(0));
+    syslogsrv::RespBuffer batch;
+    std::string key;
+    for (auto _ : state) {
+        batch.clear();
+        for (const auto& user : users) {
+            key.clear();
+            fmt::v10::format_to(std::back_inserter(key), "verb_{}_user_{}${}", 1599322430, user, ENDPOINT);
+            for (const auto& verb : VERBS) {
+                batch.appendCommand("hincrby", key, verb, 1);
+            }
+            batch.appendCommand("expire", key, TTL);
+        }
+        benchmark::DoNotOptimize(batch.data().data());
+    }
+    state.SetItemsProcessed(state.iterations() * users.size() * (VERBS.size() + 1));
+}
+
+} // namespace
+
+BENCHMARK(BM_TextCommands)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RespBuffer)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
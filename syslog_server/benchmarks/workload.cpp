@@ -0,0 +1,143 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <spdlog/fmt/bundled/format.h>
+
+#include "binary_event.h"
+#include "workload.h"
+
+namespace syslogsrv {
+namespace bench {
+
+namespace {
+
+const char* const VERBS[] = {"GET", "PUT", "HEAD", "DELETE", "POST"};
+
+// A fixed-length, printable user key that is unique to `index`, e.g. "AKIA0000000000000042"
+std::string makeUserKey(size_t index, size_t length) {
+    std::string key = fmt::v10::format("AKIA{:0{}}", index, (length > 4) ? length - 4 : 0);
+    key.resize(std::max(length, key.size()), 'X');
+    return key;
+}
+
+} // namespace
+
+bool parseEventMix(std::string_view spec, WorkloadOptions& options) {
+    while (!spec.empty()) {
+        const size_t comma = spec.find(',');
+        const std::string_view entry = spec.substr(0, comma);
+        spec = (comma == std::string_view::npos) ? std::string_view() : spec.substr(comma + 1);
+
+        const size_t colon = entry.find(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+        const std::string_view name = entry.substr(0, colon);
+        const std::string_view weight_str = entry.substr(colon + 1);
+        unsigned weight = 0;
+        const auto result = std::from_chars(weight_str.begin(), weight_str.end(), weight);
+        if (result.ec != std::errc{} || result.ptr != weight_str.end()) {
+            return false;
+        }
+
+        if (name == "req") {
+            options.m_req_weight = weight;
+        } else if (name == "req_end") {
+            options.m_req_end_weight = weight;
+        } else if (name == "data_xfer") {
+            options.m_data_xfer_weight = weight;
+        } else if (name == "active_reqs") {
+            options.m_active_reqs_weight = weight;
+        } else {
+            return false;
+        }
+    }
+    return (options.m_req_weight + options.m_req_end_weight + options.m_data_xfer_weight +
+            options.m_active_reqs_weight) > 0;
+}
+
+std::vector<std::string> generateMessages(const WorkloadOptions& options, size_t count) {
+    std::mt19937_64 rng(options.m_seed);
+
+    std::vector<std::string> users;
+    std::vector<double> user_weights;
+    for (size_t i = 0; i < std::max<size_t>(1, options.m_user_count); ++i) {
+        users.push_back(makeUserKey(i, options.m_user_key_length));
+        user_weights.push_back(1.0 / std::pow(static_cast<double>(i + 1), options.m_user_skew));
+    }
+    std::discrete_distribution<size_t> pick_user(user_weights.begin(), user_weights.end());
+
+    std::vector<std::string> instances;
+    for (size_t i = 0; i < std::max<size_t>(1, options.m_instance_count); ++i) {
+        instances.push_back(fmt::v10::format("haproxy{}-9000", i));
+    }
+    std::uniform_int_distribution<size_t> pick_instance(0, instances.size() - 1);
+
+    const std::string request_class(options.m_request_class_length, 'C');
+    std::discrete_distribution<int> pick_event({static_cast<double>(options.m_req_weight),
+                                                static_cast<double>(options.m_req_end_weight),
+                                                static_cast<double>(options.m_data_xfer_weight),
+                                                static_cast<double>(options.m_active_reqs_weight)});
+    std::uniform_int_distribution<size_t> pick_verb(0, std::size(VERBS) - 1);
+    std::uniform_int_distribution<int> pick_active_requests(1, 64);
+    std::uniform_int_distribution<int> pick_length(1, 65536);
+    std::uniform_int_distribution<int> pick_port(1024, 65535);
+
+    std::vector<std::string> messages;
+    messages.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const std::string& user = users[pick_user(rng)];
+        const std::string& instance = instances[pick_instance(rng)];
+        const bool download = (rng() % 2 == 0);
+        const char* direction = download ? "dwn" : "up";
+        const uint8_t flags = download ? BINARY_FLAG_DOWNLOAD : 0;
+        const int port = pick_port(rng);
+        switch (pick_event(rng)) {
+        case 0: {
+            const char* const verb = VERBS[pick_verb(rng)];
+            const int active_requests = pick_active_requests(rng);
+            messages.push_back(options.m_binary
+                                   ? encodeBinaryRecord(BINARY_TYPE_REQ_START, flags, active_requests,
+                                                        {user, verb, instance, request_class})
+                                   : fmt::v10::format("req~|~10.0.0.1:{}~|~{}~|~{}~|~{}~|~{}~|~{}~|~{}", port, user,
+                                                      verb, direction, instance, active_requests, request_class));
+            break;
+        }
+        case 1: {
+            const char* const verb = VERBS[pick_verb(rng)];
+            const int active_requests = pick_active_requests(rng);
+            messages.push_back(options.m_binary
+                                   ? encodeBinaryRecord(BINARY_TYPE_REQ_END, flags, active_requests, {user, instance})
+                                   : fmt::v10::format("req_end~|~10.0.0.1:{}~|~{}~|~{}~|~{}~|~{}~|~{}", port, user,
+                                                      verb, direction, instance, active_requests));
+            break;
+        }
+        case 2: {
+            const int length = pick_length(rng);
+            messages.push_back(options.m_binary
+                                   ? encodeBinaryRecord(BINARY_TYPE_DATA_XFER, flags, length, {user})
+                                   : fmt::v10::format("data_xfer~|~10.0.0.1:{}~|~{}~|~{}~|~{}", port, user,
+                                                      direction, length));
+            break;
+        }
+        default: {
+            const int active_requests = pick_active_requests(rng);
+            messages.push_back(options.m_binary
+                                   ? encodeBinaryRecord(BINARY_TYPE_ACTIVE_REQS, flags, active_requests,
+                                                        {user, instance})
+                                   : fmt::v10::format("active_reqs~|~{}~|~{}~|~{}~|~{}", instance, user, direction,
+                                                      active_requests));
+            break;
+        }
+        }
+    }
+    return messages;
+}
+
+} // namespace bench
+} // namespace syslogsrv
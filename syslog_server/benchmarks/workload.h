@@ -0,0 +1,54 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_WORKLOAD
+#define INCLUDED_WORKLOAD
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace syslogsrv {
+namespace bench {
+
+// The shape of the stream of control messages that HAProxy sends us, see docs/syslog-server-api.md
+struct WorkloadOptions {
+    // How many distinct users send requests, and how unevenly: users are drawn from a Zipf distribution with this
+    // exponent, so 0 spreads events evenly and ~1 concentrates them on a few heavy users
+    size_t m_user_count = 1000;
+    double m_user_skew = 0;
+
+    // The relative frequency of each event type
+    unsigned m_req_weight = 1;
+    unsigned m_req_end_weight = 1;
+    unsigned m_data_xfer_weight = 8;
+    unsigned m_active_reqs_weight = 0;
+
+    // The sizes of the variable-length fields, which set the message sizes. Requests only have a request class if
+    // its length isn't 0.
+    size_t m_user_key_length = 20;
+    size_t m_request_class_length = 0;
+
+    // How many HAProxy instances the events come from
+    size_t m_instance_count = 4;
+
+    // Whether the events are sent as binary records rather than as text
+    bool m_binary = false;
+
+    uint64_t m_seed = 1;
+};
+
+// Set the event weights of `options` from a spec such as "req:1,req_end:1,data_xfer:8,active_reqs:0". Event types
+// not mentioned keep their weight. Returns false if the spec can't be parsed.
+bool parseEventMix(std::string_view spec, WorkloadOptions& options);
+
+// `count` messages drawn at random from the given workload, each formatted as HAProxy sends it (without the syslog
+// header, which the syslog server skips over), or as a binary record
+std::vector<std::string> generateMessages(const WorkloadOptions& options, size_t count);
+
+} // namespace bench
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,226 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include "binary_event.h"
+
+namespace syslogsrv {
+
+namespace {
+
+EventType eventTypeForCode(uint8_t code) {
+    switch (code) {
+    case BINARY_TYPE_REQ_START:
+        return EventType::ReqStart;
+    case BINARY_TYPE_REQ_END:
+        return EventType::ReqEnd;
+    case BINARY_TYPE_DATA_XFER:
+        return EventType::DataXfer;
+    case BINARY_TYPE_ACTIVE_REQS:
+        return EventType::ActiveReqs;
+    default:
+        return EventType::Unknown;
+    }
+}
+
+// Reads the fields of a record in order. Reading past the end of the record leaves the reader failed, after which
+// every field reads as 0 or empty.
+class RecordReader {
+  public:
+    explicit RecordReader(std::string_view record) : m_remaining(record) {}
+
+    uint8_t u8() {
+        if (!take(1)) {
+            return 0;
+        }
+        return static_cast<uint8_t>(m_field[0]);
+    }
+
+    // Fields are little-endian, whatever the host's byte order
+    uint64_t uintLE(size_t size) {
+        if (!take(size)) {
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = size; i > 0; --i) {
+            value = (value << 8) | static_cast<uint8_t>(m_field[i - 1]);
+        }
+        return value;
+    }
+
+    // A string of up to 255 bytes, prefixed by its length
+    std::string_view string() {
+        const size_t size = u8();
+        if (!take(size)) {
+            return {};
+        }
+        return m_field;
+    }
+
+    bool failed() const { return m_failed; }
+    // Whether the whole record was read without running past its end
+    bool finishedSuccessfully() const { return !m_failed && m_remaining.empty(); }
+
+  private:
+    bool take(size_t size) {
+        if (m_failed || (m_remaining.size() < size)) {
+            m_failed = true;
+            m_field = {};
+            return false;
+        }
+        m_field = m_remaining.substr(0, size);
+        m_remaining.remove_prefix(size);
+        return true;
+    }
+
+    std::string_view m_remaining;
+    std::string_view m_field;
+    bool m_failed = false;
+};
+
+// The fields that every record starts with, up to and including its user key
+struct RecordHeader {
+    uint8_t m_type;
+    Direction m_direction;
+    int32_t m_value;
+    std::optional<int64_t> m_trace_send_usec;
+    std::string_view m_user_key;
+};
+
+// Read the header and user key of a record of the current version. Returns an empty optional if the record doesn't
+// have them.
+std::optional<RecordHeader> readHeader(RecordReader& reader) {
+    if ((reader.u8() != BINARY_EVENT_MAGIC) || (reader.u8() != BINARY_EVENT_VERSION)) {
+        return std::nullopt;
+    }
+    RecordHeader header;
+    header.m_type = reader.u8();
+    const uint8_t flags = reader.u8();
+    header.m_direction = (flags & BINARY_FLAG_DOWNLOAD) ? Direction::Down : Direction::Up;
+    header.m_value = static_cast<int32_t>(reader.uintLE(sizeof(uint32_t)));
+    if (flags & BINARY_FLAG_TRACED) {
+        header.m_trace_send_usec = static_cast<int64_t>(reader.uintLE(sizeof(uint64_t)));
+    }
+    header.m_user_key = reader.string();
+    if (reader.failed()) {
+        return std::nullopt;
+    }
+    return header;
+}
+
+// Read the header of a record that must be of the given type
+std::optional<RecordHeader> readHeader(RecordReader& reader, uint8_t type) {
+    auto header = readHeader(reader);
+    if (!header || (header->m_type != type)) {
+        return std::nullopt;
+    }
+    return header;
+}
+
+} // namespace
+
+ClassifiedBinaryEvent classifyBinaryEvent(std::string_view record) {
+    RecordReader reader(record);
+    const auto header = readHeader(reader);
+    if (!header) {
+        return {};
+    }
+    const EventType type = eventTypeForCode(header->m_type);
+    if (type == EventType::Unknown) {
+        return {};
+    }
+    return {{type, record}, header->m_user_key};
+}
+
+std::optional<RequestStartEvent> decodeRequestStart(std::string_view record) {
+    RecordReader reader(record);
+    const auto header = readHeader(reader, BINARY_TYPE_REQ_START);
+    if (!header) {
+        return std::nullopt;
+    }
+    RequestStartEvent event;
+    event.m_user_key = header->m_user_key;
+    event.m_verb = reader.string();
+    event.m_direction = header->m_direction;
+    event.m_instance_id = reader.string();
+    event.m_active_requests = header->m_value;
+    event.m_request_class = reader.string();
+    event.m_trace_send_usec = header->m_trace_send_usec;
+    if (!reader.finishedSuccessfully()) {
+        return std::nullopt;
+    }
+    return event;
+}
+
+std::optional<RequestEndEvent> decodeRequestEnd(std::string_view record) {
+    RecordReader reader(record);
+    const auto header = readHeader(reader, BINARY_TYPE_REQ_END);
+    if (!header) {
+        return std::nullopt;
+    }
+    RequestEndEvent event;
+    event.m_user_key = header->m_user_key;
+    event.m_direction = header->m_direction;
+    event.m_instance_id = reader.string();
+    event.m_active_requests = header->m_value;
+    if (!reader.finishedSuccessfully()) {
+        return std::nullopt;
+    }
+    return event;
+}
+
+std::optional<DataXferEvent> decodeDataXfer(std::string_view record) {
+    RecordReader reader(record);
+    const auto header = readHeader(reader, BINARY_TYPE_DATA_XFER);
+    if (!header || !reader.finishedSuccessfully()) {
+        return std::nullopt;
+    }
+    DataXferEvent event;
+    event.m_user_key = header->m_user_key;
+    event.m_direction = header->m_direction;
+    event.m_length = header->m_value;
+    event.m_trace_send_usec = header->m_trace_send_usec;
+    return event;
+}
+
+std::optional<ActiveRequestsEvent> decodeActiveRequests(std::string_view record) {
+    RecordReader reader(record);
+    const auto header = readHeader(reader, BINARY_TYPE_ACTIVE_REQS);
+    if (!header) {
+        return std::nullopt;
+    }
+    ActiveRequestsEvent event;
+    event.m_instance_id = reader.string();
+    event.m_user_key = header->m_user_key;
+    event.m_direction = header->m_direction;
+    event.m_active_requests = header->m_value;
+    if (!reader.finishedSuccessfully()) {
+        return std::nullopt;
+    }
+    return event;
+}
+
+std::string encodeBinaryRecord(uint8_t type, uint8_t flags, int32_t value,
+                               std::initializer_list<std::string_view> strings,
+                               std::optional<int64_t> trace_send_usec) {
+    if (trace_send_usec) {
+        flags |= BINARY_FLAG_TRACED;
+    }
+    std::string record = {static_cast<char>(BINARY_EVENT_MAGIC), static_cast<char>(BINARY_EVENT_VERSION),
+                          static_cast<char>(type), static_cast<char>(flags)};
+    const auto append_le = [&record](uint64_t field, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            record.push_back(static_cast<char>(field >> (8 * i)));
+        }
+    };
+    append_le(static_cast<uint32_t>(value), sizeof(uint32_t));
+    if (trace_send_usec) {
+        append_le(static_cast<uint64_t>(*trace_send_usec), sizeof(uint64_t));
+    }
+    for (const std::string_view string : strings) {
+        record.push_back(static_cast<char>(string.size()));
+        record.append(string);
+    }
+    return record;
+}
+
+} // namespace syslogsrv
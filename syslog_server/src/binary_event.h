@@ -0,0 +1,68 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_BINARY_EVENT
+#define INCLUDED_BINARY_EVENT
+
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "event_classifier.h"
+#include "event_parser.h"
+
+namespace syslogsrv {
+
+// HAProxy can send its control messages as compact binary records rather than as text, see the "Binary Records"
+// section of docs/syslog-server-api.md. Each record is a datagram of its own, received on the same socket as the text
+// messages and told apart from them by its first byte, which can't start a syslog line.
+//
+// The decoders below produce the same events as the text parsers, so the rest of the processing doesn't depend on the
+// format that an event arrived in. As for those, string fields are views into the record.
+
+constexpr inline uint8_t BINARY_EVENT_MAGIC = 0xfe;
+constexpr inline uint8_t BINARY_EVENT_VERSION = 1;
+
+// The message types of binary records, as given in byte 2 of their header
+constexpr inline uint8_t BINARY_TYPE_REQ_START = 1;
+constexpr inline uint8_t BINARY_TYPE_REQ_END = 2;
+constexpr inline uint8_t BINARY_TYPE_DATA_XFER = 3;
+constexpr inline uint8_t BINARY_TYPE_ACTIVE_REQS = 4;
+
+// The bits of the flags in byte 3 of their header
+constexpr inline uint8_t BINARY_FLAG_DOWNLOAD = 0x01;
+constexpr inline uint8_t BINARY_FLAG_TRACED = 0x02;
+
+// Returns true if `datagram` holds a binary record (which may still be invalid) rather than a line of text
+inline bool isBinaryEvent(std::string_view datagram) {
+    return !datagram.empty() && (static_cast<uint8_t>(datagram[0]) == BINARY_EVENT_MAGIC);
+}
+
+// The type of a binary record and its user key, from its header and first string, without decoding the rest of it.
+// Records of an unknown version or type, or too short to hold a user key, are classified as `EventType::Unknown`.
+// The payload of the event is the whole record.
+struct ClassifiedBinaryEvent {
+    ClassifiedEvent m_event;
+    std::string_view m_user_key;
+};
+ClassifiedBinaryEvent classifyBinaryEvent(std::string_view record);
+
+// Decode a whole record of the corresponding type.
+// These return an empty optional if the record is of a different type, is truncated or has trailing bytes.
+std::optional<RequestStartEvent> decodeRequestStart(std::string_view record);
+std::optional<RequestEndEvent> decodeRequestEnd(std::string_view record);
+std::optional<DataXferEvent> decodeDataXfer(std::string_view record);
+std::optional<ActiveRequestsEvent> decodeActiveRequests(std::string_view record);
+
+// A record as HAProxy would send it, with the given header fields followed by `strings` (the user key first), each
+// of which must be at most 255 bytes. The trace flag is set if there is a trace timestamp.
+// The syslog server only ever decodes records, this is for the tests and benchmarks to stand in for HAProxy.
+std::string encodeBinaryRecord(uint8_t type, uint8_t flags, int32_t value,
+                               std::initializer_list<std::string_view> strings,
+                               std::optional<int64_t> trace_send_usec = std::nullopt);
+
+} // namespace syslogsrv
+
+#endif
@@ -1,4 +1,35 @@
 // Copyright 2024 Bloomberg Finance L.P.
 // Distributed under the terms of the Apache 2.0 license.
 
+#include <algorithm>
+#include <cctype>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "common.h"
+
+namespace syslogsrv {
+
+bool isPrintableASCII(const std::string_view key) {
+    // In the "C" locale that we run in, the printable characters are ' ' (0x20) to '~' (0x7e)
+    const char* data = key.data();
+    const char* const end = data + key.size();
+#if defined(__SSE2__)
+    // Compared as signed bytes, all the characters outside of that range, including those >= 0x80, are either
+    // < 0x20 or > 0x7e, i.e. not printable
+    const __m128i below = _mm_set1_epi8(0x1f);
+    const __m128i above = _mm_set1_epi8(0x7f);
+    for (; end - data >= 16; data += 16) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(chars, below), _mm_cmplt_epi8(chars, above));
+        if (_mm_movemask_epi8(printable) != 0xffff) {
+            return false;
+        }
+    }
+#endif
+    return std::all_of(data, end, [](char c) { return std::isprint(static_cast<unsigned char>(c)); });
+}
+
+} // namespace syslogsrv
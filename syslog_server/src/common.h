@@ -6,6 +6,7 @@
 
 #include <spdlog/spdlog.h>
 #include <string>
+#include <string_view>
 #include <yaml-cpp/yaml.h>
 
 namespace syslogsrv {
@@ -35,6 +36,9 @@ T yamlAsOrDefault(std::shared_ptr<spdlog::logger> logger, const std::string& nod
     return default_value;
 }
 
+// Whether every character of `key` is printable, as user keys must be
+bool isPrintableASCII(std::string_view key);
+
 } // namespace syslogsrv
 
 #endif
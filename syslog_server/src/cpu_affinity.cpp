@@ -0,0 +1,119 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+
+#include "cpu_affinity.h"
+
+namespace syslogsrv {
+
+namespace {
+
+bool parseCpu(std::string_view raw, int& cpu) {
+    const auto result = std::from_chars(raw.data(), raw.data() + raw.size(), cpu);
+    return (result.ec == std::errc{}) && (result.ptr == raw.data() + raw.size()) && (cpu >= 0) &&
+           (cpu < CPU_SETSIZE);
+}
+
+} // namespace
+
+std::optional<CpuSet> parseCpuList(std::string_view list) {
+    // sysfs files end with a newline
+    while (!list.empty() && (list.back() == '\n' || list.back() == ' ')) {
+        list.remove_suffix(1);
+    }
+
+    CpuSet cpus;
+    while (!list.empty()) {
+        const size_t comma_pos = list.find(',');
+        const std::string_view range = list.substr(0, comma_pos);
+        list.remove_prefix((comma_pos == std::string_view::npos) ? list.size() : comma_pos + 1);
+
+        const size_t dash_pos = range.find('-');
+        int first = 0;
+        int last = 0;
+        if (dash_pos == std::string_view::npos) {
+            if (!parseCpu(range, first)) {
+                return std::nullopt;
+            }
+            last = first;
+        } else if (!parseCpu(range.substr(0, dash_pos), first) || !parseCpu(range.substr(dash_pos + 1), last) ||
+                   (last < first)) {
+            return std::nullopt;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty()) {
+        return std::nullopt;
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::optional<CpuSet> resolveCpuSet(std::string_view spec, const std::string& node_dir) {
+    constexpr std::string_view numa_prefix = "numa:";
+    if (!spec.starts_with(numa_prefix)) {
+        return parseCpuList(spec);
+    }
+
+    int node = 0;
+    const std::string_view node_str = spec.substr(numa_prefix.size());
+    const auto result = std::from_chars(node_str.data(), node_str.data() + node_str.size(), node);
+    if ((result.ec != std::errc{}) || (result.ptr != node_str.data() + node_str.size()) || (node < 0)) {
+        return std::nullopt;
+    }
+
+    std::ifstream cpulist_file(node_dir + "/node" + std::to_string(node) + "/cpulist");
+    std::string cpulist;
+    if (!std::getline(cpulist_file, cpulist)) {
+        return std::nullopt;
+    }
+    return parseCpuList(cpulist);
+}
+
+bool pinCurrentThread(const CpuSet& cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : cpus) {
+        CPU_SET(cpu, &cpu_set);
+    }
+
+    const int r = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (r != 0) {
+        errno = r;
+        return false;
+    }
+    return true;
+}
+
+std::string formatCpuList(const CpuSet& cpus) {
+    std::string list;
+    for (size_t i = 0; i < cpus.size();) {
+        // extend the range for as long as the cpus are consecutive
+        size_t end = i + 1;
+        while ((end < cpus.size()) && (cpus[end] == cpus[end - 1] + 1)) {
+            ++end;
+        }
+        if (!list.empty()) {
+            list += ',';
+        }
+        list += std::to_string(cpus[i]);
+        if (end - i > 1) {
+            list += '-';
+            list += std::to_string(cpus[end - 1]);
+        }
+        i = end;
+    }
+    return list;
+}
+
+} // namespace syslogsrv
@@ -0,0 +1,37 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_CPU_AFFINITY
+#define INCLUDED_CPU_AFFINITY
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace syslogsrv {
+
+// Where the kernel describes the NUMA nodes of the host, one `nodeN` directory per node
+constexpr inline char SYSFS_NUMA_NODE_DIR[] = "/sys/devices/system/node";
+
+// A set of CPU ids, sorted and without duplicates
+using CpuSet = std::vector<int>;
+
+// Parse a list of CPUs in the kernel's "cpulist" format, e.g. "0-3,8,10-11".
+// Returns an empty optional if the list is malformed or empty.
+std::optional<CpuSet> parseCpuList(std::string_view list);
+
+// Resolve a CPU set from the config: either a CPU list, or "numa:N" for all of the CPUs of NUMA node N as listed in
+// `<node_dir>/nodeN/cpulist`. Returns an empty optional if the spec is malformed or the node can't be read.
+std::optional<CpuSet> resolveCpuSet(std::string_view spec, const std::string& node_dir = SYSFS_NUMA_NODE_DIR);
+
+// Restrict the calling thread to run on `cpus`. Threads it starts afterwards inherit the same affinity.
+// Returns false, with errno set, on failure.
+bool pinCurrentThread(const CpuSet& cpus);
+
+// Format `cpus` back into a CPU list, for logging
+std::string formatCpuList(const CpuSet& cpus);
+
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,78 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <cstring>
+
+#include "event_classifier.h"
+
+namespace syslogsrv {
+
+namespace {
+
+bool isTagChar(char c) { return ((c >= 'a') && (c <= 'z')) || (c == '_'); }
+
+EventType eventTypeForTag(std::string_view tag) {
+    // Every tag has a distinct length, so we only need to compare against at most one of them
+    switch (tag.size()) {
+    case 3:
+        return (tag == "req") ? EventType::ReqStart : EventType::Unknown;
+    case 7:
+        return (tag == "req_end") ? EventType::ReqEnd : EventType::Unknown;
+    case 9:
+        return (tag == "data_xfer") ? EventType::DataXfer : EventType::Unknown;
+    case 11:
+        return (tag == "active_reqs") ? EventType::ActiveReqs : EventType::Unknown;
+    default:
+        return EventType::Unknown;
+    }
+}
+
+// Returns the offset of the first "~|~" in `line`, or npos if there is none
+size_t findDelimiter(std::string_view line) {
+    const char* const begin = line.data();
+    const char* const end = begin + line.size();
+    const char* pos = begin;
+    // memchr is vectorised by the C library, so this skips through the syslog header far faster than a
+    // character-by-character search for the whole delimiter
+    while ((pos = static_cast<const char*>(memchr(pos, '~', end - pos))) != nullptr) {
+        if (std::string_view(pos, end - pos).starts_with(DELIMITER)) {
+            return pos - begin;
+        }
+        ++pos;
+    }
+    return std::string_view::npos;
+}
+
+} // namespace
+
+ClassifiedEvent classifyEvent(std::string_view line) {
+    const size_t delimiter_pos = findDelimiter(line);
+    if (delimiter_pos == std::string_view::npos) {
+        return {};
+    }
+
+    size_t tag_start = delimiter_pos;
+    while ((tag_start > 0) && isTagChar(line[tag_start - 1])) {
+        --tag_start;
+    }
+
+    const EventType type = eventTypeForTag(line.substr(tag_start, delimiter_pos - tag_start));
+    if (type == EventType::Unknown) {
+        return {};
+    }
+    return {type, line.substr(tag_start)};
+}
+
+std::string_view eventUserKey(std::string_view payload) {
+    // Skip the type tag and the request key (or instance id, for active_reqs)
+    for (int i = 0; i < 2; ++i) {
+        const size_t delimiter_pos = findDelimiter(payload);
+        if (delimiter_pos == std::string_view::npos) {
+            return {};
+        }
+        payload.remove_prefix(delimiter_pos + DELIMITER.size());
+    }
+    return payload.substr(0, findDelimiter(payload));
+}
+
+} // namespace syslogsrv
@@ -0,0 +1,43 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_EVENT_CLASSIFIER
+#define INCLUDED_EVENT_CLASSIFIER
+
+#include <cstdint>
+#include <string_view>
+
+namespace syslogsrv {
+
+// Separates the fields of every event sent by HAProxy
+constexpr inline std::string_view DELIMITER = "~|~";
+
+// The kinds of event that HAProxy sends us for rate-limiting (see docs/syslog-server-api.md)
+enum class EventType : uint8_t {
+    Unknown,
+    ReqStart,   // "req~|~..."
+    ReqEnd,     // "req_end~|~..."
+    DataXfer,   // "data_xfer~|~..."
+    ActiveReqs, // "active_reqs~|~..."
+};
+
+struct ClassifiedEvent {
+    EventType m_type = EventType::Unknown;
+
+    // The event itself, starting at its type tag, e.g. "req~|~1.2.3.4:58840~|~...".
+    // Empty if the line does not contain an event.
+    std::string_view m_payload;
+};
+
+// Locate the event in a line logged by HAProxy, in a single pass over the line.
+// The event starts at the word directly preceding the first "~|~" delimiter in the line; lines without a delimiter,
+// or where that word is not a known event type, are classified as `EventType::Unknown`.
+ClassifiedEvent classifyEvent(std::string_view line);
+
+// The user key of a classified event, which is the third field of every event type, without parsing the rest of it.
+// Returns an empty string if the payload has fewer than three fields.
+std::string_view eventUserKey(std::string_view payload);
+
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,140 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <array>
+#include <charconv>
+
+#include "event_classifier.h"
+#include "event_parser.h"
+#include "field_split.h"
+
+namespace syslogsrv {
+
+namespace {
+
+// Names for the tokens of a request-start message
+enum class RequestToken {
+    Type,
+    RequestKey,
+    UserKey,
+    Verb,
+    Direction,
+    InstanceId,
+    ActiveRequests,
+    RequestClass,
+    Count // Sentinel value for the number of tokens
+};
+
+std::optional<Direction> parseDirection(std::string_view raw) {
+    if (raw == "up") {
+        return Direction::Up;
+    }
+    if (raw == "dwn") {
+        return Direction::Down;
+    }
+    return std::nullopt;
+}
+
+bool parseInt(std::string_view raw, int& value) {
+    return std::from_chars(raw.begin(), raw.end(), value).ec == std::errc{};
+}
+
+// Parse the trace timestamp that follows the last regular field of a sampled message, which must also be the last
+// field of the message. Returns false if there isn't exactly one more (integer) field.
+bool parseTraceTimestamp(FieldSplit& split, std::optional<int64_t>& trace_send_usec) {
+    const std::string_view raw = split.next();
+    int64_t value = 0;
+    if (!split.finishedSuccessfully() || (std::from_chars(raw.begin(), raw.end(), value).ec != std::errc{})) {
+        return false;
+    }
+    trace_send_usec = value;
+    return true;
+}
+
+} // namespace
+
+std::string_view directionName(Direction direction) { return (direction == Direction::Up) ? "up" : "dwn"; }
+
+std::optional<RequestStartEvent> parseRequestStart(std::string_view raw_input) {
+    // Note: the last token (request class) may be empty
+    FieldSplit split(raw_input);
+    std::array<std::string_view, static_cast<size_t>(RequestToken::Count)> tokens;
+    for (auto& token : tokens) {
+        token = split.next();
+    }
+
+    RequestStartEvent event;
+    if (!split.finishedSuccessfully() && !parseTraceTimestamp(split, event.m_trace_send_usec)) {
+        return std::nullopt;
+    }
+    const auto direction = parseDirection(tokens[static_cast<size_t>(RequestToken::Direction)]);
+    if (!direction || !parseInt(tokens[static_cast<size_t>(RequestToken::ActiveRequests)], event.m_active_requests)) {
+        return std::nullopt;
+    }
+    event.m_user_key = tokens[static_cast<size_t>(RequestToken::UserKey)];
+    event.m_verb = tokens[static_cast<size_t>(RequestToken::Verb)];
+    event.m_direction = *direction;
+    event.m_instance_id = tokens[static_cast<size_t>(RequestToken::InstanceId)];
+    event.m_request_class = tokens[static_cast<size_t>(RequestToken::RequestClass)];
+    return event;
+}
+
+std::optional<RequestEndEvent> parseRequestEnd(std::string_view raw_input) {
+    FieldSplit split(raw_input);
+    split.next(); // Skip past the 'req_end' prefix
+    split.next(); // Skip past unused "request key" field
+    const std::string_view user_key = split.next();
+    split.next(); // Skip past unused "verb" field
+    const auto direction = parseDirection(split.next());
+    const std::string_view instance_id = split.next();
+    const std::string_view active_reqs_str = split.next();
+
+    RequestEndEvent event;
+    if (!split.finishedSuccessfully() || !direction || !parseInt(active_reqs_str, event.m_active_requests)) {
+        return std::nullopt;
+    }
+    event.m_user_key = user_key;
+    event.m_direction = *direction;
+    event.m_instance_id = instance_id;
+    return event;
+}
+
+std::optional<DataXferEvent> parseDataXfer(std::string_view raw_input) {
+    FieldSplit split(raw_input);
+    split.next(); // Skip past the 'data_xfer' prefix
+    split.next(); // Skip past unused "request key" field
+    const std::string_view user_key = split.next();
+    const auto direction = parseDirection(split.next());
+    const std::string_view len_str = split.next();
+
+    DataXferEvent event;
+    if (!split.finishedSuccessfully() && !parseTraceTimestamp(split, event.m_trace_send_usec)) {
+        return std::nullopt;
+    }
+    if (!direction || !parseInt(len_str, event.m_length)) {
+        return std::nullopt;
+    }
+    event.m_user_key = user_key;
+    event.m_direction = *direction;
+    return event;
+}
+
+std::optional<ActiveRequestsEvent> parseActiveRequests(std::string_view raw_input) {
+    FieldSplit split(raw_input);
+    split.next(); // Skip past the 'active_reqs' prefix
+    const std::string_view instance_id = split.next();
+    const std::string_view user_key = split.next();
+    const auto direction = parseDirection(split.next());
+    const std::string_view active_reqs_str = split.next();
+
+    ActiveRequestsEvent event;
+    if (!split.finishedSuccessfully() || !direction || !parseInt(active_reqs_str, event.m_active_requests)) {
+        return std::nullopt;
+    }
+    event.m_instance_id = instance_id;
+    event.m_user_key = user_key;
+    event.m_direction = *direction;
+    return event;
+}
+
+} // namespace syslogsrv
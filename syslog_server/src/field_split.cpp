@@ -0,0 +1,97 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "event_classifier.h"
+#include "field_split.h"
+
+namespace syslogsrv {
+
+static_assert(DELIMITER == "~|~", "FieldSplit only searches for the event delimiter");
+
+FieldSplit::FieldSplit(const std::string_view input) : m_input(input) {
+    // Like std::string_view::find, delimiters are matched from left to right and don't overlap, so a candidate is
+    // only taken if it starts after the end of the previous delimiter
+    const char* const data = m_input.data();
+    const size_t size = m_input.size();
+    size_t next_allowed = 0;
+    auto add = [&](size_t offset) {
+        if (offset < next_allowed) {
+            return true;
+        }
+        if (m_delimiter_count == MAX_DELIMITERS) {
+            m_delimiters_truncated = true;
+            return false;
+        }
+        m_delimiters[m_delimiter_count++] = static_cast<uint32_t>(offset);
+        next_allowed = offset + DELIMITER.size();
+        return true;
+    };
+
+    size_t offset = 0;
+#if defined(__SSE2__)
+    // Compare 16 candidate offsets at a time, with the three bytes of the delimiter loaded from consecutive offsets
+    const __m128i first = _mm_set1_epi8(DELIMITER[0]);
+    const __m128i second = _mm_set1_epi8(DELIMITER[1]);
+    const __m128i third = _mm_set1_epi8(DELIMITER[2]);
+    for (; offset + 16 + DELIMITER.size() - 1 <= size; offset += 16) {
+        const char* const chunk = data + offset;
+        const __m128i matches = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk)), first),
+                          _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + 1)), second)),
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + 2)), third));
+        for (uint32_t mask = _mm_movemask_epi8(matches); mask != 0; mask &= mask - 1) {
+            if (!add(offset + __builtin_ctz(mask))) {
+                return;
+            }
+        }
+    }
+#endif
+    for (; offset + DELIMITER.size() <= size; ++offset) {
+        if (data[offset] == DELIMITER[0] && data[offset + 1] == DELIMITER[1] && data[offset + 2] == DELIMITER[2] &&
+            !add(offset)) {
+            return;
+        }
+    }
+}
+
+std::string_view FieldSplit::next() {
+    // The same states as StringSplit::next()
+    if (m_error) {
+        return {};
+    }
+    if (m_eof) {
+        m_error = true;
+        return {};
+    }
+    if (m_input.empty()) {
+        m_eof = true;
+        m_index = 1;
+        return {};
+    }
+
+    size_t delimiter = std::string_view::npos;
+    if (m_next_delimiter < m_delimiter_count) {
+        delimiter = m_delimiters[m_next_delimiter++];
+    } else if (m_delimiters_truncated) {
+        delimiter = m_input.find(DELIMITER, m_index);
+    }
+
+    std::string_view result;
+    if (delimiter == std::string_view::npos) {
+        result = m_input.substr(m_index);
+        m_eof = true;
+        m_index = m_input.size();
+    } else {
+        result = m_input.substr(m_index, delimiter - m_index);
+        m_index = delimiter + DELIMITER.size();
+    }
+    return result;
+}
+
+} // namespace syslogsrv
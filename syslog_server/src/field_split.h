@@ -0,0 +1,45 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_FIELD_SPLIT
+#define INCLUDED_FIELD_SPLIT
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace syslogsrv {
+
+// A tokenizer for the fields of an event from HAProxy, which are separated by DELIMITER ("~|~").
+// It behaves exactly like a `StringSplit` on DELIMITER, but locates every delimiter in the input up front, in a
+// single (vectorized, where available) pass, rather than searching for each one as the fields are read.
+// The caller is responsible for ensuring that the input and its underlying data outlive the `FieldSplit` object.
+class FieldSplit {
+  public:
+    // The number of delimiters located up front, enough for all of our events with some to spare. Any further
+    // delimiters are searched for as the fields are read.
+    static constexpr size_t MAX_DELIMITERS = 15;
+
+    explicit FieldSplit(std::string_view input);
+
+    // Get the next field, see `StringSplit::next()`
+    std::string_view next();
+
+    // Whether all of the fields have been read, without excess calls to `next()`, see
+    // `StringSplit::finishedSuccessfully()`
+    bool finishedSuccessfully() const { return !m_error && (m_index >= m_input.size()); }
+
+  private:
+    const std::string_view m_input;
+    std::array<uint32_t, MAX_DELIMITERS> m_delimiters; // the offsets of the first delimiters in the input
+    uint32_t m_delimiter_count = 0;
+    uint32_t m_next_delimiter = 0;
+    bool m_delimiters_truncated = false; // there may be more than MAX_DELIMITERS
+    size_t m_index = 0;
+    bool m_error = false;
+    bool m_eof = false;
+};
+
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,169 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_FLAT_HASH_MAP
+#define INCLUDED_FLAT_HASH_MAP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace syslogsrv {
+
+// An open-addressing hash map that stores its entries inline in a single array, using linear probing.
+//
+// This is intended for maps that are repeatedly filled and cleared, such as the Processor's per-flush aggregation
+// maps: `clear()` keeps the allocated capacity, so once the map has grown to its working size, filling it again
+// doesn't allocate at all. Keys and values must be default-constructible and cheap to copy (e.g. integers).
+//
+// Iterators and references are invalidated by any insertion or erasure.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+  public:
+    using value_type = std::pair<Key, Value>;
+
+    template <bool IsConst>
+    class Iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+        using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+        using MapPtr = std::conditional_t<IsConst, const FlatHashMap*, FlatHashMap*>;
+
+        Iterator() = default;
+        Iterator(MapPtr map, size_t index) : m_map(map), m_index(index) { skipUnused(); }
+
+        reference operator*() const { return m_map->m_slots[m_index]; }
+        pointer operator->() const { return &m_map->m_slots[m_index]; }
+        Iterator& operator++() {
+            ++m_index;
+            skipUnused();
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator prev = *this;
+            ++(*this);
+            return prev;
+        }
+        bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+
+      private:
+        void skipUnused() {
+            while ((m_index < m_map->m_slots.size()) && !m_map->m_used[m_index]) {
+                ++m_index;
+            }
+        }
+
+        MapPtr m_map = nullptr;
+        size_t m_index = 0;
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() = default;
+
+    iterator begin() { return {this, 0}; }
+    iterator end() { return {this, m_slots.size()}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, m_slots.size()}; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t capacity() const { return m_slots.size(); }
+
+    // Returns the value for `key`, inserting a value-initialised one if there is none
+    Value& operator[](const Key& key) {
+        if ((m_size + 1) * 2 > m_slots.size()) {
+            grow();
+        }
+        size_t index = slotFor(key);
+        if (!m_used[index]) {
+            m_used[index] = 1;
+            m_slots[index] = value_type(key, Value{});
+            ++m_size;
+        }
+        return m_slots[index].second;
+    }
+
+    iterator find(const Key& key) {
+        if (m_size == 0) {
+            return end();
+        }
+        const size_t index = slotFor(key);
+        return m_used[index] ? iterator(this, index) : end();
+    }
+    const_iterator find(const Key& key) const {
+        if (m_size == 0) {
+            return end();
+        }
+        const size_t index = slotFor(key);
+        return m_used[index] ? const_iterator(this, index) : end();
+    }
+
+    // Remove all entries, keeping the current capacity
+    void clear() {
+        if (m_size != 0) {
+            std::fill(m_used.begin(), m_used.end(), 0);
+            m_size = 0;
+        }
+    }
+
+    // Remove all entries for which `pred(entry)` returns true
+    template <typename Pred>
+    void eraseIf(Pred pred) {
+        // Removing entries from a linear-probing table needs existing entries to be shuffled back into the gaps,
+        // so it's simpler to rebuild the table in-place from the entries we're keeping. This isn't on a hot path.
+        std::vector<value_type> kept;
+        kept.reserve(m_size);
+        for (const auto& entry : *this) {
+            if (!pred(entry)) {
+                kept.push_back(entry);
+            }
+        }
+        clear();
+        for (const auto& [key, value] : kept) {
+            (*this)[key] = value;
+        }
+    }
+
+  private:
+    // Returns the slot holding `key`, or the empty slot where it should be inserted. There must be an empty slot.
+    size_t slotFor(const Key& key) const {
+        const size_t mask = m_slots.size() - 1;
+        size_t index = Hash()(key) & mask;
+        while (m_used[index] && !KeyEqual()(m_slots[index].first, key)) {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    // Double the capacity (keeping the load factor at most 1/2) and re-insert every entry
+    void grow() {
+        std::vector<value_type> old_slots(std::max<size_t>(16, m_slots.size() * 2));
+        std::vector<uint8_t> old_used(old_slots.size(), 0);
+        old_slots.swap(m_slots);
+        old_used.swap(m_used);
+
+        for (size_t i = 0; i < old_slots.size(); ++i) {
+            if (old_used[i]) {
+                const size_t index = slotFor(old_slots[i].first);
+                m_used[index] = 1;
+                m_slots[index] = std::move(old_slots[i]);
+            }
+        }
+    }
+
+    std::vector<value_type> m_slots; // size is always zero or a power of two
+    std::vector<uint8_t> m_used; // non-zero for slots holding an entry
+    size_t m_size = 0;
+};
+
+} // namespace syslogsrv
+
+#endif
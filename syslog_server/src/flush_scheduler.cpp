@@ -0,0 +1,25 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+
+#include "flush_scheduler.h"
+
+namespace syslogsrv {
+
+FlushScheduler::FlushScheduler(std::chrono::milliseconds min_period, std::chrono::milliseconds max_period,
+                               uint64_t max_pending_replies)
+    : m_min_period(min_period), m_max_period(std::max(min_period, max_period)), m_period(min_period),
+      m_max_pending_replies(max_pending_replies) {}
+
+void FlushScheduler::update(uint64_t pending_replies) {
+    // The gap between the two thresholds keeps the period from flip-flopping on every flush. They're compared
+    // without dividing the limit, which would round them down to zero for small limits.
+    if (pending_replies * 4 > m_max_pending_replies) {
+        m_period = std::min(std::max(m_period * 2, std::chrono::milliseconds(1)), m_max_period);
+    } else if (pending_replies * 16 < m_max_pending_replies) {
+        m_period = std::max(m_period / 2, m_min_period);
+    }
+}
+
+} // namespace syslogsrv
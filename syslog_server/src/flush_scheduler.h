@@ -0,0 +1,43 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_FLUSH_SCHEDULER
+#define INCLUDED_FLUSH_SCHEDULER
+
+#include <chrono>
+#include <cstdint>
+
+namespace syslogsrv {
+
+// Decides how often the Processor flushes its aggregated updates to redis, based on how far behind redis is.
+//
+// While redis keeps up, we flush every `min_period`. As the number of commands still waiting for a reply grows,
+// the period is doubled (up to `max_period`) so that each flush aggregates more events into fewer commands, and
+// shrinks back again once redis catches up. Once `max_pending_replies` commands are outstanding no more are sent
+// at all until some replies come back, rather than growing the pipeline in memory without bound.
+class FlushScheduler {
+  public:
+    FlushScheduler(std::chrono::milliseconds min_period, std::chrono::milliseconds max_period,
+                   uint64_t max_pending_replies);
+
+    std::chrono::milliseconds period() const { return m_period; }
+    std::chrono::milliseconds minPeriod() const { return m_min_period; }
+    std::chrono::milliseconds maxPeriod() const { return m_max_period; }
+    uint64_t maxPendingReplies() const { return m_max_pending_replies; }
+
+    // Adjust the flush period to a flush finding `pending_replies` commands still waiting for a reply
+    void update(uint64_t pending_replies);
+
+    // Whether new commands must be held back from a connection with `pending_replies` outstanding
+    bool overloaded(uint64_t pending_replies) const { return pending_replies >= m_max_pending_replies; }
+
+  private:
+    std::chrono::milliseconds m_min_period;
+    std::chrono::milliseconds m_max_period;
+    std::chrono::milliseconds m_period;
+    uint64_t m_max_pending_replies;
+};
+
+} // namespace syslogsrv
+
+#endif
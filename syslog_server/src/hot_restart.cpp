@@ -0,0 +1,257 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "hot_restart.h"
+
+namespace syslogsrv {
+
+namespace {
+
+// The signal that `wakeThread()` interrupts threads with
+constexpr int WAKEUP_SIGNAL = SIGUSR1;
+
+// What the new process sends back once it is receiving on the sockets
+constexpr char HANDOFF_CONFIRMATION = 'k';
+
+std::optional<sockaddr_un> unixAddress(const std::string& path) {
+    sockaddr_un addr = {};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return std::nullopt;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    return addr;
+}
+
+void closeAll(const std::vector<int>& fds) {
+    for (const int fd : fds) {
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+bool sendSockets(int conn, const std::vector<int>& fds) {
+    if (fds.size() > MAX_HANDOFF_SOCKETS) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // The number of sockets is sent as the payload too, so that the receiver can tell if any went missing
+    uint32_t count = static_cast<uint32_t>(fds.size());
+    iovec iov = {&count, sizeof(count)};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(MAX_HANDOFF_SOCKETS * sizeof(int))] = {};
+    if (!fds.empty()) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), fds.data(), fds.size() * sizeof(int));
+    }
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(conn, &msg, MSG_NOSIGNAL);
+    } while ((sent == -1) && (errno == EINTR));
+    if (sent != static_cast<ssize_t>(sizeof(count))) {
+        if (sent >= 0) {
+            errno = EPROTO;
+        }
+        return false;
+    }
+    return true;
+}
+
+std::optional<std::vector<int>> receiveSockets(int conn) {
+    uint32_t count = 0;
+    iovec iov = {&count, sizeof(count)};
+    alignas(cmsghdr) char control[CMSG_SPACE(MAX_HANDOFF_SOCKETS * sizeof(int))] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    do {
+        received = ::recvmsg(conn, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while ((received == -1) && (errno == EINTR));
+    if (received == -1) {
+        return std::nullopt;
+    }
+
+    std::vector<int> fds;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+            const size_t fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const size_t first = fds.size();
+            fds.resize(first + fd_count);
+            std::memcpy(fds.data() + first, CMSG_DATA(cmsg), fd_count * sizeof(int));
+        }
+    }
+    if ((received != static_cast<ssize_t>(sizeof(count))) || (msg.msg_flags & MSG_CTRUNC) || (fds.size() != count)) {
+        closeAll(fds);
+        errno = EPROTO;
+        return std::nullopt;
+    }
+    return fds;
+}
+
+HandoffClient::~HandoffClient() {
+    if (m_conn != -1) {
+        ::close(m_conn);
+    }
+}
+
+std::vector<int> HandoffClient::requestSockets(const std::string& path) {
+    auto logger = spdlog::get(SERVER_NAME);
+
+    const auto addr = unixAddress(path);
+    if (!addr) {
+        logger->error("Invalid hand-off socket path '{}'", path);
+        return {};
+    }
+    m_conn = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_conn == -1) {
+        logger->error("Can't create the hand-off socket: {}", strerror(errno));
+        return {};
+    }
+    if (::connect(m_conn, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) == -1) {
+        // Nothing is running to take over from, or whatever was has gone away
+        logger->info("No syslog server to take over from on {} ({}), starting afresh", path, strerror(errno));
+        ::close(m_conn);
+        m_conn = -1;
+        return {};
+    }
+
+    auto fds = receiveSockets(m_conn);
+    if (!fds) {
+        logger->error("Failed to receive the sockets of the running syslog server on {}: {}", path, strerror(errno));
+        ::close(m_conn);
+        m_conn = -1;
+        return {};
+    }
+    logger->info("Took over {} sockets from the running syslog server on {}", fds->size(), path);
+    return *fds;
+}
+
+void HandoffClient::confirm() {
+    if (m_conn == -1) {
+        return;
+    }
+    if (::send(m_conn, &HANDOFF_CONFIRMATION, 1, MSG_NOSIGNAL) != 1) {
+        spdlog::get(SERVER_NAME)->error("Failed to confirm the hand-off: {}", strerror(errno));
+    }
+    ::close(m_conn);
+    m_conn = -1;
+}
+
+HandoffListener::~HandoffListener() {
+    // The path isn't unlinked, since by now it is likely the listener of whichever process took over from us
+    if (m_listen_fd != -1) {
+        ::close(m_listen_fd);
+    }
+}
+
+bool HandoffListener::listen(const std::string& path) {
+    auto logger = spdlog::get(SERVER_NAME);
+
+    const auto addr = unixAddress(path);
+    if (!addr) {
+        logger->error("Invalid hand-off socket path '{}'", path);
+        return false;
+    }
+    m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listen_fd == -1) {
+        logger->error("Can't create the hand-off socket: {}", strerror(errno));
+        return false;
+    }
+
+    // Whatever is at the path belongs to the process we took over from, if any, or to one that is no longer running
+    ::unlink(path.c_str());
+    if ((::bind(m_listen_fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) == -1) ||
+        (::listen(m_listen_fd, 1) == -1)) {
+        logger->error("Can't listen for hand-off requests on {}: {}", path, strerror(errno));
+        ::close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+    logger->info("Listening for hand-off requests on {}", path);
+    return true;
+}
+
+bool HandoffListener::waitForHandoff(const std::vector<int>& fds, std::chrono::milliseconds confirm_timeout) {
+    auto logger = spdlog::get(SERVER_NAME);
+
+    while (m_listen_fd != -1) {
+        const int conn = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn == -1) {
+            if ((errno == EINTR) || (errno == ECONNABORTED)) {
+                continue;
+            }
+            logger->error("Can't accept hand-off requests: {}", strerror(errno));
+            return false;
+        }
+
+        const bool confirmed = handOff(conn, fds, confirm_timeout);
+        ::close(conn);
+        if (confirmed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HandoffListener::handOff(int conn, const std::vector<int>& fds, std::chrono::milliseconds confirm_timeout) {
+    auto logger = spdlog::get(SERVER_NAME);
+
+    logger->info("A new syslog server is taking over, handing over {} sockets", fds.size());
+    if (!sendSockets(conn, fds)) {
+        logger->error("Failed to hand over our sockets: {}", strerror(errno));
+        return false;
+    }
+
+    // Both processes receive on the sockets until the new one confirms that it is up, so if it fails to start then
+    // we just carry on
+    pollfd conn_poll = {conn, POLLIN, 0};
+    char confirmation = 0;
+    int ready;
+    do {
+        ready = ::poll(&conn_poll, 1, static_cast<int>(confirm_timeout.count()));
+    } while ((ready == -1) && (errno == EINTR));
+    if ((ready <= 0) || (::recv(conn, &confirmation, 1, 0) != 1) || (confirmation != HANDOFF_CONFIRMATION)) {
+        logger->error("The new syslog server didn't confirm taking over, carrying on");
+        return false;
+    }
+    return true;
+}
+
+void installWakeupHandler() {
+    struct sigaction action = {};
+    // Without SA_RESTART, so that the blocking call fails
+    action.sa_handler = [](int) {};
+    sigemptyset(&action.sa_mask);
+    ::sigaction(WAKEUP_SIGNAL, &action, nullptr);
+}
+
+void wakeThread(pthread_t thread) { ::pthread_kill(thread, WAKEUP_SIGNAL); }
+
+} // namespace syslogsrv
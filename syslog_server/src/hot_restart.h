@@ -0,0 +1,88 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_HOT_RESTART
+#define INCLUDED_HOT_RESTART
+
+#include <chrono>
+#include <optional>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace syslogsrv {
+
+// A running syslog server can hand its UDP sockets over to a new process, so that it can be restarted (e.g. to change
+// its config) without losing any datagrams: the sockets stay bound throughout, and whatever arrives while neither
+// process is receiving waits in their buffers.
+//
+// With `handoff_socket` configured, each process listens on that unix socket once it has started. A new process first
+// connects to it and is sent the sockets of the running one. Once it is receiving on them itself, it confirms the
+// hand-off, and the old process stops receiving, flushes everything it has aggregated to redis and exits. If the new
+// process goes away without confirming, the old one carries on as before.
+
+// The longest a running process waits for a new process that has been sent its sockets to confirm the hand-off
+constexpr inline std::chrono::seconds HANDOFF_CONFIRM_TIMEOUT(60);
+
+// The most sockets that are handed over, which is the kernel's limit on file descriptors per message
+constexpr inline size_t MAX_HANDOFF_SOCKETS = 253;
+
+// Send `fds` over the unix socket `conn`. Returns false, with errno set, on failure.
+bool sendSockets(int conn, const std::vector<int>& fds);
+
+// Receive the file descriptors sent by `sendSockets()` over the unix socket `conn`. Returns an empty optional, with
+// errno set, on failure.
+std::optional<std::vector<int>> receiveSockets(int conn);
+
+// The new process's end of a hand-off
+class HandoffClient {
+  public:
+    HandoffClient() = default;
+    ~HandoffClient();
+
+    HandoffClient(const HandoffClient&) = delete;
+    HandoffClient& operator=(const HandoffClient&) = delete;
+
+    // Ask the process listening on `path`, if any, for its sockets. Returns an empty list if there are none to take
+    // over, in which case this is a cold start.
+    std::vector<int> requestSockets(const std::string& path);
+
+    // Tell the old process that its sockets are being received on, so that it can stop. Does nothing if no sockets
+    // were handed over.
+    void confirm();
+
+  private:
+    int m_conn = -1;
+};
+
+// The running process's end of a hand-off
+class HandoffListener {
+  public:
+    HandoffListener() = default;
+    ~HandoffListener();
+
+    HandoffListener(const HandoffListener&) = delete;
+    HandoffListener& operator=(const HandoffListener&) = delete;
+
+    // Listen on `path`, replacing whatever is there. Returns false, having logged why, if it can't be listened on.
+    bool listen(const std::string& path);
+
+    // Wait for a new process to ask for our sockets, and hand `fds` over to it. Returns true once a new process has
+    // confirmed taking them over, or false if we can no longer listen for one.
+    bool waitForHandoff(const std::vector<int>& fds,
+                        std::chrono::milliseconds confirm_timeout = HANDOFF_CONFIRM_TIMEOUT);
+
+  private:
+    // Hand `fds` over to the new process connected on `conn`, returning whether it confirmed
+    bool handOff(int conn, const std::vector<int>& fds, std::chrono::milliseconds confirm_timeout);
+
+    int m_listen_fd = -1;
+};
+
+// Have `wakeThread()` interrupt any blocking call of the thread it is given, which then fails with EINTR
+void installWakeupHandler();
+void wakeThread(pthread_t thread);
+
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,290 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <optional>
+
+#include "io_uring_receiver.h"
+
+#ifdef WEIR_SYSLOGSRV_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+namespace syslogsrv {
+
+namespace {
+
+// The kernel caps a provided-buffer ring at 32768 entries (buffer ids are 16 bits)
+constexpr size_t MAX_RING_BUFFERS = 32768;
+
+} // namespace
+
+#ifdef WEIR_SYSLOGSRV_HAVE_IO_URING
+
+namespace {
+
+// We only ever register one group of buffers per ring
+constexpr int BUFFER_GROUP_ID = 0;
+
+// Tell the completions of the multishot receive from that of its cancellation
+constexpr uint64_t RECV_USER_DATA = 1;
+constexpr uint64_t CANCEL_USER_DATA = 2;
+
+} // namespace
+
+struct IoUringReceiver::Ring {
+    io_uring ring = {};
+    bool ring_initialised = false;
+    io_uring_buf_ring* buf_ring = nullptr;
+    std::unique_ptr<char[]> buffers;
+    size_t slot_size = 0;
+    // Describes the layout of each completion for the multishot recvmsg. We ask for neither the source address nor
+    // any control messages, so each buffer holds an `io_uring_recvmsg_out` header directly followed by the payload.
+    msghdr msg = {};
+    int sock = -1;
+    int buf_ring_mask = 0;
+
+    // Post a multishot receive. It stays armed until the kernel posts a completion without IORING_CQE_F_MORE.
+    bool arm() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (sqe == nullptr) {
+            errno = EBUSY;
+            return false;
+        }
+        io_uring_prep_recvmsg_multishot(sqe, sock, &msg, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP_ID;
+        io_uring_sqe_set_data64(sqe, RECV_USER_DATA);
+        return true;
+    }
+
+    // Pass the datagram of every completion that is ready to `handler`, handing their buffers straight back to the
+    // kernel. Sets `terminated` if the multishot receive has ended, `error` if it failed and `cancel_result` once
+    // its cancellation has completed. Returns the number of datagrams handled.
+    int reap(const DatagramHandler& handler, bool& terminated, int& error, std::optional<int>& cancel_result) {
+        int handled = 0;
+        int recycled = 0;
+        unsigned int seen = 0;
+
+        unsigned int head;
+        io_uring_cqe* cqe;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            ++seen;
+            if (io_uring_cqe_get_data64(cqe) == CANCEL_USER_DATA) {
+                cancel_result = cqe->res;
+                continue;
+            }
+            if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
+                // The multishot receive has been terminated, e.g. because we briefly ran out of buffers
+                terminated = true;
+            }
+
+            if (cqe->res < 0) {
+                // Running out of buffers just means the datagrams wait on the socket until we re-arm, and being
+                // cancelled is what we asked for; anything else is a real error
+                if ((cqe->res != -ENOBUFS) && (cqe->res != -ECANCELED)) {
+                    error = -cqe->res;
+                }
+                continue;
+            }
+
+            if ((cqe->flags & IORING_CQE_F_BUFFER) == 0) {
+                continue;
+            }
+            const auto buffer_id = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            char* slot = buffer(buffer_id);
+
+            io_uring_recvmsg_out* out = io_uring_recvmsg_validate(slot, cqe->res, &msg);
+            if (out != nullptr) {
+                const auto* payload = static_cast<const char*>(io_uring_recvmsg_payload(out, &msg));
+                const size_t len = io_uring_recvmsg_payload_length(out, cqe->res, &msg);
+                handler(std::string_view(payload, len), (out->flags & MSG_TRUNC) != 0);
+                ++handled;
+            }
+
+            // The datagram has been handled, so hand the buffer straight back to the kernel
+            io_uring_buf_ring_add(buf_ring, slot, slot_size, buffer_id, buf_ring_mask, recycled++);
+        }
+        io_uring_cq_advance(&ring, seen);
+        io_uring_buf_ring_advance(buf_ring, recycled);
+        return handled;
+    }
+
+    char* buffer(unsigned short buffer_id) { return buffers.get() + (buffer_id * slot_size); }
+};
+
+IoUringReceiver::IoUringReceiver(size_t buffer_count, size_t buffer_size)
+    : m_buffer_count(std::min(std::bit_ceil(std::max<size_t>(buffer_count, 1)), MAX_RING_BUFFERS)),
+      m_buffer_size(buffer_size) {}
+
+IoUringReceiver::~IoUringReceiver() {
+    if (!m_ring) {
+        return;
+    }
+    if (m_ring->buf_ring != nullptr) {
+        io_uring_free_buf_ring(&m_ring->ring, m_ring->buf_ring, m_buffer_count, BUFFER_GROUP_ID);
+    }
+    if (m_ring->ring_initialised) {
+        io_uring_queue_exit(&m_ring->ring);
+    }
+}
+
+bool IoUringReceiver::start(int sock) {
+    auto ring = std::make_unique<Ring>();
+    ring->sock = sock;
+    ring->slot_size = sizeof(io_uring_recvmsg_out) + m_buffer_size;
+
+    // Only our producer thread ever touches the ring, which lets the kernel skip some synchronisation
+    int r = io_uring_queue_init(64, &ring->ring, IORING_SETUP_SINGLE_ISSUER);
+    if (r == -EINVAL) {
+        // IORING_SETUP_SINGLE_ISSUER needs Linux 6.0, retry without it
+        r = io_uring_queue_init(64, &ring->ring, 0);
+    }
+    if (r < 0) {
+        errno = -r;
+        return false;
+    }
+    ring->ring_initialised = true;
+    m_ring = std::move(ring);
+
+    r = 0;
+    m_ring->buf_ring = io_uring_setup_buf_ring(&m_ring->ring, m_buffer_count, BUFFER_GROUP_ID, 0, &r);
+    if (m_ring->buf_ring == nullptr) {
+        errno = -r;
+        return false;
+    }
+
+    m_ring->buffers.reset(new char[m_buffer_count * m_ring->slot_size]);
+    m_ring->buf_ring_mask = io_uring_buf_ring_mask(m_buffer_count);
+    for (size_t i = 0; i < m_buffer_count; ++i) {
+        io_uring_buf_ring_add(m_ring->buf_ring, m_ring->buffer(i), m_ring->slot_size, i, m_ring->buf_ring_mask, i);
+    }
+    io_uring_buf_ring_advance(m_ring->buf_ring, m_buffer_count);
+
+    if (!m_ring->arm()) {
+        return false;
+    }
+    r = io_uring_submit(&m_ring->ring);
+    if (r < 0) {
+        errno = -r;
+        return false;
+    }
+    return true;
+}
+
+int IoUringReceiver::receive(const DatagramHandler& handler) {
+    if (!m_ring) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // This also submits the re-armed receive, if the previous call had to queue one
+    int r = io_uring_submit_and_wait(&m_ring->ring, 1);
+    if (r < 0) {
+        if (r == -EINTR) {
+            return 0;
+        }
+        errno = -r;
+        return -1;
+    }
+
+    bool rearm = false;
+    int error = 0;
+    std::optional<int> cancel_result;
+    const int handled = m_ring->reap(handler, rearm, error, cancel_result);
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    if (rearm && !m_ring->arm()) {
+        return -1;
+    }
+    return handled;
+}
+
+int IoUringReceiver::drain(const DatagramHandler& handler) {
+    if (!m_ring) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&m_ring->ring);
+    if (sqe == nullptr) {
+        errno = EBUSY;
+        return -1;
+    }
+    // Submitted after the re-armed receive, if the last call to `receive()` queued one, so that it is found
+    io_uring_prep_cancel64(sqe, RECV_USER_DATA, 0);
+    io_uring_sqe_set_data64(sqe, CANCEL_USER_DATA);
+
+    // The receive's last completion, without IORING_CQE_F_MORE, comes after every datagram it received
+    int handled = 0;
+    bool terminated = false;
+    int error = 0;
+    std::optional<int> cancel_result;
+    while (!terminated) {
+        const int r = io_uring_submit_and_wait(&m_ring->ring, 1);
+        if (r < 0) {
+            if (r == -EINTR) {
+                continue; // we're being woken up to stop, which we are already doing
+            }
+            errno = -r;
+            return -1;
+        }
+        handled += m_ring->reap(handler, terminated, error, cancel_result);
+        if (cancel_result && (*cancel_result < 0) && (*cancel_result != -EALREADY)) {
+            // There was no receive left to cancel, so its last completion has been reaped already
+            break;
+        }
+    }
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return handled;
+}
+
+bool ioUringSupported() {
+    io_uring ring;
+    if (io_uring_queue_init(2, &ring, 0) < 0) {
+        return false;
+    }
+    io_uring_queue_exit(&ring);
+    return true;
+}
+
+#else
+
+// Built without io_uring support
+struct IoUringReceiver::Ring {};
+
+IoUringReceiver::IoUringReceiver(size_t buffer_count, size_t buffer_size)
+    : m_buffer_count(std::min(std::bit_ceil(std::max<size_t>(buffer_count, 1)), MAX_RING_BUFFERS)),
+      m_buffer_size(buffer_size) {}
+
+IoUringReceiver::~IoUringReceiver() = default;
+
+bool IoUringReceiver::start(int) {
+    errno = ENOSYS;
+    return false;
+}
+
+int IoUringReceiver::receive(const DatagramHandler&) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int IoUringReceiver::drain(const DatagramHandler&) {
+    errno = ENOSYS;
+    return -1;
+}
+
+bool ioUringSupported() { return false; }
+
+#endif
+
+} // namespace syslogsrv
@@ -0,0 +1,61 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_IO_URING_RECEIVER
+#define INCLUDED_IO_URING_RECEIVER
+
+#include <functional>
+#include <memory>
+#include <string_view>
+
+namespace syslogsrv {
+
+// Receives datagrams through io_uring, using a single multishot `recvmsg` that stays posted against a ring of
+// buffers provided to (and owned by) the kernel. Datagrams are written straight into those buffers, so once the
+// receive is armed there is no per-datagram syscall and no copy into an intermediate buffer.
+//
+// io_uring support is optional and only available when built with WEIR_SYSLOGSRV_IO_URING; otherwise `start()`
+// always fails and callers are expected to fall back to the regular socket receive loop.
+class IoUringReceiver {
+  public:
+    // Called once for every datagram received. The view is only valid for the duration of the call.
+    using DatagramHandler = std::function<void(std::string_view datagram, bool truncated)>;
+
+    // Create a receiver with `buffer_count` buffers (rounded up to a power of two) that can each hold a datagram
+    // of at most `buffer_size` bytes. Nothing is allocated until `start()` is called.
+    IoUringReceiver(size_t buffer_count, size_t buffer_size);
+    ~IoUringReceiver();
+
+    IoUringReceiver(const IoUringReceiver&) = delete;
+    IoUringReceiver& operator=(const IoUringReceiver&) = delete;
+
+    // Set up the ring, register the buffers with the kernel and post the multishot receive against `sock`.
+    // Returns false (with errno set) if io_uring is unavailable or could not be set up.
+    bool start(int sock);
+
+    // Block until at least one datagram has been received, then pass every completed datagram to `handler` and
+    // return the buffers to the kernel. Returns the number of datagrams handled, or -1 on error (with errno set).
+    int receive(const DatagramHandler& handler);
+
+    // Cancel the multishot receive and pass every datagram that it had already received to `handler`, so that none
+    // are lost when we stop. Anything still waiting on the socket stays there. Returns the number of datagrams
+    // handled, or -1 on error (with errno set).
+    int drain(const DatagramHandler& handler);
+
+    size_t bufferCount() const { return m_buffer_count; }
+    size_t bufferSize() const { return m_buffer_size; }
+
+  private:
+    struct Ring;
+
+    size_t m_buffer_count;
+    size_t m_buffer_size;
+    std::unique_ptr<Ring> m_ring;
+};
+
+// Returns true if this build has io_uring support and the running kernel allows us to create a ring
+bool ioUringSupported();
+
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,40 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_LATENCY_TRACE
+#define INCLUDED_LATENCY_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "metrics.h"
+
+namespace syslogsrv {
+
+// HAProxy can stamp a sample of its messages with the time they were sent (see docs/syslog-server-api.md), so that
+// we can measure how long events take to get from HAProxy to redis. The stamps are microseconds on the monotonic
+// clock, so they can only be compared with times taken on the same host.
+
+// The current time in the same form as the stamps on traced messages
+inline int64_t monotonicMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// The seconds elapsed from `from_usec` to `to_usec`, or zero if the clocks they came from disagree on the order
+inline double traceLatencySeconds(int64_t from_usec, int64_t to_usec) {
+    return (to_usec > from_usec) ? static_cast<double>(to_usec - from_usec) / 1e6 : 0.0;
+}
+
+// The buckets for traced latencies: each bound is sqrt(2) times the previous, from 50us to ~50s, so that the
+// recorded latencies are accurate to within a constant ratio however large they are
+inline const std::vector<double> TRACE_LATENCY_BUCKETS = exponentialBuckets(0.00005, 1.4142135623730951, 41);
+
+// The most traced events to track per redis server and flush, so a high sampling rate can't grow memory unboundedly
+constexpr inline size_t MAX_TRACES_PER_FLUSH = 1024;
+
+} // namespace syslogsrv
+
+#endif
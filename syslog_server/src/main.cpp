@@ -2,13 +2,19 @@
 // Distributed under the terms of the Apache 2.0 license.
 
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <spdlog/sinks/hourly_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 #include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "common.h"
+#include "hot_restart.h"
+#include "metrics.h"
+#include "metrics_server.h"
 #include "processor_config.h"
 #include "syslog_server.h"
 
@@ -79,18 +85,81 @@ int main(int argc, char* argv[]) {
 
     logger->info("started the main sysloger server using the cfg file {}", argv[1]);
 
-    // leave one syslog server in the main thread for the convenience of debugging
     int num_of_syslog_servers = 1;
     if (const auto& node = config[syslogsrv::CONFIG_NUM_OF_SYSLOG_SERVERS]) {
         num_of_syslog_servers =
             syslogsrv::yamlAsOrDefault<int>(logger, syslogsrv::CONFIG_NUM_OF_SYSLOG_SERVERS, node, 1);
     }
 
+    // take over the sockets of the syslog server we're replacing, if any, so that no datagram is lost in between
+    const auto handoff_path = syslogsrv::yamlAsOrDefault<std::string>(logger, syslogsrv::CONFIG_HANDOFF_SOCKET,
+                                                                      config[syslogsrv::CONFIG_HANDOFF_SOCKET], "");
+    syslogsrv::HandoffClient handoff_client;
+    std::vector<int> sockets;
+    if (!handoff_path.empty()) {
+        syslogsrv::installWakeupHandler();
+        sockets = handoff_client.requestSockets(handoff_path);
+    }
+    if (sockets.size() > static_cast<size_t>(num_of_syslog_servers)) {
+        // Whatever was waiting on these is lost, so the number of servers shouldn't shrink across a hand-off
+        logger->warn("Took over {} sockets but only {} syslog servers are configured, closing the others",
+                     sockets.size(), num_of_syslog_servers);
+        for (size_t i = num_of_syslog_servers; i < sockets.size(); ++i) {
+            close(sockets[i]);
+        }
+        sockets.resize(num_of_syslog_servers);
+    }
+    syslogsrv::SysCallClass sys_call;
+    while (sockets.size() < static_cast<size_t>(num_of_syslog_servers)) {
+        const int s = syslogsrv::createSocket(config, sys_call); // this is the socket that we listen to.
+        if (s == -1) {
+            logger->error("Failed to create socket");
+            exit(1);
+        }
+        sockets.push_back(s);
+    }
+
+    // serve metrics for the whole process, if enabled
+    syslogsrv::MetricsServer metrics_server(syslogsrv::MetricsRegistry::global());
+    const int metrics_port = syslogsrv::yamlAsOrDefault<int>(logger, syslogsrv::CONFIG_METRICS_PORT,
+                                                             config[syslogsrv::CONFIG_METRICS_PORT],
+                                                             syslogsrv::DEFAULT_METRICS_PORT);
+    if (metrics_port > 0) {
+        metrics_server.start(metrics_port);
+    }
+
+    syslogsrv::ServerStartup startup(num_of_syslog_servers);
     std::vector<std::jthread> servers;
-    for (auto i = 1; i < num_of_syslog_servers; ++i) {
-        servers.push_back(std::jthread(syslogsrv::startSyslogServer, config, i));
+    for (auto i = 0; i < num_of_syslog_servers; ++i) {
+        servers.push_back(std::jthread(syslogsrv::startSyslogServer, config, i, sockets[i], std::ref(startup)));
+    }
+
+    syslogsrv::HandoffListener handoff_listener;
+    if (!handoff_path.empty()) {
+        // Only let the process we took over from stop once every one of its sockets is being received on
+        if (!startup.wait()) {
+            logger->error("Not every syslog server started, leaving the sockets to the server we took over from");
+            for (auto& server : servers) {
+                server.request_stop();
+            }
+            for (auto& server : servers) {
+                server.join();
+            }
+            return 1;
+        }
+        handoff_client.confirm();
+        if (handoff_listener.listen(handoff_path) && handoff_listener.waitForHandoff(sockets)) {
+            // The new process is receiving on our sockets, so flush what we've received and leave it to it
+            for (auto& server : servers) {
+                server.request_stop();
+            }
+        }
     }
 
-    syslogsrv::startSyslogServer(config, 0);
+    // Unless handed over, the servers run forever. Joining explicitly doesn't ask them to stop, unlike destruction.
+    for (auto& server : servers) {
+        server.join();
+    }
+    logger->info("all syslog servers stopped, exiting");
     return 0;
 }
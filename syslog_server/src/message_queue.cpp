@@ -0,0 +1,100 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+#include <cstring>
+
+#include "latency_trace.h"
+#include "message_queue.h"
+#include "redis_sharding.h"
+
+namespace syslogsrv {
+
+struct MessageChunk {
+    explicit MessageChunk(size_t size) : m_data(new char[size]) {}
+
+    std::unique_ptr<char[]> m_data;
+};
+
+MessageQueue::MessageQueue(size_t max_messages, size_t chunk_size)
+    : m_chunk_size(chunk_size), m_messages(max_messages), m_free_chunks(16) {}
+
+MessageQueue::~MessageQueue() = default;
+
+bool MessageQueue::tryEnqueue(std::string_view msg, EventType type) {
+    if (msg.size() > m_chunk_size) {
+        return false;
+    }
+    if ((m_write_chunk == nullptr) || (m_write_offset + msg.size() > m_chunk_size)) {
+        nextChunk();
+    }
+
+    char* dest = m_write_chunk->m_data.get() + m_write_offset;
+    memcpy(dest, msg.data(), msg.size());
+    const int64_t enqueue_usec = m_record_enqueue_times ? monotonicMicros() : 0;
+    if (!m_messages.try_enqueue(
+            QueuedMessage{dest, static_cast<uint32_t>(msg.size()), m_write_chunk, type, enqueue_usec})) {
+        // Nothing references the bytes we just wrote, so they'll simply be overwritten by the next message
+        return false;
+    }
+    m_write_offset += msg.size();
+    return true;
+}
+
+bool MessageQueue::tryDequeue(QueuedMessage& msg) {
+    if (!m_messages.try_dequeue(msg)) {
+        return false;
+    }
+    consumed(msg);
+    return true;
+}
+
+void MessageQueue::consumed(const QueuedMessage& msg) {
+    // Messages are dequeued in the order they were written, so once we see a message from a new chunk the producer
+    // has finished with the previous one and we have finished reading every message in it.
+    if (msg.m_chunk != m_read_chunk) {
+        if (m_read_chunk != nullptr) {
+            m_free_chunks.enqueue(m_read_chunk);
+        }
+        m_read_chunk = msg.m_chunk;
+    }
+}
+
+void MessageQueue::nextChunk() {
+    MessageChunk* chunk = nullptr;
+    if (!m_free_chunks.try_dequeue(chunk)) {
+        m_chunks.push_back(std::make_unique<MessageChunk>(m_chunk_size));
+        chunk = m_chunks.back().get();
+    }
+    m_write_chunk = chunk;
+    m_write_offset = 0;
+}
+
+PartitionedMessageQueue::PartitionedMessageQueue(size_t partition_count, size_t max_messages, size_t chunk_size) {
+    for (size_t i = 0; i < std::max<size_t>(1, partition_count); ++i) {
+        m_partitions.push_back(std::make_unique<MessageQueue>(max_messages, chunk_size));
+    }
+}
+
+MessageQueue& PartitionedMessageQueue::partitionFor(std::string_view user_key) {
+    if (m_partitions.size() == 1) {
+        return *m_partitions.front();
+    }
+    return *m_partitions[fnv1a64(user_key) % m_partitions.size()];
+}
+
+size_t PartitionedMessageQueue::sizeApprox() const {
+    size_t size = 0;
+    for (const auto& partition : m_partitions) {
+        size += partition->sizeApprox();
+    }
+    return size;
+}
+
+void PartitionedMessageQueue::recordEnqueueTimes(bool enabled) {
+    for (auto& partition : m_partitions) {
+        partition->recordEnqueueTimes(enabled);
+    }
+}
+
+} // namespace syslogsrv
@@ -0,0 +1,126 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_MESSAGE_QUEUE
+#define INCLUDED_MESSAGE_QUEUE
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <readerwriterqueue.h>
+#include <string_view>
+#include <vector>
+
+#include "event_classifier.h"
+
+namespace syslogsrv {
+
+constexpr inline size_t DEFAULT_MSG_QUEUE_CHUNK_SIZE = 256 * 1024;
+
+// A block of memory that queued messages are stored in (see MessageQueue)
+struct MessageChunk;
+
+// A message handed from the producer to the consumer. It points into memory owned by the MessageQueue, and
+// remains valid only until the consumer next dequeues from the same queue.
+struct QueuedMessage {
+    const char* m_data = nullptr;
+    uint32_t m_size = 0;
+    MessageChunk* m_chunk = nullptr;
+    EventType m_type = EventType::Unknown;
+    int64_t m_enqueue_usec = 0; // see `MessageQueue::recordEnqueueTimes()`
+
+    std::string_view view() const { return {m_data, m_size}; }
+};
+
+// Single-producer, single-consumer queue of messages that doesn't allocate per message.
+//
+// The producer copies each message into the tail of a fixed-size chunk of memory and enqueues a (pointer, length)
+// descriptor for it. Once the consumer moves on from a chunk (i.e. dequeues a message stored in a different chunk)
+// the chunk goes back on a free list for the producer to reuse. New chunks are only allocated while the queue is
+// warming up, or when the consumer falls behind by more than the chunks allocated so far can hold.
+class MessageQueue {
+  public:
+    // Create a queue that holds at most `max_messages` messages, stored in chunks of `chunk_size` bytes.
+    // Messages longer than `chunk_size` can't be queued.
+    explicit MessageQueue(size_t max_messages, size_t chunk_size = DEFAULT_MSG_QUEUE_CHUNK_SIZE);
+    ~MessageQueue();
+
+    MessageQueue(const MessageQueue&) = delete;
+    MessageQueue& operator=(const MessageQueue&) = delete;
+
+    // Producer: copy `msg`, an event of the given `type`, into the queue. Returns false, leaving the queue unchanged, if the queue is full or the
+    // message is longer than `maxMessageSize()`.
+    bool tryEnqueue(std::string_view msg, EventType type);
+
+    // Consumer: dequeue the next message, if there is one. Dequeuing invalidates the previously dequeued message.
+    bool tryDequeue(QueuedMessage& msg);
+
+    // Consumer: as for `tryDequeue()`, but wait up to `timeout` for a message to arrive.
+    template <typename Rep, typename Period>
+    bool waitDequeueTimed(QueuedMessage& msg, std::chrono::duration<Rep, Period> timeout) {
+        if (!m_messages.wait_dequeue_timed(msg, timeout)) {
+            return false;
+        }
+        consumed(msg);
+        return true;
+    }
+
+    size_t sizeApprox() const { return m_messages.size_approx(); }
+    size_t maxMessageSize() const { return m_chunk_size; }
+
+    // Stamp each message with the time it was enqueued, as given by `monotonicMicros()`, for latency tracing.
+    // Must be set before the producer starts.
+    void recordEnqueueTimes(bool enabled) { m_record_enqueue_times = enabled; }
+
+    // The number of chunks allocated so far, whether in use or on the free list
+    size_t chunkCount() const { return m_chunks.size(); }
+
+  private:
+    // Consumer: release the chunk of the previously dequeued message if `msg` is in a different one
+    void consumed(const QueuedMessage& msg);
+
+    // Producer: switch to a chunk with enough room for a message, reusing a free one if possible
+    void nextChunk();
+
+    size_t m_chunk_size;
+    bool m_record_enqueue_times = false;
+    moodycamel::BlockingReaderWriterQueue<QueuedMessage> m_messages;
+    moodycamel::BlockingReaderWriterQueue<MessageChunk*> m_free_chunks;
+
+    // producer state
+    std::vector<std::unique_ptr<MessageChunk>> m_chunks;
+    MessageChunk* m_write_chunk = nullptr;
+    size_t m_write_offset = 0;
+
+    // consumer state
+    MessageChunk* m_read_chunk = nullptr;
+};
+
+// Fans the messages of one producer out to several MessageQueues, each drained by its own consumer.
+// All the events of a user go to the same queue, so each consumer can aggregate the stats of its users on its own.
+class PartitionedMessageQueue {
+  public:
+    // Create `partition_count` queues (at least one), each as constructed by `MessageQueue(max_messages, chunk_size)`
+    PartitionedMessageQueue(size_t partition_count, size_t max_messages,
+                            size_t chunk_size = DEFAULT_MSG_QUEUE_CHUNK_SIZE);
+
+    size_t partitionCount() const { return m_partitions.size(); }
+    MessageQueue& partition(size_t index) { return *m_partitions[index]; }
+
+    // The queue for the events of the given user
+    MessageQueue& partitionFor(std::string_view user_key);
+
+    // The total number of messages across all the queues
+    size_t sizeApprox() const;
+    size_t maxMessageSize() const { return m_partitions.front()->maxMessageSize(); }
+
+    // As for `MessageQueue::recordEnqueueTimes()`, on all the queues
+    void recordEnqueueTimes(bool enabled);
+
+  private:
+    std::vector<std::unique_ptr<MessageQueue>> m_partitions;
+};
+
+} // namespace syslogsrv
+
+#endif
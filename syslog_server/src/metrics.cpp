@@ -0,0 +1,172 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+#include <iterator>
+#include <spdlog/fmt/bundled/format.h>
+#include <stdexcept>
+
+#include "metrics.h"
+
+namespace syslogsrv {
+
+namespace {
+
+// `name{labels,extra_label}` or just `name{extra_label}`/`name` where there are no labels
+void appendSampleName(std::string& out, std::string_view name, std::string_view labels,
+                      std::string_view extra_label = {}) {
+    out.append(name);
+    if (labels.empty() && extra_label.empty()) {
+        return;
+    }
+    out.push_back('{');
+    out.append(labels);
+    if (!labels.empty() && !extra_label.empty()) {
+        out.push_back(',');
+    }
+    out.append(extra_label);
+    out.push_back('}');
+}
+
+std::string formatLabels(const MetricLabels& labels) {
+    std::string formatted;
+    for (const auto& [name, value] : labels) {
+        if (!formatted.empty()) {
+            formatted.push_back(',');
+        }
+        formatted.append(name);
+        formatted.append("=\"");
+        for (const char c : value) {
+            switch (c) {
+            case '\\':
+                formatted.append("\\\\");
+                break;
+            case '"':
+                formatted.append("\\\"");
+                break;
+            case '\n':
+                formatted.append("\\n");
+                break;
+            default:
+                formatted.push_back(c);
+                break;
+            }
+        }
+        formatted.push_back('"');
+    }
+    return formatted;
+}
+
+template <typename MetricType, typename... Args>
+MetricType& findOrAdd(std::map<std::string, std::unique_ptr<Metric>>& metrics, const MetricLabels& labels,
+                      Args&&... args) {
+    auto& metric = metrics[formatLabels(labels)];
+    if (!metric) {
+        metric = std::make_unique<MetricType>(std::forward<Args>(args)...);
+    }
+    return static_cast<MetricType&>(*metric);
+}
+
+} // namespace
+
+std::vector<double> exponentialBuckets(double start, double factor, size_t count) {
+    std::vector<double> bounds;
+    bounds.reserve(count);
+    for (double bound = start; bounds.size() < count; bound *= factor) {
+        bounds.push_back(bound);
+    }
+    return bounds;
+}
+
+void Counter::render(std::string& out, std::string_view name, std::string_view labels) const {
+    appendSampleName(out, name, labels);
+    fmt::v10::format_to(std::back_inserter(out), " {}\n", value());
+}
+
+void Gauge::render(std::string& out, std::string_view name, std::string_view labels) const {
+    appendSampleName(out, name, labels);
+    fmt::v10::format_to(std::back_inserter(out), " {}\n", value());
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : m_bounds(std::move(bounds)), m_bucket_counts(new std::atomic<uint64_t>[m_bounds.size()]) {
+    for (size_t i = 0; i < m_bounds.size(); ++i) {
+        m_bucket_counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    const size_t bucket = std::lower_bound(m_bounds.begin(), m_bounds.end(), value) - m_bounds.begin();
+    if (bucket < m_bounds.size()) {
+        m_bucket_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Histogram::render(std::string& out, std::string_view name, std::string_view labels) const {
+    const std::string bucket_name = std::string(name) + "_bucket";
+    uint64_t cumulative_count = 0;
+    for (size_t i = 0; i < m_bounds.size(); ++i) {
+        cumulative_count += m_bucket_counts[i].load(std::memory_order_relaxed);
+        appendSampleName(out, bucket_name, labels, fmt::v10::format("le=\"{}\"", m_bounds[i]));
+        fmt::v10::format_to(std::back_inserter(out), " {}\n", cumulative_count);
+    }
+    // An observation updates the buckets and the total separately, so a concurrent one may be counted in the buckets
+    // but not yet in the total. The total must never be below the buckets.
+    const uint64_t total_count = std::max(count(), cumulative_count);
+    appendSampleName(out, bucket_name, labels, "le=\"+Inf\"");
+    fmt::v10::format_to(std::back_inserter(out), " {}\n", total_count);
+
+    appendSampleName(out, std::string(name) + "_sum", labels);
+    fmt::v10::format_to(std::back_inserter(out), " {}\n", sum());
+    appendSampleName(out, std::string(name) + "_count", labels);
+    fmt::v10::format_to(std::back_inserter(out), " {}\n", total_count);
+}
+
+MetricsRegistry& MetricsRegistry::global() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Family& MetricsRegistry::family(std::string_view name, std::string_view help, std::string_view type) {
+    auto it = m_families.find(name);
+    if (it == m_families.end()) {
+        it = m_families.emplace(std::string(name), Family{std::string(help), std::string(type), {}}).first;
+    } else if (it->second.m_type != type) {
+        throw std::invalid_argument(
+            fmt::v10::format("metric {} is already registered as a {}, not a {}", name, it->second.m_type, type));
+    }
+    return it->second;
+}
+
+Counter& MetricsRegistry::counter(std::string_view name, std::string_view help, const MetricLabels& labels) {
+    std::lock_guard lock(m_mutex);
+    return findOrAdd<Counter>(family(name, help, "counter").m_metrics, labels);
+}
+
+Gauge& MetricsRegistry::gauge(std::string_view name, std::string_view help, const MetricLabels& labels) {
+    std::lock_guard lock(m_mutex);
+    return findOrAdd<Gauge>(family(name, help, "gauge").m_metrics, labels);
+}
+
+Histogram& MetricsRegistry::histogram(std::string_view name, std::string_view help, const std::vector<double>& bounds,
+                                      const MetricLabels& labels) {
+    std::lock_guard lock(m_mutex);
+    return findOrAdd<Histogram>(family(name, help, "histogram").m_metrics, labels, bounds);
+}
+
+std::string MetricsRegistry::render() const {
+    std::lock_guard lock(m_mutex);
+    std::string out;
+    for (const auto& [name, family] : m_families) {
+        fmt::v10::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, family.m_help, name,
+                            family.m_type);
+        for (const auto& [labels, metric] : family.m_metrics) {
+            metric->render(out, name, labels);
+        }
+    }
+    return out;
+}
+
+} // namespace syslogsrv
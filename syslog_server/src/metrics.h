@@ -0,0 +1,125 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_METRICS
+#define INCLUDED_METRICS
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace syslogsrv {
+
+// Label names and values identifying one metric of a family, e.g. {{"worker", "0"}}
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// The buckets (upper bounds, in seconds) used for latency histograms, from 100us to 10s
+inline const std::vector<double> LATENCY_BUCKETS = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+                                                    0.025,  0.05,    0.1,    0.25,  0.5,    1,     2.5,
+                                                    5,      10};
+
+// `count` bucket bounds starting at `start`, each `factor` times the previous
+std::vector<double> exponentialBuckets(double start, double factor, size_t count);
+
+// The metric types below are updated with relaxed atomics, so that any thread can update them without locking and
+// they can be read (e.g. by the metrics endpoint) at any time.
+
+class Metric {
+  public:
+    virtual ~Metric() = default;
+
+    // Append this metric's samples to `out` in the Prometheus text exposition format. `labels` is either empty or
+    // the metric's formatted labels, e.g. `worker="0",consumer="1"`.
+    virtual void render(std::string& out, std::string_view name, std::string_view labels) const = 0;
+};
+
+// A count that only goes up
+class Counter : public Metric {
+  public:
+    void add(uint64_t delta = 1) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+
+    // For counts maintained elsewhere by a single thread, publish their latest value
+    void set(uint64_t value) { m_value.store(value, std::memory_order_relaxed); }
+
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    void render(std::string& out, std::string_view name, std::string_view labels) const override;
+
+  private:
+    std::atomic<uint64_t> m_value = 0;
+};
+
+// A value that can go up and down, e.g. a queue depth
+class Gauge : public Metric {
+  public:
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    void render(std::string& out, std::string_view name, std::string_view labels) const override;
+
+  private:
+    std::atomic<int64_t> m_value = 0;
+};
+
+// The distribution of observed values across fixed buckets, e.g. of latencies in seconds
+class Histogram : public Metric {
+  public:
+    // `bounds` are the buckets' upper bounds, in increasing order. Values above the last bound are only counted in
+    // the implicit "+Inf" bucket.
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    double sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+    void render(std::string& out, std::string_view name, std::string_view labels) const override;
+
+  private:
+    std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_bucket_counts; // not cumulative, one per bound
+    std::atomic<uint64_t> m_count = 0;
+    std::atomic<double> m_sum = 0;
+};
+
+// The set of metrics exposed by the process, grouped into families that share a name and differ by their labels.
+//
+// Metrics are created on first use and live as long as the registry, so callers should look them up once and keep
+// the returned reference rather than looking them up for every update. Looking up a name that is already
+// registered with a different type throws std::invalid_argument.
+class MetricsRegistry {
+  public:
+    // The registry served by the metrics endpoint
+    static MetricsRegistry& global();
+
+    Counter& counter(std::string_view name, std::string_view help, const MetricLabels& labels = {});
+    Gauge& gauge(std::string_view name, std::string_view help, const MetricLabels& labels = {});
+    Histogram& histogram(std::string_view name, std::string_view help, const std::vector<double>& bounds,
+                         const MetricLabels& labels = {});
+
+    // All the metrics in the Prometheus text exposition format
+    std::string render() const;
+
+  private:
+    struct Family {
+        std::string m_help;
+        std::string m_type; // "counter", "gauge" or "histogram"
+        std::map<std::string, std::unique_ptr<Metric>> m_metrics; // by formatted labels
+    };
+
+    // Returns the family called `name`, creating it if necessary. Must be called with `m_mutex` held.
+    Family& family(std::string_view name, std::string_view help, std::string_view type);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Family, std::less<>> m_families;
+};
+
+} // namespace syslogsrv
+
+#endif
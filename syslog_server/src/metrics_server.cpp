@@ -0,0 +1,138 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <spdlog/fmt/bundled/format.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "metrics_server.h"
+
+namespace syslogsrv {
+
+namespace {
+
+// How long the serving thread waits for a connection before checking whether it should stop
+constexpr int ACCEPT_POLL_MSEC = 200;
+
+// The most we read of a request, more than enough for the request line and headers of a scrape
+constexpr size_t MAX_REQUEST_SIZE = 8 * 1024;
+
+std::string httpResponse(std::string_view status, std::string_view content_type, std::string_view body) {
+    return fmt::v10::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+                            status, content_type, body.size(), body);
+}
+
+} // namespace
+
+std::string metricsHttpResponse(std::string_view request_line, const MetricsRegistry& registry) {
+    // e.g. "GET /metrics HTTP/1.1", where the path may have a query string
+    const size_t method_end = request_line.find(' ');
+    const std::string_view method = request_line.substr(0, method_end);
+    std::string_view path =
+        (method_end == std::string_view::npos) ? std::string_view{} : request_line.substr(method_end + 1);
+    path = path.substr(0, path.find(' '));
+    path = path.substr(0, path.find('?'));
+
+    if (method != "GET" || path != "/metrics") {
+        return httpResponse("404 Not Found", "text/plain", "not found\n");
+    }
+    return httpResponse("200 OK", "text/plain; version=0.0.4", registry.render());
+}
+
+MetricsServer::MetricsServer(const MetricsRegistry& registry) : m_registry(registry) {}
+
+MetricsServer::~MetricsServer() {
+    if (m_thread.joinable()) {
+        m_thread.request_stop();
+        m_thread.join();
+    }
+    if (m_listen_fd != -1) {
+        ::close(m_listen_fd);
+    }
+}
+
+bool MetricsServer::start(int port) {
+    auto logger = spdlog::get(SERVER_NAME);
+
+    m_listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listen_fd == -1) {
+        logger->error("Can't create metrics socket: {}", strerror(errno));
+        return false;
+    }
+    int reuse = 1;
+    ::setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    // A process taking over from us through a hand-off (see hot_restart.h) listens on the same port before we exit
+    ::setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    socklen_t addr_len = sizeof(addr);
+    if (::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 ||
+        ::listen(m_listen_fd, 16) == -1 ||
+        ::getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len) == -1) {
+        logger->error("Can't listen for metrics requests on port {}: {}", port, strerror(errno));
+        ::close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+    m_port = ntohs(addr.sin_port);
+
+    logger->info("serving metrics on port {}", m_port);
+    m_thread = std::jthread([this](std::stop_token stop) { serve(stop); });
+    return true;
+}
+
+void MetricsServer::serve(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+        pollfd listen_poll = {m_listen_fd, POLLIN, 0};
+        if (::poll(&listen_poll, 1, ACCEPT_POLL_MSEC) <= 0) {
+            continue;
+        }
+        const int fd = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) {
+            continue;
+        }
+        handleConnection(fd);
+        ::close(fd);
+    }
+}
+
+void MetricsServer::handleConnection(int fd) {
+    // Don't let a client that never finishes its request block the next scrape for long
+    timeval timeout = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Read the headers as well as the request line: closing the connection with unread data would reset it, which
+    // may discard our response before the client has read it
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+        const ssize_t len = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (len <= 0) {
+            return;
+        }
+        request.append(buffer, len);
+    }
+
+    const std::string response = metricsHttpResponse(request.substr(0, request.find("\r\n")), m_registry);
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const ssize_t len = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (len <= 0) {
+            return;
+        }
+        sent += len;
+    }
+}
+
+} // namespace syslogsrv
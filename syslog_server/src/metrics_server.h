@@ -0,0 +1,47 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_METRICS_SERVER
+#define INCLUDED_METRICS_SERVER
+
+#include <string_view>
+#include <thread>
+
+#include "metrics.h"
+
+namespace syslogsrv {
+
+// Serves the metrics of a registry over HTTP for Prometheus to scrape: `GET /metrics` returns all of them in the
+// text exposition format, and any other request gets a 404. Requests are handled one at a time on a dedicated
+// thread, which is plenty for a scraper polling every few seconds.
+class MetricsServer {
+  public:
+    explicit MetricsServer(const MetricsRegistry& registry);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // Listen on `port` on all interfaces (or on any free port if 0) and start serving.
+    // Returns false, having logged why, if the port can't be listened on.
+    bool start(int port);
+
+    // The port being listened on, once started
+    int port() const { return m_port; }
+
+  private:
+    void serve(std::stop_token stop);
+    void handleConnection(int fd);
+
+    const MetricsRegistry& m_registry;
+    int m_listen_fd = -1;
+    int m_port = 0;
+    std::jthread m_thread;
+};
+
+// The response to an HTTP request for the metrics endpoint, given the request line (e.g. "GET /metrics HTTP/1.1")
+std::string metricsHttpResponse(std::string_view request_line, const MetricsRegistry& registry);
+
+} // namespace syslogsrv
+
+#endif
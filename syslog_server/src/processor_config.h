@@ -9,25 +9,57 @@ namespace syslogsrv {
 // default values
 constexpr inline int DEFAULT_METRICS_BATCHING_COUNT = 250000;
 constexpr inline int DEFAULT_METRICS_BATCHING_MSEC_PERIOD = 31;
+constexpr inline int DEFAULT_METRICS_BATCHING_MAX_MSEC_PERIOD = 250;
 constexpr inline int DEFAULT_REDIS_QOS_TTL = 2;
 constexpr inline int DEFAULT_REDIS_QOS_CONN_TTL = 60;
 constexpr inline int DEFAULT_CHECK_CONN_INTERVAL_SECS = 5;
 constexpr inline int DEFAULT_MSG_QUEUE_SIZE = 1024;
+constexpr inline int DEFAULT_CONSUMERS_PER_SERVER = 1;
+constexpr inline bool DEFAULT_SOCKET_INCOMING_CPU = false;
+constexpr inline int DEFAULT_METRICS_PORT = 0;
+constexpr inline bool DEFAULT_LATENCY_TRACING = false;
+constexpr inline int DEFAULT_INTERN_IDLE_FLUSH_PERIODS = 1000;
+constexpr inline int DEFAULT_RECV_BATCH_SIZE = 1;
+constexpr inline int DEFAULT_RECV_BUFFER_SIZE = 64 * 1024;
+constexpr inline int DEFAULT_RECV_RING_SIZE = 256;
+constexpr inline bool DEFAULT_REDIS_SCRIPTED_UPDATES = false;
+constexpr inline int DEFAULT_REDIS_MAX_PENDING_REPLIES = 500000;
+constexpr inline int DEFAULT_SHUTDOWN_FLUSH_TIMEOUT_MSEC = 5000;
 
 // message processor configuration options
 constexpr inline char CONFIG_ACCESS_LOG_FILE_NAME[] = "access_log_file_name";
+constexpr inline char CONFIG_CONSUMERS_PER_SERVER[] = "consumers_per_server";
+constexpr inline char CONFIG_CPU_AFFINITY[] = "cpu_affinity";
 constexpr inline char CONFIG_ENDPOINT[] = "endpoint";
+constexpr inline char CONFIG_HANDOFF_SOCKET[] = "handoff_socket";
+constexpr inline char CONFIG_INTERN_IDLE_FLUSH_PERIODS[] = "intern_idle_flush_periods";
+constexpr inline char CONFIG_LATENCY_TRACING[] = "latency_tracing";
 constexpr inline char CONFIG_LOG_FILE_NAME[] = "log_file_name";
 constexpr inline char CONFIG_LOG_LEVEL[] = "log_level";
 constexpr inline char CONFIG_MSG_QUEUE_SIZE[] = "msg_queue_size";
+constexpr inline char CONFIG_RECV_BATCH_SIZE[] = "recv_batch_size";
+constexpr inline char CONFIG_RECV_BUFFER_SIZE[] = "recv_buffer_size";
+constexpr inline char CONFIG_RECV_BACKEND[] = "recv_backend";
+constexpr inline char CONFIG_RECV_RING_SIZE[] = "recv_ring_size";
+constexpr inline char CONFIG_SOCKET_INCOMING_CPU[] = "socket_incoming_cpu";
 constexpr inline char CONFIG_METRICS_BATCH_COUNT[] = "metrics_batch_count";
 constexpr inline char CONFIG_METRICS_BATCH_PERIOD_MSEC[] = "metrics_batch_period_msec";
+constexpr inline char CONFIG_METRICS_BATCH_MAX_PERIOD_MSEC[] = "metrics_batch_max_period_msec";
+constexpr inline char CONFIG_METRICS_PORT[] = "metrics_port";
 constexpr inline char CONFIG_NUM_OF_SYSLOG_SERVERS[] = "num_of_syslog_servers";
 constexpr inline char CONFIG_PORT[] = "port";
 constexpr inline char CONFIG_REDIS_QOS_TTL[] = "redis_qos_ttl";
 constexpr inline char CONFIG_REDIS_QOS_CONN_TTL[] = "redis_qos_conn_ttl";
 constexpr inline char CONFIG_REDIS_CHECK_CONN_INTERVAL_SEC[] = "redis_check_conn_interval_sec";
+constexpr inline char CONFIG_REDIS_MAX_PENDING_REPLIES[] = "redis_max_pending_replies";
+constexpr inline char CONFIG_REDIS_SCRIPTED_UPDATES[] = "redis_scripted_updates";
 constexpr inline char CONFIG_REDIS_SERVER[] = "redis_server";
+constexpr inline char CONFIG_REDIS_SERVERS[] = "redis_servers";
+constexpr inline char CONFIG_SHUTDOWN_FLUSH_TIMEOUT_MSEC[] = "shutdown_flush_timeout_msec";
+
+// values for CONFIG_RECV_BACKEND
+constexpr inline char RECV_BACKEND_SOCKET[] = "socket";
+constexpr inline char RECV_BACKEND_IO_URING[] = "io_uring";
 
 } // namespace syslogsrv
 
@@ -0,0 +1,44 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+#include <cassert>
+
+#include "recv_batch.h"
+
+namespace syslogsrv {
+
+RecvBatch::RecvBatch(size_t batch_size, size_t slot_size)
+    : m_slot_size(slot_size), m_buffer(new char[batch_size * slot_size]()), m_iovecs(batch_size),
+      m_headers(batch_size) {
+    // The iovecs & headers point into our buffer and are never modified by the kernel, so we only need to set them
+    // up once. The kernel writes only the `msg_len` and `msg_hdr.msg_flags` fields on each call to `recvmmsg`.
+    for (size_t i = 0; i < batch_size; ++i) {
+        m_iovecs[i].iov_base = m_buffer.get() + (i * slot_size);
+        m_iovecs[i].iov_len = slot_size;
+
+        m_headers[i] = {};
+        m_headers[i].msg_hdr.msg_iov = &m_iovecs[i];
+        m_headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+int RecvBatch::receive(int sock, SystemInterface& sys_call) {
+    // MSG_WAITFORONE makes the call block only until the first datagram arrives, after which it returns with
+    // however many datagrams were already queued on the socket. This gives us large batches when traffic is heavy
+    // without adding any latency when it is light.
+    return sys_call.recvmmsg(sock, m_headers.data(), m_headers.size(), MSG_WAITFORONE, nullptr);
+}
+
+std::string_view RecvBatch::datagram(size_t index) const {
+    assert(index < m_headers.size());
+    const size_t len = std::min<size_t>(m_headers[index].msg_len, m_slot_size);
+    return {static_cast<const char*>(m_iovecs[index].iov_base), len};
+}
+
+bool RecvBatch::truncated(size_t index) const {
+    assert(index < m_headers.size());
+    return (m_headers[index].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+}
+
+} // namespace syslogsrv
@@ -0,0 +1,50 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_RECV_BATCH
+#define INCLUDED_RECV_BATCH
+
+#include <memory>
+#include <string_view>
+#include <sys/socket.h>
+#include <vector>
+
+#include "syscall_wrapper.h"
+
+namespace syslogsrv {
+
+// A reusable pool of fixed-size receive buffers, used to receive many datagrams with a single call to `recvmmsg`.
+// Every slot in the batch has its own buffer, so the datagrams returned for one call to `receive()` all remain
+// valid until the next call to `receive()` (or until the batch is destroyed).
+class RecvBatch {
+  public:
+    // Create a batch that can receive up to `batch_size` datagrams of at most `slot_size` bytes each.
+    RecvBatch(size_t batch_size, size_t slot_size);
+
+    RecvBatch(const RecvBatch&) = delete;
+    RecvBatch& operator=(const RecvBatch&) = delete;
+
+    // Block until at least one datagram is available on `sock`, then receive as many datagrams as are immediately
+    // available, up to the size of the batch. Returns the number of datagrams received, or -1 on error (with errno
+    // set by the underlying `recvmmsg` call).
+    int receive(int sock, SystemInterface& sys_call);
+
+    // Returns the datagram received into slot `index` by the most recent call to `receive()`
+    std::string_view datagram(size_t index) const;
+
+    // Returns true if the datagram in slot `index` was larger than the slot and so was truncated on receipt
+    bool truncated(size_t index) const;
+
+    size_t batchSize() const { return m_headers.size(); }
+    size_t slotSize() const { return m_slot_size; }
+
+  private:
+    size_t m_slot_size;
+    std::unique_ptr<char[]> m_buffer;
+    std::vector<iovec> m_iovecs;
+    std::vector<mmsghdr> m_headers;
+};
+
+} // namespace syslogsrv
+
+#endif
@@ -0,0 +1,74 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <charconv>
+
+#include "redis_key_cache.h"
+
+namespace syslogsrv {
+
+RedisKeyCache::RedisKeyCache(const StringInterner& interner) : m_interner(interner) {}
+
+void RedisKeyCache::setEndpoint(std::string_view endpoint) {
+    m_endpoint = endpoint;
+    clear();
+}
+
+const std::string& RedisKeyCache::userSuffix(StringInterner::Id user) {
+    if (user >= m_user_suffixes.size()) {
+        m_user_suffixes.resize(user + 1);
+    }
+    std::string& suffix = m_user_suffixes[user];
+    if (suffix.empty()) {
+        // Delimiter between the entity key and the endpoint should be a random charater that is invalid in all ips,
+        // access keys and bucket names. We choose "$" here.
+        suffix.append(m_interner.lookup(user));
+        suffix.push_back('$');
+        suffix.append(m_endpoint);
+    }
+    return suffix;
+}
+
+void RedisKeyCache::buildVerbKey(std::string& key, uint32_t epoch_secs, StringInterner::Id user) {
+    char secs[16];
+    const auto secs_end = std::to_chars(std::begin(secs), std::end(secs), epoch_secs).ptr;
+
+    key.assign("verb_");
+    key.append(secs, secs_end);
+    key.append("_user_");
+    key.append(userSuffix(user));
+}
+
+void RedisKeyCache::buildActiveRequestsKey(std::string& key, Direction direction, StringInterner::Id instance,
+                                           StringInterner::Id user) {
+    if (instance >= m_instance_prefixes.size()) {
+        m_instance_prefixes.resize(instance + 1);
+    }
+    std::string& prefix = m_instance_prefixes[instance][(direction == Direction::Up) ? 0 : 1];
+    if (prefix.empty()) {
+        prefix.append("conn_v2_user_");
+        prefix.append(directionName(direction));
+        prefix.push_back('_');
+        prefix.append(m_interner.lookup(instance));
+        prefix.push_back('_');
+    }
+
+    key.assign(prefix);
+    key.append(userSuffix(user));
+}
+
+void RedisKeyCache::forget(StringInterner::Id id) {
+    if (id < m_user_suffixes.size()) {
+        m_user_suffixes[id].clear();
+    }
+    if (id < m_instance_prefixes.size()) {
+        m_instance_prefixes[id] = {};
+    }
+}
+
+void RedisKeyCache::clear() {
+    m_user_suffixes.clear();
+    m_instance_prefixes.clear();
+}
+
+} // namespace syslogsrv
@@ -0,0 +1,29 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include "redis_sharding.h"
+
+namespace syslogsrv {
+
+uint64_t fnv1a64(std::string_view value) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : value) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+size_t jumpConsistentHash(uint64_t key, size_t bucket_count) {
+    int64_t bucket = -1;
+    int64_t next = 0;
+    while (next < static_cast<int64_t>(bucket_count)) {
+        bucket = next;
+        key = key * 2862933555777941757ULL + 1;
+        next = static_cast<int64_t>((bucket + 1) * (static_cast<double>(1LL << 31) /
+                                                     static_cast<double>((key >> 33) + 1)));
+    }
+    return static_cast<size_t>(bucket);
+}
+
+} // namespace syslogsrv
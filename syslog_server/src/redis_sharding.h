@@ -0,0 +1,29 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_REDIS_SHARDING
+#define INCLUDED_REDIS_SHARDING
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace syslogsrv {
+
+// 64-bit FNV-1a hash of `value`. Stable across platforms and builds, unlike std::hash, so other components
+// (e.g. polygen) can compute the same value.
+uint64_t fnv1a64(std::string_view value);
+
+// Jump consistent hash (Lamping & Veach, https://arxiv.org/abs/1406.2294): maps `key` to a bucket in
+// [0, bucket_count). Growing the number of buckets from n to n+1 only moves ~1/(n+1) of the keys, all of them to
+// the new bucket.
+size_t jumpConsistentHash(uint64_t key, size_t bucket_count);
+
+// The index of the redis shard, out of `shard_count`, that holds all the stats of `user`
+inline size_t shardForUser(std::string_view user, size_t shard_count) {
+    return (shard_count <= 1) ? 0 : jumpConsistentHash(fnv1a64(user), shard_count);
+}
+
+} // namespace syslogsrv
+
+#endif
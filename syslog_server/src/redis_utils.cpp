@@ -21,10 +21,47 @@
 #endif
 
 #include "common.h"
+#include "latency_trace.h"
 #include "redis_utils.h"
 
 namespace syslogsrv {
 
+namespace {
+
+// The privdata of the commands that call the script with EVALSHA, so that their replies can be told apart
+char SCRIPT_CALL = 0;
+
+constexpr std::string_view EVALSHA_ARG = "$7\r\nevalsha\r\n";
+
+// The serialized command `cmd` without its leading "*<arg count>\r\n"
+std::string_view commandArgs(std::string_view cmd) {
+    const size_t header_end = cmd.find("\r\n");
+    return (header_end == std::string_view::npos) ? std::string_view() : cmd.substr(header_end + 2);
+}
+
+bool isScriptCall(std::string_view cmd) { return commandArgs(cmd).starts_with(EVALSHA_ARG); }
+
+// Turn the serialized `evalsha <sha> <args...>` command `cmd` into `eval <script> <args...>`. The number of arguments
+// stays the same, so only the first two need replacing.
+std::string evalCommand(std::string_view cmd, std::string_view script) {
+    const std::string_view args = commandArgs(cmd);
+    std::string_view sha_and_rest = args.substr(EVALSHA_ARG.size());
+    const size_t sha_len_end = sha_and_rest.find("\r\n");
+    const size_t sha_len = std::stoul(std::string(sha_and_rest.substr(1, sha_len_end - 1)));
+    const std::string_view rest = sha_and_rest.substr(sha_len_end + 2 + sha_len + 2);
+
+    std::string eval(cmd.substr(0, cmd.size() - args.size()));
+    eval += "$4\r\neval\r\n$";
+    eval += std::to_string(script.size());
+    eval += "\r\n";
+    eval += script;
+    eval += "\r\n";
+    eval += rest;
+    return eval;
+}
+
+} // namespace
+
 std::string NetClass::getIpAddressBySockAddr(const sockaddr* const saddr) {
     if (!saddr) {
         return "";
@@ -66,6 +103,11 @@ int NetClass::redisAsyncCommand(redisAsyncContext* ac, redisCallbackFn* fn, void
     return ::redisAsyncCommand(ac, fn, privdata, format);
 }
 
+int NetClass::redisAsyncFormattedCommand(redisAsyncContext* ac, redisCallbackFn* fn, void* privdata, const char* cmd,
+                                         size_t len) {
+    return ::redisAsyncFormattedCommand(ac, fn, privdata, cmd, len);
+}
+
 void NetClass::redisAsyncFree(redisAsyncContext* ac) {
     // This check isn't necessary from hiredis v1.1.0 onwards but
     // for compatibility with older versions we keep it here for now.
@@ -74,7 +116,25 @@ void NetClass::redisAsyncFree(redisAsyncContext* ac) {
     }
 }
 
-RedisServerConnection::RedisServerConnection(std::string host_addr, int host_port, std::unique_ptr<NetInterface> net)
+RedisServerConnection::Metrics::Metrics(MetricsRegistry& registry, const MetricLabels& labels)
+    : m_sent(registry.counter("weir_redis_commands_sent_total", "Commands submitted to redis", labels)),
+      m_sent_failures(registry.counter("weir_redis_command_send_failures_total",
+                                       "Commands that couldn't be submitted to redis", labels)),
+      m_recv(registry.counter("weir_redis_replies_total", "Replies received from redis", labels)),
+      m_recv_failures(registry.counter("weir_redis_reply_errors_total", "Error or missing replies from redis", labels)),
+      m_conn_drops(registry.counter("weir_redis_connection_drops_total", "Connections to redis lost", labels)),
+      m_reconnects(registry.counter("weir_redis_reconnects_total",
+                                    "Reconnects to redis because its address changed", labels)),
+      m_pending_replies(
+          registry.gauge("weir_redis_pending_replies", "Commands sent to redis still awaiting a reply", labels)),
+      m_batch_reply_time(registry.histogram("weir_redis_batch_reply_seconds",
+                                            "Time from sending a batch of commands to redis until its last reply",
+                                            LATENCY_BUCKETS, labels)),
+      m_trace_ack_latency(registry.histogram("weir_redis_trace_ack_latency_seconds",
+                                             "Time from HAProxy sending a traced event until redis acknowledged it",
+                                             TRACE_LATENCY_BUCKETS, labels)) {}
+
+RedisServerConnection::RedisServerConnection(std::string host_addr, int host_port, std::shared_ptr<NetInterface> net)
     : m_redis_addr(std::move(host_addr)), m_redis_port(host_port), m_redis_net(std::move(net)) {
 
     m_conn_id = "QoS(" + m_redis_addr + ":" + std::to_string(m_redis_port) + ")";
@@ -84,7 +144,7 @@ RedisServerConnection::RedisServerConnection(std::string host_addr, int host_por
         m_logger = spdlog::default_logger();
     }
     if (!m_redis_net) {
-        m_redis_net = std::make_unique<NetClass>();
+        m_redis_net = std::make_shared<NetClass>();
     }
 }
 
@@ -214,6 +274,15 @@ void RedisServerConnection::connectCallback(const redisAsyncContext* c, int stat
     rsc->m_connection_status = RedisConnectionState::CONNECTED;
 
     rsc->m_logger->info("connected to {} with IP addr {}", rsc->m_conn_id, rsc->m_redis_ip);
+
+    // Anything sent on a previous connection has been answered (or failed) by now
+    rsc->m_inflight_batches.clear();
+    rsc->m_script_calls.clear();
+
+    // We may have connected to a different server, which doesn't have the script yet
+    rsc->m_script_sha.clear();
+    rsc->m_script_load_pending = false;
+    rsc->loadScript();
 }
 
 void RedisServerConnection::disconnectCallback(const redisAsyncContext* c, int status) {
@@ -240,6 +309,14 @@ void RedisServerConnection::replyCallback(redisAsyncContext* c, void* r, void* p
     RedisServerConnection* rsc = static_cast<RedisServerConnection*>(c->data);
 
     ++rsc->m_total_recv_cnt;
+    rsc->recordReply();
+
+    // Replies come in the order the commands were sent, so this is the reply to the oldest script call
+    std::string script_call;
+    if (privdata == &SCRIPT_CALL && !rsc->m_script_calls.empty()) {
+        script_call = std::move(rsc->m_script_calls.front());
+        rsc->m_script_calls.pop_front();
+    }
 
     redisReply* reply = static_cast<redisReply*>(r);
     if (reply == nullptr || reply->type == REDIS_REPLY_ERROR) {
@@ -247,9 +324,85 @@ void RedisServerConnection::replyCallback(redisAsyncContext* c, void* r, void* p
         rsc->m_logger->error("{} redis server reply error: {}", rsc->m_conn_id,
                              ((reply == nullptr || reply->str == nullptr) ? "null reply" : reply->str));
         ++rsc->m_total_recv_failure;
+
+        if (reply != nullptr && reply->str != nullptr && std::string_view(reply->str).starts_with("NOSCRIPT")) {
+            // The server has lost our script. The updates in this command are sent again along with the script
+            // itself, and later ones can use the script again once it has been reloaded.
+            rsc->m_script_sha.clear();
+            rsc->loadScript();
+            if (!script_call.empty()) {
+                rsc->resendWithScript(script_call);
+            }
+        }
     }
 }
 
+void RedisServerConnection::resendWithScript(std::string_view script_call) {
+    const std::string cmd = evalCommand(script_call, m_script);
+    ++m_total_sent_cnt;
+
+    int r = m_redis_net->redisAsyncFormattedCommand(m_async_context, this->replyCallback,
+                                                    nullptr, // privdata unused
+                                                    cmd.data(), cmd.size());
+    if (r != REDIS_OK) {
+        // we should get connection closed callback eventually
+        m_logger->error("resend of script call to {} failed: {}", m_conn_id, r);
+        ++m_total_sent_failure;
+        return;
+    }
+    recordSent(1);
+}
+
+void RedisServerConnection::scriptLoadCallback(redisAsyncContext* c, void* r, void* privdata) {
+    RedisServerConnection* rsc = static_cast<RedisServerConnection*>(c->data);
+
+    ++rsc->m_total_recv_cnt;
+    rsc->recordReply();
+    rsc->m_script_load_pending = false;
+
+    redisReply* reply = static_cast<redisReply*>(r);
+    if (reply == nullptr || reply->type != REDIS_REPLY_STRING) {
+        rsc->m_logger->error("{} failed to load script: {}", rsc->m_conn_id,
+                             ((reply == nullptr || reply->str == nullptr) ? "null reply" : reply->str));
+        ++rsc->m_total_recv_failure;
+        return;
+    }
+
+    rsc->m_script_sha.assign(reply->str, reply->len);
+    rsc->m_logger->info("{} loaded script {}", rsc->m_conn_id, rsc->m_script_sha);
+}
+
+void RedisServerConnection::setScript(std::string script) {
+    m_script = std::move(script);
+    m_script_sha.clear();
+    if (connected()) {
+        loadScript();
+    }
+}
+
+void RedisServerConnection::loadScript() {
+    if (m_script.empty() || m_script_load_pending) {
+        return;
+    }
+
+    RespBuffer cmd;
+    cmd.appendCommand("script", "load", m_script);
+    ++m_total_sent_cnt;
+
+    const std::string_view data = cmd.data();
+    int r = m_redis_net->redisAsyncFormattedCommand(m_async_context, this->scriptLoadCallback,
+                                                    nullptr, // privdata unused
+                                                    data.data(), data.size());
+    if (r != REDIS_OK) {
+        // we should get connection closed callback eventually, and try again on reconnect
+        m_logger->error("send script load to {} failed: {}", m_conn_id, r);
+        ++m_total_sent_failure;
+        return;
+    }
+    m_script_load_pending = true;
+    recordSent(1);
+}
+
 void RedisServerConnection::addCommand(const std::string& cmd) {
     m_logger->debug("Redis command: {}", cmd);
     ++m_total_sent_cnt;
@@ -262,7 +415,80 @@ void RedisServerConnection::addCommand(const std::string& cmd) {
         // we should get connection closed callback eventually
         m_logger->error("send to {} failed: {}", m_conn_id, r);
         ++m_total_sent_failure;
+        return;
+    }
+    recordSent(1);
+}
+
+void RedisServerConnection::addCommands(const RespBuffer& batch, std::vector<int64_t> trace_send_usecs) {
+    m_logger->debug("Redis batch of {} commands ({} bytes)", batch.commandCount(), batch.data().size());
+
+    // hiredis matches each reply with the callback of the command it answers, so every command is submitted
+    // individually. They all end up in the same output buffer however, and are written by the next drain.
+    for (size_t i = 0; i < batch.commandCount(); ++i) {
+        const std::string_view cmd = batch.command(i);
+        const bool script_call = isScriptCall(cmd);
+        ++m_total_sent_cnt;
+
+        int r = m_redis_net->redisAsyncFormattedCommand(m_async_context, this->replyCallback,
+                                                        script_call ? &SCRIPT_CALL : nullptr, cmd.data(), cmd.size());
+
+        if (r != REDIS_OK) {
+            // The context is going away, so the remaining commands would fail in the same way.
+            // We should get connection closed callback eventually
+            const size_t unsent = batch.commandCount() - i;
+            m_logger->error("send to {} failed: {} ({} commands dropped)", m_conn_id, r, unsent);
+            m_total_sent_cnt += unsent - 1;
+            m_total_sent_failure += unsent;
+            recordSent(i);
+            return;
+        }
+        if (script_call) {
+            m_script_calls.emplace_back(cmd);
+        }
+    }
+    recordSent(batch.commandCount(), std::move(trace_send_usecs));
+}
+
+void RedisServerConnection::recordSent(uint64_t count, std::vector<int64_t> trace_send_usecs) {
+    if (m_metrics && count > 0) {
+        m_inflight_batches.push_back({std::chrono::steady_clock::now(), count, std::move(trace_send_usecs)});
+    }
+}
+
+void RedisServerConnection::recordReply() {
+    if (m_inflight_batches.empty()) {
+        return;
+    }
+    InflightBatch& batch = m_inflight_batches.front();
+    if (--batch.m_remaining_replies == 0) {
+        const std::chrono::duration<double> reply_time = std::chrono::steady_clock::now() - batch.m_sent_time;
+        m_metrics->m_batch_reply_time.observe(reply_time.count());
+        if (!batch.m_trace_send_usecs.empty()) {
+            const int64_t now_usec = monotonicMicros();
+            for (const int64_t send_usec : batch.m_trace_send_usecs) {
+                m_metrics->m_trace_ack_latency.observe(traceLatencySeconds(send_usec, now_usec));
+            }
+        }
+        m_inflight_batches.pop_front();
+    }
+}
+
+void RedisServerConnection::enableMetrics(MetricsRegistry& registry, const MetricLabels& labels) {
+    m_metrics = std::make_unique<Metrics>(registry, labels);
+}
+
+void RedisServerConnection::publishMetrics() {
+    if (!m_metrics) {
+        return;
     }
+    m_metrics->m_sent.set(m_total_sent_cnt);
+    m_metrics->m_sent_failures.set(m_total_sent_failure);
+    m_metrics->m_recv.set(m_total_recv_cnt);
+    m_metrics->m_recv_failures.set(m_total_recv_failure);
+    m_metrics->m_conn_drops.set(m_total_conn_drops);
+    m_metrics->m_reconnects.set(m_total_reconnects);
+    m_metrics->m_pending_replies.set(static_cast<int64_t>(pendingReplies()));
 }
 
 } // namespace syslogsrv
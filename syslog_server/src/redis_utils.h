@@ -6,7 +6,9 @@
 
 #include <arpa/inet.h>
 #include <async.h>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <ev.h>
 #include <functional>
 #include <hiredis.h>
@@ -15,8 +17,11 @@
 #include <netdb.h>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <vector>
 
 #include "common.h"
+#include "metrics.h"
+#include "resp_buffer.h"
 
 namespace syslogsrv {
 
@@ -41,6 +46,20 @@ FORWARD_DECLARE_TEST(MockLog, replyCallbackNull);
 FORWARD_DECLARE_TEST(MockLog, replyCallbackNoNull);
 FORWARD_DECLARE_TEST(MockLog, addCommandNoRedis);
 FORWARD_DECLARE_TEST(MockLog, addCommandRedis);
+FORWARD_DECLARE_TEST(MockLog, addCommandsNoRedis);
+FORWARD_DECLARE_TEST(MockLog, addCommandsRedis);
+FORWARD_DECLARE_TEST(MockLog, metricsTrackBatchReplies);
+FORWARD_DECLARE_TEST(MockLog, connectCallbackLoadsScript);
+FORWARD_DECLARE_TEST(MockLog, scriptLoadCallbackOk);
+FORWARD_DECLARE_TEST(MockLog, scriptLoadCallbackError);
+FORWARD_DECLARE_TEST(MockLog, replyCallbackNoScriptReloadsScript);
+FORWARD_DECLARE_TEST(MockLog, replyCallbackNoScriptResendsWithScript);
+FORWARD_DECLARE_TEST(msg_processor, serializes_one_script_call_per_hash);
+FORWARD_DECLARE_TEST(msg_processor, keeps_updates_for_disconnected_shards);
+FORWARD_DECLARE_TEST(msg_processor, holds_updates_for_shards_with_too_many_pending_replies);
+FORWARD_DECLARE_TEST(msg_processor, flushes_less_often_while_redis_is_behind);
+FORWARD_DECLARE_TEST(msg_processor, flushes_everything_pending_when_stopping);
+FORWARD_DECLARE_TEST(msg_processor, records_latency_of_traced_events);
 } // namespace test
 
 enum class RedisConnectionState {
@@ -81,6 +100,20 @@ class RedisServerConnection {
     FRIEND_TEST(test::MockLog, replyCallbackNoNull);
     FRIEND_TEST(test::MockLog, addCommandNoRedis);
     FRIEND_TEST(test::MockLog, addCommandRedis);
+    FRIEND_TEST(test::MockLog, addCommandsNoRedis);
+    FRIEND_TEST(test::MockLog, addCommandsRedis);
+    FRIEND_TEST(test::MockLog, metricsTrackBatchReplies);
+    FRIEND_TEST(test::MockLog, connectCallbackLoadsScript);
+    FRIEND_TEST(test::MockLog, scriptLoadCallbackOk);
+    FRIEND_TEST(test::MockLog, scriptLoadCallbackError);
+    FRIEND_TEST(test::MockLog, replyCallbackNoScriptReloadsScript);
+    FRIEND_TEST(test::MockLog, replyCallbackNoScriptResendsWithScript);
+    FRIEND_TEST(test::msg_processor, serializes_one_script_call_per_hash);
+    FRIEND_TEST(test::msg_processor, keeps_updates_for_disconnected_shards);
+    FRIEND_TEST(test::msg_processor, holds_updates_for_shards_with_too_many_pending_replies);
+    FRIEND_TEST(test::msg_processor, flushes_less_often_while_redis_is_behind);
+    FRIEND_TEST(test::msg_processor, flushes_everything_pending_when_stopping);
+    FRIEND_TEST(test::msg_processor, records_latency_of_traced_events);
 
     // logging
     std::shared_ptr<spdlog::logger> m_logger;
@@ -107,16 +140,62 @@ class RedisServerConnection {
     uint64_t m_total_conn_drops = 0;
     uint64_t m_total_reconnects = 0;
 
+    // the stats above, as exported by `publishMetrics()`, plus how long batches take to be answered
+    struct Metrics {
+        Metrics(MetricsRegistry& registry, const MetricLabels& labels);
+
+        Counter& m_sent;
+        Counter& m_sent_failures;
+        Counter& m_recv;
+        Counter& m_recv_failures;
+        Counter& m_conn_drops;
+        Counter& m_reconnects;
+        Gauge& m_pending_replies;
+        Histogram& m_batch_reply_time;
+        Histogram& m_trace_ack_latency;
+    };
+    std::unique_ptr<Metrics> m_metrics;
+
+    struct InflightBatch {
+        std::chrono::steady_clock::time_point m_sent_time;
+        uint64_t m_remaining_replies;
+        std::vector<int64_t> m_trace_send_usecs; // of the traced events the batch carries, see `addCommands()`
+    };
+    // While metrics are enabled, the batches of commands still awaiting replies in the order they were sent.
+    // Redis answers commands in order.
+    std::deque<InflightBatch> m_inflight_batches;
+
+    // lua script loaded into the server on every (re)connect, and its SHA1 once loaded
+    std::string m_script;
+    std::string m_script_sha;
+    bool m_script_load_pending = false;
+
+    // Copies of the commands calling the script that are still awaiting their reply, in the order they were sent, so
+    // that they can be sent again with EVAL if the server turns out not to have the script
+    std::deque<std::string> m_script_calls;
+
     // async callback functions
     // these callbacks are required by hiredis APIs and follow the hiredis format
     static void replyCallback(redisAsyncContext* c, void* r, void* privdata);
+    static void scriptLoadCallback(redisAsyncContext* c, void* r, void* privdata);
     static void connectCallback(const redisAsyncContext* c, int status);
     static void disconnectCallback(const redisAsyncContext* c, int status);
 
-    std::unique_ptr<NetInterface> m_redis_net;
+    std::shared_ptr<NetInterface> m_redis_net;
+
+    // send SCRIPT LOAD for `m_script`, unless there is no script or a load is already in flight
+    void loadScript();
+
+    // send the EVALSHA command `script_call` again as an EVAL of `m_script`
+    void resendWithScript(std::string_view script_call);
+
+    // track the replies to a batch of `count` commands just sent, and a reply received, for `m_batch_reply_time`
+    void recordSent(uint64_t count, std::vector<int64_t> trace_send_usecs = {});
+    void recordReply();
 
   public:
-    RedisServerConnection(std::string host_addr, int host_port, std::unique_ptr<NetInterface> net);
+    // `net` may be shared with other connections used by the same thread. If null, the hiredis library is used.
+    RedisServerConnection(std::string host_addr, int host_port, std::shared_ptr<NetInterface> net);
     ~RedisServerConnection();
 
     RedisServerConnection(const RedisServerConnection&) = delete;
@@ -126,6 +205,9 @@ class RedisServerConnection {
     void connect();
     bool connected() const { return m_connection_status == RedisConnectionState::CONNECTED; }
 
+    // identifies the server in logs, e.g. "QoS(host:port)"
+    const std::string& connId() const { return m_conn_id; }
+
     // Do the required DNS lookups to determine if a reconnect is necessary.
     // Updates an internal flag accordingly, which is used by `reconnectIfNeeded()`
     // to enact the reconnect at an appropriate time.
@@ -134,9 +216,40 @@ class RedisServerConnection {
     // If reconnect is needed, disconnect to initiate re-connect.
     void reconnectIfNeeded();
 
+    // Set a lua script to be loaded into the server with SCRIPT LOAD whenever we connect.
+    // Commands can then run it with EVALSHA using `scriptSha()`.
+    void setScript(std::string script);
+
+    // The SHA1 of the loaded script, or an empty string if the script isn't currently loaded on the server.
+    // If the server reports that it no longer has the script (e.g. after a SCRIPT FLUSH or a failover), the script
+    // is loaded again and this is empty until that completes. The script calls it failed are sent again with EVAL.
+    const std::string& scriptSha() const { return m_script_sha; }
+
     // add a Redis command to the async pipeline
     void addCommand(const std::string& cmd);
 
+    // add a batch of already-serialized Redis commands to the async pipeline.
+    // Each command is copied as-is into the hiredis output buffer, which avoids
+    // formatting the commands one at a time.
+    // `trace_send_usecs` are the times at which HAProxy sent the traced events that the batch includes updates for
+    // (see latency_trace.h). Once the whole batch is answered, the time from each until then is recorded.
+    void addCommands(const RespBuffer& batch, std::vector<int64_t> trace_send_usecs = {});
+
+    // The number of commands submitted that are still waiting for their reply, i.e. how far the server (or the
+    // network to it) is behind us. hiredis invokes the callbacks of all outstanding commands when a connection is
+    // dropped, so this goes back to zero on disconnect.
+    uint64_t pendingReplies() const {
+        const uint64_t answered = m_total_sent_failure + m_total_recv_cnt;
+        return (m_total_sent_cnt > answered) ? (m_total_sent_cnt - answered) : 0;
+    }
+
+    // Export this connection's stats as metrics of `registry` with the given labels. Until then they're only kept
+    // internally (and logged).
+    void enableMetrics(MetricsRegistry& registry, const MetricLabels& labels);
+
+    // Update the exported metrics with the latest stats. Must be called from the thread using the connection.
+    void publishMetrics();
+
     // drain the async pipeline. Note that replies will be delivered
     // asynchronously via the callback functions listed above.
     void drainRedisCmdPipeline() {
@@ -157,6 +270,8 @@ class NetInterface {
     virtual int redisLibevAttach(EV_P_ redisAsyncContext* ac) = 0;
     virtual void redisAsyncDisconnect(redisAsyncContext* ac) = 0;
     virtual int redisAsyncCommand(redisAsyncContext* ac, redisCallbackFn* fn, void* privdata, const char* format) = 0;
+    virtual int redisAsyncFormattedCommand(redisAsyncContext* ac, redisCallbackFn* fn, void* privdata, const char* cmd,
+                                           size_t len) = 0;
     virtual void redisAsyncFree(redisAsyncContext* ac) = 0;
 };
 
@@ -170,6 +285,8 @@ class NetClass : public NetInterface {
     int redisLibevAttach(struct ev_loop* loop, redisAsyncContext* ac) override;
     void redisAsyncDisconnect(redisAsyncContext* ac) override;
     int redisAsyncCommand(redisAsyncContext* ac, redisCallbackFn* fn, void* privdata, const char* format) override;
+    int redisAsyncFormattedCommand(redisAsyncContext* ac, redisCallbackFn* fn, void* privdata, const char* cmd,
+                                   size_t len) override;
     void redisAsyncFree(redisAsyncContext* ac) override;
 };
 
@@ -0,0 +1,38 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <charconv>
+
+#include "resp_buffer.h"
+
+namespace syslogsrv {
+
+namespace {
+
+// Append `prefix`, then `value` in decimal, then the CRLF terminator
+void appendLine(std::string& buffer, char prefix, int64_t value) {
+    char digits[24];
+    const auto result = std::to_chars(std::begin(digits), std::end(digits), value);
+    buffer.push_back(prefix);
+    buffer.append(digits, result.ptr);
+    buffer.append("\r\n");
+}
+
+} // namespace
+
+void RespBuffer::beginCommand(size_t arg_count) { appendLine(m_buffer, '*', static_cast<int64_t>(arg_count)); }
+
+void RespBuffer::appendArg(std::string_view arg) {
+    appendLine(m_buffer, '$', static_cast<int64_t>(arg.size()));
+    m_buffer.append(arg);
+    m_buffer.append("\r\n");
+}
+
+void RespBuffer::appendArg(int64_t arg) {
+    // Redis only accepts arguments as bulk strings, integers are sent as their decimal representation
+    char digits[24];
+    const auto result = std::to_chars(std::begin(digits), std::end(digits), arg);
+    appendArg(std::string_view(digits, result.ptr - digits));
+}
+
+} // namespace syslogsrv
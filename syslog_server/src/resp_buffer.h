@@ -0,0 +1,62 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_RESP_BUFFER
+#define INCLUDED_RESP_BUFFER
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace syslogsrv {
+
+// A batch of redis commands, serialized back-to-back into one contiguous buffer in the redis protocol (RESP) so that
+// they can be handed to hiredis without it having to parse a format string or allocate per command.
+//
+// `clear()` keeps the allocated memory, so a buffer that is reused for every flush stops allocating once it has
+// grown to fit a typical batch.
+class RespBuffer {
+  public:
+    // Append a command made of the given arguments, each of which is either a string or an integer.
+    // For example `appendCommand("expire", key, 60)`.
+    template <typename... Args>
+    void appendCommand(const Args&... args) {
+        beginCommand(sizeof...(args));
+        (appendArg(args), ...);
+        endCommand();
+    }
+
+    // Append a command argument by argument, for commands whose number of arguments is only known at runtime.
+    // Exactly `arg_count` calls to `appendArg()` must follow `beginCommand()`, and then a call to `endCommand()`.
+    void beginCommand(size_t arg_count);
+    void appendArg(std::string_view arg);
+    void appendArg(int64_t arg);
+    void endCommand() { m_command_ends.push_back(m_buffer.size()); }
+
+    size_t commandCount() const { return m_command_ends.size(); }
+    bool empty() const { return m_command_ends.empty(); }
+
+    // The serialized form of the `index`th command
+    std::string_view command(size_t index) const {
+        const size_t begin = (index == 0) ? 0 : m_command_ends[index - 1];
+        return std::string_view(m_buffer).substr(begin, m_command_ends[index] - begin);
+    }
+
+    // All the serialized commands
+    std::string_view data() const { return m_buffer; }
+
+    // Remove all commands, keeping the allocated memory
+    void clear() {
+        m_buffer.clear();
+        m_command_ends.clear();
+    }
+
+  private:
+    std::string m_buffer;
+    std::vector<size_t> m_command_ends; // offset just past the end of each command in `m_buffer`
+};
+
+} // namespace syslogsrv
+
+#endif
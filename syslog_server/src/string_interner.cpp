@@ -0,0 +1,60 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <algorithm>
+
+#include "string_interner.h"
+
+namespace syslogsrv {
+
+StringInterner::StringInterner(uint32_t max_idle_periods)
+    : m_max_idle_periods(std::max<uint32_t>(max_idle_periods, 1)) {}
+
+StringInterner::Id StringInterner::intern(std::string_view value) {
+    const auto it = m_ids.find(value);
+    if (it != m_ids.end()) {
+        m_entries[it->second].m_last_used_period = m_period;
+        return it->second;
+    }
+
+    Id id;
+    if (!m_free_ids.empty()) {
+        id = m_free_ids.back();
+        m_free_ids.pop_back();
+    } else {
+        id = static_cast<Id>(m_entries.size());
+        m_entries.emplace_back();
+    }
+
+    Entry& entry = m_entries[id];
+    entry.m_value = value;
+    entry.m_last_used_period = m_period;
+    entry.m_live = true;
+    m_ids.emplace(entry.m_value, id);
+    return id;
+}
+
+const std::vector<StringInterner::Id>& StringInterner::endPeriod() {
+    m_evicted.clear();
+    ++m_period;
+
+    // Only sweep once every `m_max_idle_periods` periods, so that the cost of sweeping is spread over many periods.
+    // This means strings are actually evicted after between `m_max_idle_periods` and twice that many idle periods.
+    if (m_period % m_max_idle_periods != 0) {
+        return m_evicted;
+    }
+    for (Id id = 0; id < m_entries.size(); ++id) {
+        Entry& entry = m_entries[id];
+        if (entry.m_live && (m_period - entry.m_last_used_period > m_max_idle_periods)) {
+            m_ids.erase(entry.m_value);
+            entry.m_value.clear();
+            entry.m_value.shrink_to_fit();
+            entry.m_live = false;
+            m_free_ids.push_back(id);
+            m_evicted.push_back(id);
+        }
+    }
+    return m_evicted;
+}
+
+} // namespace syslogsrv
@@ -0,0 +1,68 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#ifndef INCLUDED_STRING_INTERNER
+#define INCLUDED_STRING_INTERNER
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace syslogsrv {
+
+// Maps each distinct string to a small integer id, so that keys built from strings that repeat often (user keys,
+// verbs, instance ids...) can be stored, hashed and compared as integers.
+//
+// Time is divided into "periods" by calls to `endPeriod()`. A string that hasn't been interned or touched during the
+// last `max_idle_periods` complete periods is evicted and its id may then be reused for a different string, so callers
+// must not hold on to ids for longer than that without touching them. Not thread-safe.
+class StringInterner {
+  public:
+    using Id = uint32_t;
+
+    explicit StringInterner(uint32_t max_idle_periods);
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    // Returns the id for `value`, allocating one if `value` hasn't been seen recently. Only allocates memory for
+    // strings that aren't already interned.
+    Id intern(std::string_view value);
+
+    // Mark `id` as still in use, so that it isn't evicted at the end of this period
+    void touch(Id id) { m_entries[id].m_last_used_period = m_period; }
+
+    // Returns the string that `id` was allocated for. The view remains valid until the id is evicted.
+    std::string_view lookup(Id id) const { return m_entries[id].m_value; }
+
+    // End the current period, evicting any strings that have now been unused for `max_idle_periods` periods. Returns
+    // the ids of the strings evicted, which remain valid until the next call.
+    const std::vector<Id>& endPeriod();
+
+    // The number of strings currently interned
+    size_t size() const { return m_ids.size(); }
+
+  private:
+    struct Entry {
+        std::string m_value;
+        uint32_t m_last_used_period = 0;
+        bool m_live = false;
+    };
+
+    uint32_t m_max_idle_periods;
+    uint32_t m_period = 0;
+
+    // Indexed by id. A deque never moves existing elements, so the keys of `m_ids` can safely be views of the
+    // strings stored here.
+    std::deque<Entry> m_entries;
+    std::vector<Id> m_free_ids;
+    std::vector<Id> m_evicted;
+    std::unordered_map<std::string_view, Id> m_ids;
+};
+
+} // namespace syslogsrv
+
+#endif
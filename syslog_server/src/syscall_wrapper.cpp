@@ -1,6 +1,7 @@
 // Copyright 2024 Bloomberg Finance L.P.
 // Distributed under the terms of the Apache 2.0 license.
 
+#include "io_uring_receiver.h"
 #include "syscall_wrapper.h"
 
 namespace syslogsrv {
@@ -22,6 +23,12 @@ ssize_t SysCallClass::recvfrom(int sockfd, void* buf, size_t len, int flags, soc
     return ::recvfrom(sockfd, buf, len, flags, src_addr, addrlen);
 }
 
+int SysCallClass::recvmmsg(int sockfd, mmsghdr* msgvec, unsigned int vlen, int flags, timespec* timeout) {
+    return ::recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+}
+
 std::string SysCallClass::getRmemMaxPath() { return "/proc/sys/net/core/rmem_max"; }
 
+bool SysCallClass::ioUringAvailable() { return ioUringSupported(); }
+
 } // namespace syslogsrv
@@ -4,6 +4,7 @@
 #ifndef INCLUDED_SYSCALL_WRAPPER
 #define INCLUDED_SYSCALL_WRAPPER
 
+#include <ctime>
 #include <string>
 #include <sys/socket.h>
 
@@ -21,7 +22,10 @@ class SystemInterface {
     virtual int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen) = 0;
     virtual int bind(int sockfd, const sockaddr* addr, socklen_t addrlen) = 0;
     virtual ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags, sockaddr* src_addr, socklen_t* addrlen) = 0;
+    virtual int recvmmsg(int sockfd, mmsghdr* msgvec, unsigned int vlen, int flags, timespec* timeout) = 0;
     virtual std::string getRmemMaxPath() = 0;
+    // Whether datagrams can be received through io_uring (see `IoUringReceiver`)
+    virtual bool ioUringAvailable() = 0;
 };
 
 // SystemInterface implementation using the corresponding functions in <sys/socket.h> in POSIX standard library
@@ -32,7 +36,9 @@ class SysCallClass : public SystemInterface {
     int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen) override;
     int bind(int sockfd, const sockaddr* addr, socklen_t addrlen) override;
     ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags, sockaddr* src_addr, socklen_t* addrlen) override;
+    int recvmmsg(int sockfd, mmsghdr* msgvec, unsigned int vlen, int flags, timespec* timeout) override;
     std::string getRmemMaxPath() override;
+    bool ioUringAvailable() override;
 };
 
 } // namespace syslogsrv
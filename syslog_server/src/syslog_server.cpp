@@ -3,20 +3,33 @@
 
 #include <algorithm>
 #include <arpa/inet.h>
+#include <atomic>
 #include <condition_variable>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <netdb.h>
+#include <optional>
+#include <pthread.h>
 #include <regex>
 #include <spdlog/sinks/hourly_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <vector>
 
+#include "binary_event.h"
 #include "common.h"
+#include "cpu_affinity.h"
+#include "event_classifier.h"
+#include "hot_restart.h"
+#include "io_uring_receiver.h"
+#include "metrics.h"
 #include "msg_processor.h"
 #include "processor_config.h"
+#include "recv_batch.h"
 #include "syslog_server.h"
 #include "time_wrapper.h"
 
@@ -115,6 +128,38 @@ void setUdpPortReuseOption(const int s, SystemInterface& sys_call) {
     }
 }
 
+void setIncomingCpu(const int s, int cpu, SystemInterface& sys_call) {
+    int r = sys_call.setsockopt(s, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+
+    if (r < 0) {
+        // Only a hint for how to spread packets across the SO_REUSEPORT sockets, so we can carry on without it
+        auto logger = spdlog::get(SERVER_NAME);
+        logger->error("setsockopt SO_INCOMING_CPU failed: {}", strerror(errno));
+    }
+}
+
+std::optional<CpuSet> configuredCpuSet(const YAML::Node& config, int worker_id) {
+    auto logger = spdlog::get(SERVER_NAME);
+
+    const YAML::Node& node = config[CONFIG_CPU_AFFINITY];
+    if (!node) {
+        return std::nullopt;
+    }
+    if (!node.IsSequence() || (node.size() == 0)) {
+        logger->error("'{}' must be a list of CPU sets, not pinning syslog server {}", CONFIG_CPU_AFFINITY,
+                      worker_id);
+        return std::nullopt;
+    }
+
+    const auto spec = yamlAsOrDefault<std::string>(logger, CONFIG_CPU_AFFINITY, node[worker_id % node.size()], "");
+    auto cpus = resolveCpuSet(spec);
+    if (!cpus) {
+        logger->error("Invalid CPU set '{}' in '{}', not pinning syslog server {}", spec, CONFIG_CPU_AFFINITY,
+                      worker_id);
+    }
+    return cpus;
+}
+
 // Create a socket with port in config
 int createSocket(const YAML::Node& config, SystemInterface& sys_call) {
     auto logger = spdlog::get(SERVER_NAME);
@@ -140,22 +185,159 @@ int createSocket(const YAML::Node& config, SystemInterface& sys_call) {
     return s;
 }
 
-void msgProducerThread(int sock, Processor::FIFOList& queue, std::shared_ptr<spdlog::logger> logger,
-                       std::shared_ptr<spdlog::logger> access_logger, int worker_id, SystemInterface& sys_call,
-                       TimeWrapper& time) {
+RecvBackend selectRecvBackend(const std::string& configured_backend, size_t recv_batch_size,
+                              SystemInterface& sys_call) {
+    auto logger = spdlog::get(SERVER_NAME);
+    const RecvBackend socket_backend = (recv_batch_size > 1) ? RecvBackend::RecvMmsg : RecvBackend::RecvFrom;
+
+    if (configured_backend == RECV_BACKEND_IO_URING) {
+        if (sys_call.ioUringAvailable()) {
+            return RecvBackend::IoUring;
+        }
+        logger->warn("io_uring receive backend is not available on this build or host, using socket receives");
+    } else if (configured_backend != RECV_BACKEND_SOCKET) {
+        logger->error("Unknown receive backend '{}', using socket receives", configured_backend);
+    }
+    return socket_backend;
+}
+
+namespace {
+
+DispatchResult queueEvent(const ClassifiedEvent& event, std::string_view user_key, PartitionedMessageQueue& queues,
+                          spdlog::logger& logger) {
+    MessageQueue& queue = queues.partitionFor(user_key);
+    if (event.m_payload.size() > queue.maxMessageSize()) {
+        logger.error("message is too big to queue: {}", event.m_payload);
+        return DispatchResult::TooBig;
+    }
+    if (!queue.tryEnqueue(event.m_payload, event.m_type)) {
+        logger.error("Queue is full, dropping message: {}", event.m_payload);
+        return DispatchResult::QueueFull;
+    }
+    return DispatchResult::Queued;
+}
+
+} // namespace
+
+DispatchResult dispatchDatagram(std::string_view buf_view, PartitionedMessageQueue& queues, spdlog::logger& logger,
+                                spdlog::logger& access_logger) {
+    // Binary records are checked for first, since they may well end in a byte that looks like a newline
+    if (isBinaryEvent(buf_view)) {
+        const ClassifiedBinaryEvent binary = classifyBinaryEvent(buf_view);
+        if (binary.m_event.m_type == EventType::Unknown) {
+            logger.error("haproxy sent an invalid binary record of {} bytes", buf_view.size());
+            return DispatchResult::Logged;
+        }
+        return queueEvent(binary.m_event, binary.m_user_key, queues, logger);
+    }
+
+    // strip trailing "\n"
+    while (!buf_view.empty() && buf_view.back() == '\n') {
+        buf_view.remove_suffix(1);
+    }
+
+    const ClassifiedEvent event = classifyEvent(buf_view);
+    if (event.m_type != EventType::Unknown) {
+        logger.debug("haproxy logged command: {}", buf_view);
+        return queueEvent(event, eventUserKey(event.m_payload), queues, logger);
+    }
+    if (!buf_view.empty() && buf_view[0] == '{') {
+        // JSON line from HAProxy
+        access_logger.info("{}", buf_view);
+        return DispatchResult::AccessLog;
+    }
+    // Logs from Lua
+    logger.info("haproxy logged message: {}", buf_view);
+    return DispatchResult::Logged;
+}
+
+namespace {
+
+// Counts what a producer thread does with the datagrams it receives, and periodically logs its throughput
+class ProducerStats {
+  public:
+    ProducerStats(const PartitionedMessageQueue& queue, spdlog::logger& logger, int worker_id, TimeWrapper& time)
+        : m_queue(queue), m_logger(logger), m_worker_id(worker_id), m_time(time), m_last_stats_time(time.now()),
+          m_received(producerCounter("weir_syslog_datagrams_received_total", "Datagrams received from HAProxy")),
+          m_queued(producerCounter("weir_syslog_messages_queued_total", "Control messages queued for the consumers")),
+          m_dropped_queue_full(droppedCounter("queue_full")), m_dropped_too_big(droppedCounter("too_big")),
+          m_dropped_truncated(droppedCounter("truncated")) {}
+
+    void recordTruncated() {
+        m_received.add();
+        m_dropped_truncated.add();
+    }
+
+    void recordDispatched(DispatchResult result) {
+        m_received.add();
+        switch (result) {
+        case DispatchResult::Queued:
+            m_queued.add();
+            break;
+        case DispatchResult::QueueFull:
+            m_dropped_queue_full.add();
+            break;
+        case DispatchResult::TooBig:
+            m_dropped_too_big.add();
+            break;
+        case DispatchResult::AccessLog:
+        case DispatchResult::Logged:
+            break;
+        }
+    }
+
+    void recordProcessed(size_t msg_count) {
+        m_total_msgs_processed += msg_count;
+        const auto now = m_time.now();
+        if (now - m_last_stats_time > STATS_LOG_INTERVAL) {
+            const size_t new_msgs_processed = m_total_msgs_processed - m_last_logged_msgs_processed;
+            m_logger.info("Msg Producer Thread - current queue size={}, msgs processed since last log={}, worker_id={}",
+                          m_queue.sizeApprox(), new_msgs_processed, m_worker_id);
+            m_last_logged_msgs_processed = m_total_msgs_processed;
+            m_last_stats_time = now;
+        }
+    }
+
+  private:
+    Counter& producerCounter(std::string_view name, std::string_view help) const {
+        return MetricsRegistry::global().counter(name, help, {{"worker", std::to_string(m_worker_id)}});
+    }
+    Counter& droppedCounter(std::string_view reason) const {
+        const MetricLabels labels = {{"worker", std::to_string(m_worker_id)}, {"reason", std::string(reason)}};
+        return MetricsRegistry::global().counter("weir_syslog_messages_dropped_total",
+                                                 "Control messages dropped before reaching a consumer", labels);
+    }
 
+    const PartitionedMessageQueue& m_queue;
+    spdlog::logger& m_logger;
+    int m_worker_id;
+    TimeWrapper& m_time;
+    std::chrono::system_clock::time_point m_last_stats_time;
+    size_t m_total_msgs_processed = 0;
+    size_t m_last_logged_msgs_processed = 0;
+
+    Counter& m_received;
+    Counter& m_queued;
+    Counter& m_dropped_queue_full;
+    Counter& m_dropped_too_big;
+    Counter& m_dropped_truncated;
+};
+
+// Receives one datagram per syscall, into a buffer as large as the socket's receive buffer
+void recvfromLoop(std::stop_token stop, int sock, PartitionedMessageQueue& queue, spdlog::logger& logger,
+                  spdlog::logger& access_logger, SystemInterface& sys_call, ProducerStats& stats) {
     // Allocate a userspace buffer that is as large as the socket's receive buffer so that we can never
     // fail to receive a packet due to the packet being larger than the buffer we passed to `recv()`.
     const size_t buffer_len = setUdpRecvBufSize(sock, sys_call);
     std::unique_ptr<char[]> buffer(new char[buffer_len + 1]());
-    size_t total_msgs_processed = 0;
-    size_t last_logged_msgs_processed = 0;
 
-    auto last_stats_time = time.now();
-    while (true) {
+    while (!stop.stop_requested()) {
         ssize_t recv_len = sys_call.recvfrom(sock, buffer.get(), buffer_len, 0, nullptr, nullptr);
         if (recv_len < 0) {
-            logger->error("Error when receiving data");
+            if (errno == EINTR) {
+                continue; // woken up to check whether we should stop
+            }
+            logger.error("Error when receiving data");
             exit(1);
         }
 
@@ -163,61 +345,197 @@ void msgProducerThread(int sock, Processor::FIFOList& queue, std::shared_ptr<spd
             continue;
         }
 
-        assert(recv_len <= buffer_len);
+        assert(static_cast<size_t>(recv_len) <= buffer_len);
 
         std::string_view buf_view{buffer.get(), (size_t)recv_len};
 
         // the data might be truncated
-        if (recv_len == buffer_len) {
-            logger->error("message is too big: {}", buf_view);
+        if (static_cast<size_t>(recv_len) == buffer_len) {
+            logger.error("message is too big: {}", buf_view);
+            stats.recordTruncated();
             continue;
         }
 
-        // strip trailing "\n"
-        while (!buf_view.empty() && buf_view.back() == '\n') {
-            buf_view.remove_suffix(1);
-        }
+        stats.recordDispatched(dispatchDatagram(buf_view, queue, logger, access_logger));
+        stats.recordProcessed(1);
+    }
+}
 
-        size_t pos = buf_view.find(RawEvents::reqStart());
-        if (pos == std::string_view::npos) {
-            pos = buf_view.find(RawEvents::reqEnd());
+// Receives up to `batch_size` datagrams per syscall, into a reusable pool of `slot_size`-byte buffers
+void recvmmsgLoop(std::stop_token stop, int sock, PartitionedMessageQueue& queue, spdlog::logger& logger,
+                  spdlog::logger& access_logger, SystemInterface& sys_call, ProducerStats& stats, size_t batch_size,
+                  size_t slot_size) {
+    // We still grow the kernel's receive buffer so that bursts can queue up between our calls to `recvmmsg`,
+    // but each datagram now only needs to fit in a single slot of our batch.
+    setUdpRecvBufSize(sock, sys_call);
+    RecvBatch batch(batch_size, slot_size);
+    logger.info("Receiving datagrams in batches of up to {}, with {} byte buffers", batch_size, slot_size);
+
+    while (!stop.stop_requested()) {
+        const int recv_count = batch.receive(sock, sys_call);
+        if (recv_count < 0) {
+            if (errno == EINTR) {
+                continue; // woken up to check whether we should stop
+            }
+            logger.error("Error when receiving data: {}", strerror(errno));
+            exit(1);
         }
-        if (pos == std::string_view::npos) {
-            pos = buf_view.find(RawEvents::dataXfer());
+
+        size_t dispatched_count = 0;
+        for (int i = 0; i < recv_count; ++i) {
+            const std::string_view buf_view = batch.datagram(i);
+            if (buf_view.empty()) {
+                continue;
+            }
+            if (batch.truncated(i)) {
+                logger.error("message is too big: {}", buf_view);
+                stats.recordTruncated();
+                continue;
+            }
+
+            stats.recordDispatched(dispatchDatagram(buf_view, queue, logger, access_logger));
+            ++dispatched_count;
         }
-        if (pos == std::string_view::npos) {
-            pos = buf_view.find(RawEvents::activeReqs());
+        stats.recordProcessed(dispatched_count);
+    }
+}
+
+// Receives datagrams through a multishot io_uring receive into a ring of `ring_size` buffers of `slot_size` bytes.
+// Returns false if the ring could not be set up or failed before receiving anything, so that the caller can fall back
+// to one of the socket loops, or true once `stop` is requested and the datagrams already received have been handled.
+bool ioUringLoop(std::stop_token stop, int sock, PartitionedMessageQueue& queue, spdlog::logger& logger,
+                 spdlog::logger& access_logger, SystemInterface& sys_call, ProducerStats& stats, size_t ring_size,
+                 size_t slot_size) {
+    setUdpRecvBufSize(sock, sys_call);
+    IoUringReceiver receiver(ring_size, slot_size);
+    if (!receiver.start(sock)) {
+        logger.error("Failed to set up io_uring receives: {}", strerror(errno));
+        return false;
+    }
+    logger.info("Receiving datagrams through io_uring, with {} buffers of {} bytes", receiver.bufferCount(),
+                receiver.bufferSize());
+
+    bool received_any = false;
+    const IoUringReceiver::DatagramHandler handler = [&](std::string_view buf_view, bool truncated) {
+        if (buf_view.empty()) {
+            return;
         }
-        if (pos == std::string_view::npos) {
-            pos = buf_view.find(RawEvents::reqEnd());
+        if (truncated) {
+            logger.error("message is too big: {}", buf_view);
+            stats.recordTruncated();
+            return;
         }
-        if (pos != std::string_view::npos) {
-            std::string_view data_start = buf_view.substr(pos);
-            if (!queue.try_enqueue(std::string(data_start))) {
-                logger->error("Queue is full, dropping message: {}", data_start);
+        stats.recordDispatched(dispatchDatagram(buf_view, queue, logger, access_logger));
+    };
+
+    while (!stop.stop_requested()) {
+        const int recv_count = receiver.receive(handler);
+        if (recv_count < 0) {
+            // Older kernels reject the multishot receive itself, which only shows up on its first completion
+            if (!received_any) {
+                logger.error("io_uring receive failed before any data arrived: {}", strerror(errno));
+                return false;
             }
-            logger->debug("haproxy logged command: {}", buf_view);
-        } else if (buf_view[0] == '{') {
-            // JSON line from HAProxy
-            access_logger->info("{}", buf_view);
-        } else {
-            // Logs from Lua
-            logger->info("haproxy logged message: {}", buf_view);
+            logger.error("Error when receiving data: {}", strerror(errno));
+            exit(1);
+        }
+        received_any = received_any || (recv_count > 0);
+        stats.recordProcessed(recv_count);
+    }
+
+    // The kernel may have received more datagrams into our buffers since, which would be lost with the ring
+    const int drained_count = receiver.drain(handler);
+    if (drained_count < 0) {
+        logger.error("Failed to drain the io_uring receive: {}", strerror(errno));
+        return true;
+    }
+    stats.recordProcessed(drained_count);
+    return true;
+}
+
+// While in scope, has a stop being requested on `stop` wake the thread that created it out of any blocking receive.
+// It is woken over and over until it leaves the scope, since a single wake-up would be missed if it came just before
+// the thread went back to blocking.
+class WakeOnStop {
+  public:
+    explicit WakeOnStop(std::stop_token stop)
+        : m_thread(pthread_self()), m_callback(std::move(stop), [this] { wakeUntilDone(); }) {}
+    ~WakeOnStop() { m_done = true; } // before m_callback is destroyed, which waits for the callback to return
+
+    WakeOnStop(const WakeOnStop&) = delete;
+    WakeOnStop& operator=(const WakeOnStop&) = delete;
+
+  private:
+    void wakeUntilDone() {
+        // A stop requested before we were created is run right away, by the thread itself, which checks for it anyway
+        if (pthread_equal(pthread_self(), m_thread)) {
+            return;
+        }
+        while (!m_done) {
+            wakeThread(m_thread);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+    }
+
+    const pthread_t m_thread;
+    std::atomic<bool> m_done = false;
+    std::stop_callback<std::function<void()>> m_callback;
+};
+
+} // namespace
+
+void ServerStartup::receiving() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_starting;
+    }
+    m_cv.notify_all();
+}
+
+void ServerStartup::failed() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = true;
+    }
+    m_cv.notify_all();
+}
+
+bool ServerStartup::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return m_failed || (m_starting <= 0); });
+    return !m_failed;
+}
 
-        ++total_msgs_processed;
-        const auto now = time.now();
-        if (now - last_stats_time > STATS_LOG_INTERVAL) {
-            const size_t new_msgs_processed = total_msgs_processed - last_logged_msgs_processed;
-            logger->info("Msg Producer Thread - current queue size={}, msgs processed since last log={}, worker_id={}",
-                         queue.size_approx(), new_msgs_processed, worker_id);
-            last_logged_msgs_processed = total_msgs_processed;
-            last_stats_time = now;
+struct RecvOptions {
+    RecvBackend backend;
+    size_t batch_size;
+    size_t buffer_size;
+    size_t ring_size;
+};
+
+void msgProducerThread(std::stop_token stop, int sock, PartitionedMessageQueue& queue,
+                       std::shared_ptr<spdlog::logger> logger, std::shared_ptr<spdlog::logger> access_logger,
+                       int worker_id, SystemInterface& sys_call, TimeWrapper& time, const RecvOptions& recv,
+                       ServerStartup& startup) {
+    ProducerStats stats(queue, *logger, worker_id, time);
+    WakeOnStop wake_on_stop(stop);
+    // Whichever loop we end up in, the socket is ours from here on, and anything sent to it waits in its buffer
+    startup.receiving();
+    if (recv.backend == RecvBackend::IoUring) {
+        if (ioUringLoop(stop, sock, queue, *logger, *access_logger, sys_call, stats, recv.ring_size,
+                        recv.buffer_size)) {
+            return;
         }
+        logger->warn("Falling back to socket receives");
+    }
+    if (recv.batch_size > 1) {
+        recvmmsgLoop(stop, sock, queue, *logger, *access_logger, sys_call, stats, recv.batch_size, recv.buffer_size);
+    } else {
+        recvfromLoop(stop, sock, queue, *logger, *access_logger, sys_call, stats);
     }
 }
 
-void startSyslogServer(YAML::Node config, int worker_id) {
+void startSyslogServer(std::stop_token stop, YAML::Node config, int worker_id, int s, ServerStartup& startup) {
     auto logger = spdlog::get(SERVER_NAME);
     auto access_logger = spdlog::get(ACCESS_LOG);
 
@@ -225,9 +543,23 @@ void startSyslogServer(YAML::Node config, int worker_id) {
 
     try {
         SysCallClass sys_call;
-        auto s = createSocket(config, sys_call); // this is the socket that we listen to.
-        if (s == -1) {
-            logger->error("Failed to create socket");
+
+        // Pin this server to its CPUs before starting any other threads, so that its consumers inherit the same
+        // affinity and stay close to the producer they share queues with
+        const std::optional<CpuSet> cpus = configuredCpuSet(config, worker_id);
+        if (cpus) {
+            if (pinCurrentThread(*cpus)) {
+                logger->info("syslog server {} pinned to CPUs {}", worker_id, formatCpuList(*cpus));
+            } else {
+                logger->error("Failed to pin syslog server {} to CPUs {}: {}", worker_id, formatCpuList(*cpus),
+                              strerror(errno));
+            }
+        }
+
+        if (cpus && yamlAsOrDefault<bool>(logger, CONFIG_SOCKET_INCOMING_CPU, config[CONFIG_SOCKET_INCOMING_CPU],
+                                                 DEFAULT_SOCKET_INCOMING_CPU)) {
+            // Prefer this socket for the packets that the kernel handles on our first CPU
+            setIncomingCpu(s, cpus->front(), sys_call);
         }
 
         // create shared queue between consumer (Processor object) and producer:
@@ -236,18 +568,78 @@ void startSyslogServer(YAML::Node config, int worker_id) {
             msg_queue_size = yamlAsOrDefault<int>(logger, CONFIG_MSG_QUEUE_SIZE, node, DEFAULT_MSG_QUEUE_SIZE);
         }
 
-        Processor::FIFOList message_queue(msg_queue_size);
+        // receive batching: how many datagrams to receive per syscall, and the buffer size for each of them
+        int recv_batch_size = DEFAULT_RECV_BATCH_SIZE;
+        if (const auto& node = config[CONFIG_RECV_BATCH_SIZE]) {
+            recv_batch_size = yamlAsOrDefault<int>(logger, CONFIG_RECV_BATCH_SIZE, node, DEFAULT_RECV_BATCH_SIZE);
+        }
+        int recv_buffer_size = DEFAULT_RECV_BUFFER_SIZE;
+        if (const auto& node = config[CONFIG_RECV_BUFFER_SIZE]) {
+            recv_buffer_size = yamlAsOrDefault<int>(logger, CONFIG_RECV_BUFFER_SIZE, node, DEFAULT_RECV_BUFFER_SIZE);
+        }
+        if ((recv_batch_size < 1) || (recv_buffer_size < 1)) {
+            logger->error("Invalid receive batching config (batch size {}, buffer size {}), using defaults",
+                          recv_batch_size, recv_buffer_size);
+            recv_batch_size = DEFAULT_RECV_BATCH_SIZE;
+            recv_buffer_size = DEFAULT_RECV_BUFFER_SIZE;
+        }
+
+        // receive backend: plain socket calls, or io_uring with a ring of `recv_ring_size` buffers
+        const auto recv_backend = yamlAsOrDefault<std::string>(logger, CONFIG_RECV_BACKEND, config[CONFIG_RECV_BACKEND],
+                                                                RECV_BACKEND_SOCKET);
+        int recv_ring_size = DEFAULT_RECV_RING_SIZE;
+        if (const auto& node = config[CONFIG_RECV_RING_SIZE]) {
+            recv_ring_size = yamlAsOrDefault<int>(logger, CONFIG_RECV_RING_SIZE, node, DEFAULT_RECV_RING_SIZE);
+        }
+        if (recv_ring_size < 1) {
+            logger->error("Invalid receive ring size {}, using default", recv_ring_size);
+            recv_ring_size = DEFAULT_RECV_RING_SIZE;
+        }
+        const RecvOptions recv_options{selectRecvBackend(recv_backend, recv_batch_size, sys_call),
+                                       static_cast<size_t>(recv_batch_size), static_cast<size_t>(recv_buffer_size),
+                                       static_cast<size_t>(recv_ring_size)};
+
+        // the messages received on the socket can be spread out across several consumers, partitioned by user
+        int consumer_count = DEFAULT_CONSUMERS_PER_SERVER;
+        if (const auto& node = config[CONFIG_CONSUMERS_PER_SERVER]) {
+            consumer_count =
+                yamlAsOrDefault<int>(logger, CONFIG_CONSUMERS_PER_SERVER, node, DEFAULT_CONSUMERS_PER_SERVER);
+        }
+        if (consumer_count < 1) {
+            logger->error("Invalid number of consumers per server {}, using default", consumer_count);
+            consumer_count = DEFAULT_CONSUMERS_PER_SERVER;
+        }
+
+        PartitionedMessageQueue message_queues(consumer_count, msg_queue_size);
+        message_queues.recordEnqueueTimes(yamlAsOrDefault<bool>(logger, CONFIG_LATENCY_TRACING,
+                                                                config[CONFIG_LATENCY_TRACING],
+                                                                DEFAULT_LATENCY_TRACING));
         TimeWrapper time;
 
-        // create & start message consumer worker
-        auto net = std::make_unique<NetClass>();
-        Processor worker(message_queue, config, worker_id, time, std::move(net));
-        worker.start();
+        // create & start message consumer workers, each with its own connections to redis
+        std::vector<std::unique_ptr<Processor>> workers;
+        for (int i = 0; i < consumer_count; ++i) {
+            auto net = std::make_unique<NetClass>();
+            workers.push_back(
+                std::make_unique<Processor>(message_queues.partition(i), config, worker_id, time, std::move(net), i));
+            workers.back()->start();
+        }
+        logger->info("syslog server {} started {} message consumers", worker_id, consumer_count);
+
+        // read incoming HAProxy messages until asked to stop & dispatch to workers' queues
+        msgProducerThread(stop, s, message_queues, logger, access_logger, worker_id, sys_call, time, recv_options,
+                          startup);
 
-        // read incoming HAProxy messages forever & dispatch to workers' queues
-        msgProducerThread(s, message_queue, logger, access_logger, worker_id, sys_call, time);
+        // Nothing more is being queued, so the workers can flush whatever they have left and stop
+        logger->info("syslog server {} stopped receiving, flushing its pending updates", worker_id);
+        for (auto& worker : workers) {
+            worker->stop();
+        }
+        workers.clear();
+        logger->info("syslog server {} stopped", worker_id);
     } catch (const std::exception& e) {
         logger->error("Exception in syslog-server {}: {}", worker_id, e.what());
+        startup.failed();
     }
 }
 
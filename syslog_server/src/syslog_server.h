@@ -4,9 +4,18 @@
 #ifndef INCLUDED_SYSLOG_SERVER
 #define INCLUDED_SYSLOG_SERVER
 
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <stop_token>
 #include <string>
+#include <string_view>
 #include <yaml-cpp/yaml.h>
 
+#include "cpu_affinity.h"
+#include "message_queue.h"
+#include "msg_processor.h"
 #include "syscall_wrapper.h"
 
 namespace syslogsrv {
@@ -21,10 +30,70 @@ void setUdpRecvBufSize(int s, size_t size, SystemInterface& sys_call);
 void setUdpPortReuseOption(const int s, SystemInterface& sys_call);
 int createSocket(const YAML::Node& config, SystemInterface& sys_call);
 
+// Ask the kernel to prefer socket `s` for packets processed on `cpu`, amongst the sockets sharing its port
+void setIncomingCpu(const int s, int cpu, SystemInterface& sys_call);
+
+// The CPUs that syslog server `worker_id` is configured to run on, from its entry of the `cpu_affinity` list.
+// Returns an empty optional if the server isn't to be pinned.
+std::optional<CpuSet> configuredCpuSet(const YAML::Node& config, int worker_id);
+
+// The mechanism used by the producer thread to receive datagrams from HAProxy
+enum class RecvBackend {
+    RecvFrom, // one blocking `recvfrom` per datagram
+    RecvMmsg, // batches of datagrams per `recvmmsg` call
+    IoUring,  // multishot receives into a kernel-provided buffer ring
+};
+
+// Choose the receive backend from the configured `recv_backend` and `recv_batch_size`, falling back to the socket
+// backends if io_uring was requested but is not available on this build or host.
+RecvBackend selectRecvBackend(const std::string& configured_backend, size_t recv_batch_size,
+                              SystemInterface& sys_call);
+
+// What `dispatchDatagram()` did with a datagram
+enum class DispatchResult {
+    Queued,    // a control message, queued for its consumer
+    QueueFull, // a control message, dropped because its consumer's queue is full
+    TooBig,    // a control message, dropped because it doesn't fit in the queue
+    AccessLog, // written to the access log
+    Logged,    // written to the regular log (or empty)
+};
+
+// Handle a single datagram received from HAProxy: control messages are queued for processing by the
+// message consumer of their user, JSON lines are written to the access log and anything else to the regular log.
+DispatchResult dispatchDatagram(std::string_view buf_view, PartitionedMessageQueue& queues, spdlog::logger& logger,
+                      spdlog::logger& access_logger);
+
+// Lets the main thread wait until every syslog server is receiving on its socket, e.g. before confirming a hand-off
+class ServerStartup {
+  public:
+    explicit ServerStartup(int server_count) : m_starting(server_count) {}
+
+    ServerStartup(const ServerStartup&) = delete;
+    ServerStartup& operator=(const ServerStartup&) = delete;
+
+    // Called by each server once it has started its consumers and is about to receive
+    void receiving();
+
+    // Called by a server that failed to start, or stopped because of an error
+    void failed();
+
+    // Block until every server is receiving, returning true, or until any of them has failed, returning false
+    bool wait();
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    int m_starting;
+    bool m_failed = false;
+};
+
 // The main entry point for each syslog server thread.
-// Handles receipt of messages from HAProxy via socket and either writes
-// them to the log if it's a log message or queues it for processing otherwise.
-void startSyslogServer(YAML::Node config, int worker_id);
+// Handles receipt of messages from HAProxy via socket `s` (from `createSocket()`, or taken over from a previous
+// process) and either writes them to the log if it's a log message or queues it for processing otherwise.
+// Once `stop` is requested, the thread stops receiving, flushes everything it has aggregated to redis and returns.
+// Stopping relies on the thread being woken by `wakeThread()`, so `installWakeupHandler()` must have been called.
+// The server reports to `startup` once it is receiving, or if it fails.
+void startSyslogServer(std::stop_token stop, YAML::Node config, int worker_id, int s, ServerStartup& startup);
 
 } // namespace syslogsrv
 
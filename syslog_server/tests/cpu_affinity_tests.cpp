@@ -0,0 +1,70 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+
+#include "cpu_affinity.h"
+
+namespace syslogsrv {
+namespace test {
+
+TEST(cpu_affinity, parses_cpu_lists) {
+    EXPECT_EQ(parseCpuList("3"), CpuSet({3}));
+    EXPECT_EQ(parseCpuList("0-3,8,10-11"), CpuSet({0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(parseCpuList("4,0-1,1\n"), CpuSet({0, 1, 4}));
+}
+
+TEST(cpu_affinity, rejects_malformed_cpu_lists) {
+    EXPECT_FALSE(parseCpuList(""));
+    EXPECT_FALSE(parseCpuList("a"));
+    EXPECT_FALSE(parseCpuList("1,,2"));
+    EXPECT_FALSE(parseCpuList("3-1"));
+    EXPECT_FALSE(parseCpuList("-1"));
+    EXPECT_FALSE(parseCpuList("1-"));
+    EXPECT_FALSE(parseCpuList("1x"));
+    EXPECT_FALSE(parseCpuList("100000"));
+}
+
+TEST(cpu_affinity, formats_cpu_lists) {
+    EXPECT_EQ(formatCpuList({3}), "3");
+    EXPECT_EQ(formatCpuList({0, 1, 2, 3, 8, 10, 11}), "0-3,8,10-11");
+}
+
+TEST(cpu_affinity, resolves_numa_nodes_from_sysfs) {
+    const std::filesystem::path node_dir = std::filesystem::temp_directory_path() / "weir_cpu_affinity_test";
+    std::filesystem::create_directories(node_dir / "node1");
+    std::ofstream(node_dir / "node1" / "cpulist") << "8-11,24-27\n";
+
+    EXPECT_EQ(resolveCpuSet("numa:1", node_dir), CpuSet({8, 9, 10, 11, 24, 25, 26, 27}));
+    EXPECT_FALSE(resolveCpuSet("numa:2", node_dir));
+    EXPECT_FALSE(resolveCpuSet("numa:", node_dir));
+    EXPECT_FALSE(resolveCpuSet("numa:x", node_dir));
+    EXPECT_EQ(resolveCpuSet("2-3", node_dir), CpuSet({2, 3}));
+
+    std::filesystem::remove_all(node_dir);
+}
+
+TEST(cpu_affinity, pins_the_current_thread) {
+    std::jthread([]() {
+        cpu_set_t allowed;
+        ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed), 0);
+        int first_cpu = 0;
+        while (!CPU_ISSET(first_cpu, &allowed)) {
+            ++first_cpu;
+        }
+
+        ASSERT_TRUE(pinCurrentThread({first_cpu}));
+        cpu_set_t pinned;
+        ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(pinned), &pinned), 0);
+        EXPECT_EQ(CPU_COUNT(&pinned), 1);
+        EXPECT_TRUE(CPU_ISSET(first_cpu, &pinned));
+    });
+}
+
+} // namespace test
+} // namespace syslogsrv
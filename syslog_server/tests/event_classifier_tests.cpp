@@ -0,0 +1,72 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "event_classifier.h"
+
+namespace syslogsrv {
+namespace test {
+
+TEST(event_classifier, classifies_each_event_type) {
+    const std::string header = "<134>Jan  1 00:00:00 haproxy[1]: ";
+
+    const auto req = classifyEvent(header + "req~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7~|~");
+    EXPECT_EQ(req.m_type, EventType::ReqStart);
+    EXPECT_EQ(req.m_payload, "req~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7~|~");
+
+    const auto req_end = classifyEvent(header + "req_end~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7");
+    EXPECT_EQ(req_end.m_type, EventType::ReqEnd);
+    EXPECT_EQ(req_end.m_payload, "req_end~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7");
+
+    const auto data_xfer = classifyEvent(header + "data_xfer~|~1.2.3.4:55094~|~KEY~|~dwn~|~4096");
+    EXPECT_EQ(data_xfer.m_type, EventType::DataXfer);
+    EXPECT_EQ(data_xfer.m_payload, "data_xfer~|~1.2.3.4:55094~|~KEY~|~dwn~|~4096");
+
+    const auto active_reqs = classifyEvent(header + "active_reqs~|~inst~|~KEY~|~up~|~7");
+    EXPECT_EQ(active_reqs.m_type, EventType::ActiveReqs);
+    EXPECT_EQ(active_reqs.m_payload, "active_reqs~|~inst~|~KEY~|~up~|~7");
+}
+
+TEST(event_classifier, classifies_events_without_a_syslog_header) {
+    const auto event = classifyEvent("req~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7~|~");
+    EXPECT_EQ(event.m_type, EventType::ReqStart);
+    EXPECT_EQ(event.m_payload, "req~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7~|~");
+}
+
+TEST(event_classifier, ignores_lines_without_events) {
+    EXPECT_EQ(classifyEvent("").m_type, EventType::Unknown);
+    EXPECT_EQ(classifyEvent("haproxy logged something ~ | ~").m_type, EventType::Unknown);
+    EXPECT_EQ(classifyEvent("{\"json\": \"access log\"}").m_type, EventType::Unknown);
+    EXPECT_TRUE(classifyEvent("trailing ~|").m_payload.empty());
+}
+
+TEST(event_classifier, ignores_unknown_event_types) {
+    EXPECT_EQ(classifyEvent("haproxy[1]: reqs~|~1~|~2").m_type, EventType::Unknown);
+    EXPECT_EQ(classifyEvent("haproxy[1]: prereq~|~1~|~2").m_type, EventType::Unknown);
+    EXPECT_EQ(classifyEvent("haproxy[1]: ~|~1~|~2").m_type, EventType::Unknown);
+}
+
+TEST(event_classifier, skips_tildes_that_are_not_delimiters) {
+    const auto event = classifyEvent("haproxy[1]: ~~ ~| data_xfer~|~1.2.3.4:1~|~KEY~|~up~|~1");
+    EXPECT_EQ(event.m_type, EventType::DataXfer);
+    EXPECT_EQ(event.m_payload, "data_xfer~|~1.2.3.4:1~|~KEY~|~up~|~1");
+}
+
+TEST(event_classifier, extracts_the_user_key_of_each_event_type) {
+    EXPECT_EQ(eventUserKey("req~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7~|~"), "KEY");
+    EXPECT_EQ(eventUserKey("req_end~|~1.2.3.4:58840~|~KEY~|~PUT~|~up~|~inst~|~7"), "KEY");
+    EXPECT_EQ(eventUserKey("data_xfer~|~1.2.3.4:55094~|~KEY~|~dwn~|~4096"), "KEY");
+    EXPECT_EQ(eventUserKey("active_reqs~|~inst~|~KEY~|~up~|~7"), "KEY");
+}
+
+TEST(event_classifier, user_key_of_a_truncated_event_is_empty) {
+    EXPECT_EQ(eventUserKey(""), "");
+    EXPECT_EQ(eventUserKey("req~|~1.2.3.4:58840"), "");
+    EXPECT_EQ(eventUserKey("req~|~1.2.3.4:58840~|~"), "");
+    EXPECT_EQ(eventUserKey("req~|~1.2.3.4:58840~|~KEY"), "KEY");
+}
+
+} // namespace test
+} // namespace syslogsrv
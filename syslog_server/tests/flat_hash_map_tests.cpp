@@ -0,0 +1,116 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+#include "flat_hash_map.h"
+
+namespace syslogsrv {
+namespace test {
+
+TEST(flat_hash_map, inserts_and_finds_entries) {
+    FlatHashMap<int, int> map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.find(1), map.end());
+
+    map[1] = 10;
+    map[2] += 5;
+    map[2] += 5;
+    EXPECT_EQ(map.size(), 2);
+    ASSERT_NE(map.find(1), map.end());
+    EXPECT_EQ(map.find(1)->second, 10);
+    EXPECT_EQ(map[2], 10);
+    EXPECT_EQ(map.find(3), map.end());
+}
+
+TEST(flat_hash_map, iterates_over_every_entry) {
+    FlatHashMap<int, int> map;
+    std::map<int, int> expected;
+    for (int i = 0; i < 1000; ++i) {
+        map[i * 7] = i;
+        expected[i * 7] = i;
+    }
+
+    std::map<int, int> seen;
+    for (const auto& [key, value] : map) {
+        seen[key] = value;
+    }
+    EXPECT_EQ(seen, expected);
+}
+
+TEST(flat_hash_map, clear_keeps_capacity) {
+    FlatHashMap<int, int> map;
+    for (int i = 0; i < 1000; ++i) {
+        map[i] = i;
+    }
+    const size_t capacity = map.capacity();
+    EXPECT_GE(capacity, 2000);
+
+    map.clear();
+    EXPECT_EQ(map.size(), 0);
+    EXPECT_EQ(map.capacity(), capacity);
+    EXPECT_EQ(map.begin(), map.end());
+    EXPECT_EQ(map.find(5), map.end());
+
+    for (int i = 0; i < 1000; ++i) {
+        map[i] = i;
+    }
+    EXPECT_EQ(map.capacity(), capacity);
+    EXPECT_EQ(map[999], 999);
+}
+
+TEST(flat_hash_map, erase_if_removes_matching_entries) {
+    FlatHashMap<int, int> map;
+    for (int i = 0; i < 100; ++i) {
+        map[i] = i;
+    }
+    map.eraseIf([](const auto& entry) { return entry.first % 2 == 0; });
+
+    EXPECT_EQ(map.size(), 50);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(map.find(i) != map.end(), i % 2 == 1) << i;
+    }
+}
+
+// All keys collide, so every lookup has to probe past the other entries
+struct CollidingHash {
+    size_t operator()(int) const { return 3; }
+};
+
+TEST(flat_hash_map, handles_colliding_keys) {
+    FlatHashMap<int, int, CollidingHash> map;
+    for (int i = 0; i < 50; ++i) {
+        map[i] = i * 2;
+    }
+    EXPECT_EQ(map.size(), 50);
+    for (int i = 0; i < 50; ++i) {
+        ASSERT_NE(map.find(i), map.end());
+        EXPECT_EQ(map.find(i)->second, i * 2);
+    }
+    EXPECT_EQ(map.find(50), map.end());
+}
+
+TEST(flat_hash_map, matches_reference_map_for_random_updates) {
+    FlatHashMap<uint64_t, int64_t> map;
+    std::map<uint64_t, int64_t> expected;
+    std::mt19937_64 rng(42);
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 10000; ++i) {
+            const uint64_t key = rng() % 3000;
+            const int64_t delta = static_cast<int64_t>(rng() % 100);
+            map[key] += delta;
+            expected[key] += delta;
+        }
+        ASSERT_EQ(map.size(), expected.size());
+        for (const auto& [key, value] : expected) {
+            ASSERT_EQ(map[key], value);
+        }
+        map.clear();
+        expected.clear();
+    }
+}
+
+} // namespace test
+} // namespace syslogsrv
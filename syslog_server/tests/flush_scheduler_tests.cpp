@@ -0,0 +1,88 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <gtest/gtest.h>
+
+#include "flush_scheduler.h"
+
+namespace syslogsrv {
+namespace test {
+
+using std::chrono::milliseconds;
+
+TEST(flush_scheduler, starts_at_the_min_period) {
+    FlushScheduler scheduler(milliseconds(31), milliseconds(250), 1000);
+    EXPECT_EQ(scheduler.period(), milliseconds(31));
+}
+
+TEST(flush_scheduler, period_grows_up_to_the_max_while_replies_are_pending) {
+    FlushScheduler scheduler(milliseconds(31), milliseconds(250), 1000);
+    scheduler.update(251);
+    EXPECT_EQ(scheduler.period(), milliseconds(62));
+    scheduler.update(251);
+    EXPECT_EQ(scheduler.period(), milliseconds(124));
+    scheduler.update(251);
+    EXPECT_EQ(scheduler.period(), milliseconds(248));
+    scheduler.update(251);
+    EXPECT_EQ(scheduler.period(), milliseconds(250));
+    scheduler.update(1000);
+    EXPECT_EQ(scheduler.period(), milliseconds(250));
+}
+
+TEST(flush_scheduler, period_shrinks_back_to_the_min_once_caught_up) {
+    FlushScheduler scheduler(milliseconds(31), milliseconds(250), 1000);
+    for (int i = 0; i < 4; ++i) {
+        scheduler.update(1000);
+    }
+    ASSERT_EQ(scheduler.period(), milliseconds(250));
+
+    scheduler.update(0);
+    EXPECT_EQ(scheduler.period(), milliseconds(125));
+    scheduler.update(0);
+    scheduler.update(0);
+    EXPECT_EQ(scheduler.period(), milliseconds(31));
+    scheduler.update(0);
+    EXPECT_EQ(scheduler.period(), milliseconds(31));
+}
+
+TEST(flush_scheduler, period_holds_between_the_thresholds) {
+    FlushScheduler scheduler(milliseconds(10), milliseconds(100), 1000);
+    scheduler.update(1000);
+    ASSERT_EQ(scheduler.period(), milliseconds(20));
+    scheduler.update(100);
+    EXPECT_EQ(scheduler.period(), milliseconds(20));
+}
+
+TEST(flush_scheduler, period_shrinks_with_a_small_pending_replies_limit) {
+    FlushScheduler scheduler(milliseconds(10), milliseconds(100), 8);
+    scheduler.update(3);
+    ASSERT_EQ(scheduler.period(), milliseconds(20));
+    scheduler.update(1);
+    EXPECT_EQ(scheduler.period(), milliseconds(20));
+    scheduler.update(0);
+    EXPECT_EQ(scheduler.period(), milliseconds(10));
+}
+
+TEST(flush_scheduler, zero_min_period_can_still_grow) {
+    FlushScheduler scheduler(milliseconds(0), milliseconds(8), 1000);
+    scheduler.update(1000);
+    EXPECT_EQ(scheduler.period(), milliseconds(1));
+    scheduler.update(1000);
+    EXPECT_EQ(scheduler.period(), milliseconds(2));
+}
+
+TEST(flush_scheduler, max_period_is_at_least_the_min_period) {
+    FlushScheduler scheduler(milliseconds(50), milliseconds(10), 1000);
+    EXPECT_EQ(scheduler.maxPeriod(), milliseconds(50));
+    scheduler.update(1000);
+    EXPECT_EQ(scheduler.period(), milliseconds(50));
+}
+
+TEST(flush_scheduler, overloaded_at_the_high_water_mark) {
+    FlushScheduler scheduler(milliseconds(31), milliseconds(250), 1000);
+    EXPECT_FALSE(scheduler.overloaded(999));
+    EXPECT_TRUE(scheduler.overloaded(1000));
+}
+
+} // namespace test
+} // namespace syslogsrv
@@ -0,0 +1,157 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <future>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "hot_restart.h"
+#include "test_common.h"
+
+namespace syslogsrv {
+namespace test {
+
+namespace {
+
+// A UDP socket bound to any free port on the loopback interface
+int boundUdpSocket() {
+    const int s = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    return s;
+}
+
+sockaddr_in localAddress(int s) {
+    sockaddr_in addr = {};
+    socklen_t addr_len = sizeof(addr);
+    EXPECT_EQ(::getsockname(s, reinterpret_cast<sockaddr*>(&addr), &addr_len), 0);
+    return addr;
+}
+
+// Whether a datagram sent to the address of `bound` can be received on `s`
+bool receivesDatagramsOf(int s, int bound) {
+    const sockaddr_in addr = localAddress(bound);
+    const int sender = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ::sendto(sender, "hello", 5, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    ::close(sender);
+
+    char buffer[16] = {};
+    return (::recv(s, buffer, sizeof(buffer), 0) == 5) && (std::string_view(buffer) == "hello");
+}
+
+} // namespace
+
+class HotRestart : public MockLog {
+  protected:
+    void TearDown() override {
+        ::unlink(m_path.c_str());
+        MockLog::TearDown();
+    }
+
+    const std::string m_path = (std::filesystem::temp_directory_path() / "weir_hot_restart_test.sock").string();
+};
+
+TEST_F(HotRestart, sends_sockets_over_a_unix_socket) {
+    int conn[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, conn), 0);
+    const std::vector<int> sockets = {boundUdpSocket(), boundUdpSocket()};
+
+    ASSERT_TRUE(sendSockets(conn[0], sockets));
+    const auto received = receiveSockets(conn[1]);
+    ASSERT_TRUE(received);
+    ASSERT_EQ(received->size(), 2);
+    for (size_t i = 0; i < sockets.size(); ++i) {
+        EXPECT_NE((*received)[i], sockets[i]);
+        EXPECT_EQ(localAddress((*received)[i]).sin_port, localAddress(sockets[i]).sin_port);
+        EXPECT_TRUE(receivesDatagramsOf((*received)[i], sockets[i]));
+        ::close((*received)[i]);
+        ::close(sockets[i]);
+    }
+    ::close(conn[0]);
+    ::close(conn[1]);
+}
+
+TEST_F(HotRestart, fails_to_receive_from_a_closed_connection) {
+    int conn[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, conn), 0);
+    ::close(conn[0]);
+    EXPECT_FALSE(receiveSockets(conn[1]));
+    ::close(conn[1]);
+}
+
+TEST_F(HotRestart, starts_afresh_without_a_running_server) {
+    HandoffClient client;
+    EXPECT_TRUE(client.requestSockets(m_path).empty());
+    client.confirm();
+}
+
+TEST_F(HotRestart, hands_sockets_over_to_a_new_process) {
+    const int s = boundUdpSocket();
+    HandoffListener listener;
+    ASSERT_TRUE(listener.listen(m_path));
+    auto handed_off = std::async(std::launch::async, [&] { return listener.waitForHandoff({s}); });
+
+    HandoffClient client;
+    const std::vector<int> sockets = client.requestSockets(m_path);
+    ASSERT_EQ(sockets.size(), 1);
+    EXPECT_TRUE(receivesDatagramsOf(sockets[0], s));
+
+    client.confirm();
+    EXPECT_TRUE(handed_off.get());
+    ::close(sockets[0]);
+    ::close(s);
+}
+
+TEST_F(HotRestart, carries_on_if_the_new_process_does_not_confirm) {
+    const int s = boundUdpSocket();
+    HandoffListener listener;
+    ASSERT_TRUE(listener.listen(m_path));
+    auto handed_off = std::async(std::launch::async, [&] { return listener.waitForHandoff({s}); });
+
+    {
+        HandoffClient failed_client;
+        const std::vector<int> sockets = failed_client.requestSockets(m_path);
+        ASSERT_EQ(sockets.size(), 1);
+        ::close(sockets[0]);
+    }
+    EXPECT_EQ(handed_off.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+
+    HandoffClient client;
+    const std::vector<int> sockets = client.requestSockets(m_path);
+    ASSERT_EQ(sockets.size(), 1);
+    client.confirm();
+    EXPECT_TRUE(handed_off.get());
+    ::close(sockets[0]);
+    ::close(s);
+}
+
+TEST_F(HotRestart, wakes_threads_out_of_blocking_receives) {
+    installWakeupHandler();
+    const int s = boundUdpSocket();
+    std::promise<pthread_t> receiver_thread;
+    auto receive_error = std::async(std::launch::async, [&] {
+        receiver_thread.set_value(pthread_self());
+        char buffer[16];
+        // the wake-up may come before we block, so keep trying until we see it
+        while (::recv(s, buffer, sizeof(buffer), 0) != -1) {
+        }
+        return errno;
+    });
+
+    const pthread_t thread = receiver_thread.get_future().get();
+    while (receive_error.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) {
+        wakeThread(thread);
+    }
+    EXPECT_EQ(receive_error.get(), EINTR);
+    ::close(s);
+}
+
+} // namespace test
+} // namespace syslogsrv
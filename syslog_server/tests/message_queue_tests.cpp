@@ -0,0 +1,133 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "latency_trace.h"
+#include "message_queue.h"
+
+namespace syslogsrv {
+namespace test {
+
+TEST(message_queue, dequeues_messages_in_order) {
+    MessageQueue queue(4, 64);
+    EXPECT_TRUE(queue.tryEnqueue("first", EventType::ReqStart));
+    EXPECT_TRUE(queue.tryEnqueue("second", EventType::ReqStart));
+    EXPECT_EQ(queue.sizeApprox(), 2);
+
+    QueuedMessage msg;
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.view(), "first");
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.view(), "second");
+    EXPECT_FALSE(queue.tryDequeue(msg));
+}
+
+TEST(message_queue, rejects_messages_when_full) {
+    MessageQueue queue(1, 64);
+    EXPECT_TRUE(queue.tryEnqueue("first", EventType::ReqStart));
+    EXPECT_FALSE(queue.tryEnqueue("second", EventType::ReqStart));
+
+    // the rejected message must not have overwritten the queued one
+    QueuedMessage msg;
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.view(), "first");
+}
+
+TEST(message_queue, records_enqueue_times_when_enabled) {
+    MessageQueue queue(4, 64);
+    EXPECT_TRUE(queue.tryEnqueue("untimed", EventType::ReqStart));
+    queue.recordEnqueueTimes(true);
+    const int64_t before_usec = monotonicMicros();
+    EXPECT_TRUE(queue.tryEnqueue("timed", EventType::ReqStart));
+
+    QueuedMessage msg;
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.m_enqueue_usec, 0);
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_GE(msg.m_enqueue_usec, before_usec);
+    EXPECT_LE(msg.m_enqueue_usec, monotonicMicros());
+}
+
+TEST(message_queue, rejects_messages_larger_than_a_chunk) {
+    MessageQueue queue(4, 8);
+    EXPECT_EQ(queue.maxMessageSize(), 8);
+    EXPECT_FALSE(queue.tryEnqueue("123456789", EventType::ReqStart));
+    EXPECT_TRUE(queue.tryEnqueue("12345678", EventType::ReqStart));
+}
+
+TEST(message_queue, messages_spanning_chunks_stay_intact) {
+    MessageQueue queue(8, 8);
+    EXPECT_TRUE(queue.tryEnqueue("aaaaa", EventType::ReqStart));
+    EXPECT_TRUE(queue.tryEnqueue("bbbbb", EventType::ReqStart));
+    EXPECT_TRUE(queue.tryEnqueue("ccc", EventType::ReqStart));
+    EXPECT_EQ(queue.chunkCount(), 2);
+
+    QueuedMessage msg;
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.view(), "aaaaa");
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.view(), "bbbbb");
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.view(), "ccc");
+}
+
+TEST(message_queue, chunks_are_recycled_once_consumed) {
+    MessageQueue queue(8, 8);
+    QueuedMessage msg;
+    for (int i = 0; i < 100; ++i) {
+        const std::string value = "msg" + std::to_string(i % 10);
+        ASSERT_TRUE(queue.tryEnqueue(value, EventType::ReqStart));
+        ASSERT_TRUE(queue.tryDequeue(msg));
+        EXPECT_EQ(msg.view(), value);
+    }
+
+    // one chunk being read from plus at most one being written to
+    EXPECT_LE(queue.chunkCount(), 3);
+}
+
+TEST(message_queue, hands_messages_between_threads) {
+    constexpr int msg_count = 100000;
+    MessageQueue queue(1024, 256);
+
+    std::jthread producer([&queue]() {
+        for (int i = 0; i < msg_count; ++i) {
+            const std::string value = std::to_string(i);
+            while (!queue.tryEnqueue(value, EventType::ReqStart)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    QueuedMessage msg;
+    for (int i = 0; i < msg_count; ++i) {
+        ASSERT_TRUE(queue.waitDequeueTimed(msg, std::chrono::seconds(5)));
+        ASSERT_EQ(msg.view(), std::to_string(i));
+    }
+}
+
+TEST(partitioned_message_queue, routes_each_user_to_one_partition) {
+    PartitionedMessageQueue queues(3, 16);
+    EXPECT_EQ(queues.partitionCount(), 3);
+    EXPECT_EQ(&queues.partitionFor("user1"), &queues.partitionFor("user1"));
+
+    // users are spread across the partitions
+    std::set<MessageQueue*> used;
+    for (int i = 0; i < 30; ++i) {
+        used.insert(&queues.partitionFor("user" + std::to_string(i)));
+    }
+    EXPECT_EQ(used.size(), 3);
+}
+
+TEST(partitioned_message_queue, has_at_least_one_partition) {
+    PartitionedMessageQueue queues(0, 16);
+    ASSERT_EQ(queues.partitionCount(), 1);
+    EXPECT_TRUE(queues.partitionFor("user1").tryEnqueue("msg", EventType::ReqStart));
+    EXPECT_EQ(queues.sizeApprox(), 1);
+}
+
+} // namespace test
+} // namespace syslogsrv
@@ -0,0 +1,116 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "metrics_server.h"
+#include "test_common.h"
+
+namespace syslogsrv {
+namespace test {
+
+TEST(metrics, renders_counters_and_gauges) {
+    MetricsRegistry registry;
+    registry.counter("requests_total", "Requests seen", {{"worker", "0"}}).add(3);
+    registry.counter("requests_total", "Requests seen", {{"worker", "1"}}).add();
+    registry.gauge("queue_depth", "Queued messages").set(-2);
+
+    EXPECT_EQ(registry.render(), "# HELP queue_depth Queued messages\n"
+                                 "# TYPE queue_depth gauge\n"
+                                 "queue_depth -2\n"
+                                 "# HELP requests_total Requests seen\n"
+                                 "# TYPE requests_total counter\n"
+                                 "requests_total{worker=\"0\"} 3\n"
+                                 "requests_total{worker=\"1\"} 1\n");
+}
+
+TEST(metrics, returns_the_same_metric_for_the_same_labels) {
+    MetricsRegistry registry;
+    Counter& counter = registry.counter("requests_total", "Requests seen", {{"worker", "0"}});
+    EXPECT_EQ(&registry.counter("requests_total", "Requests seen", {{"worker", "0"}}), &counter);
+    EXPECT_NE(&registry.counter("requests_total", "Requests seen", {{"worker", "1"}}), &counter);
+}
+
+TEST(metrics, rejects_a_name_registered_with_another_type) {
+    MetricsRegistry registry;
+    registry.counter("requests_total", "Requests seen");
+    EXPECT_THROW(registry.gauge("requests_total", "Requests seen"), std::invalid_argument);
+}
+
+TEST(metrics, escapes_label_values) {
+    MetricsRegistry registry;
+    registry.gauge("g", "help", {{"path", "a\"b\\c\nd"}}).set(1);
+    EXPECT_NE(registry.render().find("g{path=\"a\\\"b\\\\c\\nd\"} 1\n"), std::string::npos);
+}
+
+TEST(metrics, renders_cumulative_histogram_buckets) {
+    MetricsRegistry registry;
+    Histogram& histogram = registry.histogram("latency_seconds", "Latency", {0.1, 1}, {{"worker", "0"}});
+    histogram.observe(0.05);
+    histogram.observe(0.1);
+    histogram.observe(0.5);
+    histogram.observe(3);
+    EXPECT_EQ(histogram.count(), 4);
+    EXPECT_DOUBLE_EQ(histogram.sum(), 3.65);
+
+    EXPECT_EQ(registry.render(), "# HELP latency_seconds Latency\n"
+                                 "# TYPE latency_seconds histogram\n"
+                                 "latency_seconds_bucket{worker=\"0\",le=\"0.1\"} 2\n"
+                                 "latency_seconds_bucket{worker=\"0\",le=\"1\"} 3\n"
+                                 "latency_seconds_bucket{worker=\"0\",le=\"+Inf\"} 4\n"
+                                 "latency_seconds_sum{worker=\"0\"} 3.65\n"
+                                 "latency_seconds_count{worker=\"0\"} 4\n");
+}
+
+TEST(metrics_server, serves_metrics_only_at_their_path) {
+    MetricsRegistry registry;
+    registry.counter("requests_total", "Requests seen").add(7);
+
+    const std::string response = metricsHttpResponse("GET /metrics HTTP/1.1", registry);
+    EXPECT_TRUE(response.starts_with("HTTP/1.1 200 OK\r\n"));
+    EXPECT_TRUE(response.ends_with("\r\n\r\n" + registry.render()));
+    EXPECT_TRUE(metricsHttpResponse("GET /metrics?x=1 HTTP/1.1", registry).starts_with("HTTP/1.1 200 OK\r\n"));
+
+    EXPECT_TRUE(metricsHttpResponse("GET / HTTP/1.1", registry).starts_with("HTTP/1.1 404 Not Found\r\n"));
+    EXPECT_TRUE(metricsHttpResponse("POST /metrics HTTP/1.1", registry).starts_with("HTTP/1.1 404 Not Found\r\n"));
+    EXPECT_TRUE(metricsHttpResponse("", registry).starts_with("HTTP/1.1 404 Not Found\r\n"));
+}
+
+TEST_F(MockLog, metricsServerAnswersScrapes) {
+    MetricsRegistry registry;
+    registry.counter("requests_total", "Requests seen").add(7);
+    MetricsServer server(registry);
+    ASSERT_TRUE(server.start(0));
+    ASSERT_NE(server.port(), 0);
+
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(fd, -1);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server.port());
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+
+    const std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(::send(fd, request.data(), request.size(), 0), static_cast<ssize_t>(request.size()));
+    std::string response;
+    char buffer[1024];
+    ssize_t len;
+    while ((len = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, len);
+    }
+    ::close(fd);
+
+    EXPECT_TRUE(response.starts_with("HTTP/1.1 200 OK\r\n"));
+    EXPECT_NE(response.find("requests_total 7\n"), std::string::npos);
+}
+
+} // namespace test
+} // namespace syslogsrv
@@ -5,7 +5,9 @@
 #include <memory>
 #include <redis_utils.h>
 #include <sys/socket.h>
+#include <vector>
 
+#include "latency_trace.h"
 #include "test_common.h"
 
 namespace syslogsrv {
@@ -21,6 +23,8 @@ class MockNetClass : public NetInterface {
     MOCK_METHOD(int, redisLibevAttach, (EV_P_ redisAsyncContext*), (override));
     MOCK_METHOD(void, redisAsyncDisconnect, (redisAsyncContext*), (override));
     MOCK_METHOD(int, redisAsyncCommand, (redisAsyncContext*, redisCallbackFn*, void*, const char*), (override));
+    MOCK_METHOD(int, redisAsyncFormattedCommand, (redisAsyncContext*, redisCallbackFn*, void*, const char*, size_t),
+                (override));
     MOCK_METHOD(void, redisAsyncFree, (redisAsyncContext*), (override));
 };
 
@@ -498,6 +502,81 @@ TEST_F(MockLog, connectCallbackRedisOk) {
     EXPECT_EQ(conn.m_redis_ip, "1.1.1.1");
 }
 
+TEST_F(MockLog, connectCallbackLoadsScript) {
+    auto mock_net = std::make_unique<testing::NiceMock<MockNetClass>>();
+    MockNetClass* p = mock_net.get();
+
+    RedisServerConnection conn("127.0.0.1", 1234, std::move(mock_net));
+    conn.setScript("return 1");
+    conn.m_script_sha = "stale";
+
+    redisAsyncContext rac;
+    rac.data = static_cast<RedisServerConnection*>(&conn);
+    sockaddr_in saddr;
+    rac.c.saddr = reinterpret_cast<decltype(rac.c.saddr)>(&saddr);
+
+    std::string sent;
+    EXPECT_CALL(*p, redisAsyncFormattedCommand)
+        .WillOnce([&sent](redisAsyncContext*, redisCallbackFn*, void*, const char* cmd, size_t len) {
+            sent.assign(cmd, len);
+            return REDIS_OK;
+        });
+
+    conn.connectCallback(&rac, REDIS_OK);
+
+    EXPECT_EQ(sent, "*3\r\n$6\r\nscript\r\n$4\r\nload\r\n$8\r\nreturn 1\r\n");
+    EXPECT_EQ(conn.scriptSha(), "");
+    EXPECT_TRUE(conn.m_script_load_pending);
+}
+
+// scriptLoadCallback
+TEST_F(MockLog, scriptLoadCallbackOk) {
+    RedisServerConnection conn("127.0.0.1", 1234, nullptr);
+    conn.m_script_load_pending = true;
+
+    redisAsyncContext rac;
+    rac.data = static_cast<RedisServerConnection*>(&conn);
+
+    char sha[] = "e0e1f9fabfc9d4800c877a703b823ac0578ff8db";
+    redisReply r = {};
+    r.type = REDIS_REPLY_STRING;
+    r.str = sha;
+    r.len = sizeof(sha) - 1;
+    conn.scriptLoadCallback(&rac, &r, nullptr);
+
+    EXPECT_EQ(conn.scriptSha(), sha);
+    EXPECT_FALSE(conn.m_script_load_pending);
+}
+TEST_F(MockLog, scriptLoadCallbackError) {
+    uint64_t total_recv_failure = 5;
+    auto logger = spdlog::get(SERVER_NAME);
+    std::string line;
+
+    RedisServerConnection conn("127.0.0.1", 1234, nullptr);
+    conn.m_total_recv_failure = total_recv_failure;
+    conn.m_conn_id = "fake_id";
+    conn.m_script_load_pending = true;
+
+    redisAsyncContext rac;
+    rac.data = static_cast<RedisServerConnection*>(&conn);
+
+    char err[] = "ERR Error compiling script";
+    redisReply r = {};
+    r.type = REDIS_REPLY_ERROR;
+    r.str = err;
+    r.len = sizeof(err) - 1;
+    conn.scriptLoadCallback(&rac, &r, nullptr);
+
+    logger->flush();
+    std::ifstream log(MOCK_LOG);
+    std::getline(log, line);
+    EXPECT_TRUE(line.find("fake_id failed to load script") != std::string::npos)
+        << "the last log line is: " << line << std::endl;
+    EXPECT_EQ(conn.scriptSha(), "");
+    EXPECT_FALSE(conn.m_script_load_pending);
+    EXPECT_EQ(conn.m_total_recv_failure, total_recv_failure + 1);
+}
+
 // disconnectCallback
 TEST_F(MockLog, disconnectCallbackRedisNoOk) {
     uint64_t total_conn_drops = 3;
@@ -610,6 +689,84 @@ TEST_F(MockLog, replyCallbackNoNull) {
     EXPECT_EQ(conn.m_total_recv_failure, total_recv_failure);
 }
 
+TEST_F(MockLog, replyCallbackNoScriptReloadsScript) {
+    auto mock_net = std::make_unique<MockNetClass>();
+    MockNetClass* p = mock_net.get();
+
+    RedisServerConnection conn("127.0.0.1", 1234, std::move(mock_net));
+    conn.m_script = "return 1";
+    conn.m_script_sha = "e0e1f9fabfc9d4800c877a703b823ac0578ff8db";
+
+    redisAsyncContext rac;
+    rac.data = static_cast<RedisServerConnection*>(&conn);
+
+    // Only the first of several failed script calls reloads the script
+    EXPECT_CALL(*p, redisAsyncFormattedCommand).WillOnce(testing::Return(REDIS_OK));
+
+    char err[] = "NOSCRIPT No matching script. Please use EVAL.";
+    redisReply r = {};
+    r.type = REDIS_REPLY_ERROR;
+    r.str = err;
+    r.len = sizeof(err) - 1;
+    conn.replyCallback(&rac, &r, nullptr);
+    conn.replyCallback(&rac, &r, nullptr);
+
+    EXPECT_EQ(conn.scriptSha(), "");
+    EXPECT_TRUE(conn.m_script_load_pending);
+}
+
+TEST_F(MockLog, replyCallbackNoScriptResendsWithScript) {
+    auto mock_net = std::make_unique<MockNetClass>();
+    MockNetClass* p = mock_net.get();
+
+    RedisServerConnection conn("127.0.0.1", 1234, std::move(mock_net));
+    conn.m_script = "return 1";
+    conn.m_script_sha = "e0e1f9fabfc9d4800c877a703b823ac0578ff8db";
+
+    redisAsyncContext rac;
+    rac.data = static_cast<RedisServerConnection*>(&conn);
+
+    RespBuffer batch;
+    batch.appendCommand("evalsha", conn.m_script_sha, 1, "key1", 2, "PUT", 1);
+    batch.appendCommand("get", "key1");
+    batch.appendCommand("evalsha", conn.m_script_sha, 1, "key2", 2, "GET", 3);
+
+    std::vector<std::string> sent;
+    std::vector<void*> sent_privdata;
+    EXPECT_CALL(*p, redisAsyncFormattedCommand)
+        .WillRepeatedly([&](redisAsyncContext*, redisCallbackFn*, void* privdata, const char* cmd, size_t len) {
+            sent.emplace_back(cmd, len);
+            sent_privdata.push_back(privdata);
+            return REDIS_OK;
+        });
+    conn.addCommands(batch);
+    ASSERT_EQ(sent.size(), 3);
+
+    char ok[] = "OK";
+    redisReply ok_reply = {};
+    ok_reply.type = REDIS_REPLY_STATUS;
+    ok_reply.str = ok;
+    ok_reply.len = sizeof(ok) - 1;
+    char err[] = "NOSCRIPT No matching script. Please use EVAL.";
+    redisReply err_reply = {};
+    err_reply.type = REDIS_REPLY_ERROR;
+    err_reply.str = err;
+    err_reply.len = sizeof(err) - 1;
+
+    // The first call succeeds, but the server has lost the script by the second one, which is sent again with the
+    // script after reloading it
+    conn.replyCallback(&rac, &ok_reply, sent_privdata[0]);
+    conn.replyCallback(&rac, &ok_reply, sent_privdata[1]);
+    conn.replyCallback(&rac, &err_reply, sent_privdata[2]);
+
+    ASSERT_EQ(sent.size(), 5);
+    EXPECT_EQ(sent[3], "*3\r\n$6\r\nscript\r\n$4\r\nload\r\n$8\r\nreturn 1\r\n");
+    EXPECT_EQ(sent[4], "*7\r\n$4\r\neval\r\n$8\r\nreturn 1\r\n$1\r\n1\r\n$4\r\nkey2\r\n$1\r\n2\r\n$3\r\nGET\r\n"
+                       "$1\r\n3\r\n");
+    EXPECT_TRUE(conn.m_script_calls.empty());
+    EXPECT_EQ(conn.pendingReplies(), 2);
+}
+
 // addCommand
 TEST_F(MockLog, addCommandNoRedis) {
     uint64_t total_sent_cnt = 3;
@@ -656,5 +813,118 @@ TEST_F(MockLog, addCommandRedis) {
     EXPECT_EQ(conn.m_total_sent_failure, total_sent_failure);
 }
 
+// addCommands
+TEST_F(MockLog, addCommandsNoRedis) {
+    uint64_t total_sent_cnt = 3;
+    uint64_t total_sent_failure = 5;
+    auto logger = spdlog::get(SERVER_NAME);
+    std::string line;
+
+    auto mock_net = std::make_unique<MockNetClass>();
+    MockNetClass* p = mock_net.get();
+
+    RedisServerConnection conn("127.0.0.1", 1234, std::move(mock_net));
+    conn.m_total_sent_cnt = total_sent_cnt;
+    conn.m_total_sent_failure = total_sent_failure;
+    conn.m_conn_id = "fake_id";
+
+    RespBuffer batch;
+    batch.appendCommand("get", "key1");
+    batch.appendCommand("get", "key2");
+    batch.appendCommand("get", "key3");
+
+    // Once a command fails, the rest of the batch is dropped without being submitted
+    EXPECT_CALL(*p, redisAsyncFormattedCommand)
+        .WillOnce(testing::Return(REDIS_OK))
+        .WillOnce(testing::Return(REDIS_ERR));
+
+    conn.addCommands(batch);
+
+    logger->flush();
+    std::ifstream log(MOCK_LOG);
+    std::getline(log, line);
+    EXPECT_TRUE(line.find("send to fake_id failed:") != std::string::npos)
+        << "the last log line is: " << line << std::endl;
+    EXPECT_EQ(conn.m_total_sent_cnt, total_sent_cnt + 3);
+    EXPECT_EQ(conn.m_total_sent_failure, total_sent_failure + 2);
+}
+TEST_F(MockLog, addCommandsRedis) {
+    uint64_t total_sent_cnt = 3;
+    uint64_t total_sent_failure = 5;
+
+    auto mock_net = std::make_unique<MockNetClass>();
+    MockNetClass* p = mock_net.get();
+
+    RedisServerConnection conn("127.0.0.1", 1234, std::move(mock_net));
+    conn.m_total_sent_cnt = total_sent_cnt;
+    conn.m_total_sent_failure = total_sent_failure;
+
+    RespBuffer batch;
+    batch.appendCommand("get", "key1");
+    batch.appendCommand("expire", "key1", 60);
+
+    std::vector<std::string> sent;
+    EXPECT_CALL(*p, redisAsyncFormattedCommand)
+        .Times(2)
+        .WillRepeatedly([&sent](redisAsyncContext*, redisCallbackFn*, void*, const char* cmd, size_t len) {
+            sent.emplace_back(cmd, len);
+            return REDIS_OK;
+        });
+
+    conn.addCommands(batch);
+
+    ASSERT_EQ(sent.size(), 2);
+    EXPECT_EQ(sent[0], "*2\r\n$3\r\nget\r\n$4\r\nkey1\r\n");
+    EXPECT_EQ(sent[1], "*3\r\n$6\r\nexpire\r\n$4\r\nkey1\r\n$2\r\n60\r\n");
+    EXPECT_EQ(conn.m_total_sent_cnt, total_sent_cnt + 2);
+    EXPECT_EQ(conn.m_total_sent_failure, total_sent_failure);
+}
+
+// metrics
+TEST_F(MockLog, metricsTrackBatchReplies) {
+    auto mock_net = std::make_unique<MockNetClass>();
+    MockNetClass* p = mock_net.get();
+    MetricsRegistry registry;
+
+    RedisServerConnection conn("127.0.0.1", 1234, std::move(mock_net));
+    conn.enableMetrics(registry, {{"server", "127.0.0.1:1234"}});
+    Histogram& reply_time = registry.histogram("weir_redis_batch_reply_seconds", "", LATENCY_BUCKETS,
+                                               {{"server", "127.0.0.1:1234"}});
+
+    RespBuffer batch;
+    batch.appendCommand("get", "key1");
+    batch.appendCommand("get", "key2");
+    EXPECT_CALL(*p, redisAsyncFormattedCommand).Times(2).WillRepeatedly(testing::Return(REDIS_OK));
+    conn.addCommands(batch);
+
+    redisAsyncContext rac;
+    rac.data = static_cast<RedisServerConnection*>(&conn);
+    redisReply r;
+    r.type = REDIS_REPLY_INTEGER;
+
+    // the batch is only answered once its last reply arrives
+    conn.replyCallback(&rac, &r, nullptr);
+    EXPECT_EQ(reply_time.count(), 0);
+    conn.replyCallback(&rac, &r, nullptr);
+    EXPECT_EQ(reply_time.count(), 1);
+    EXPECT_TRUE(conn.m_inflight_batches.empty());
+
+    // traced events are acknowledged along with the batch carrying them
+    Histogram& ack_latency = registry.histogram("weir_redis_trace_ack_latency_seconds", "", TRACE_LATENCY_BUCKETS,
+                                                {{"server", "127.0.0.1:1234"}});
+    RespBuffer traced_batch;
+    traced_batch.appendCommand("get", "key3");
+    EXPECT_CALL(*p, redisAsyncFormattedCommand).WillOnce(testing::Return(REDIS_OK));
+    conn.addCommands(traced_batch, {monotonicMicros() - 3000, monotonicMicros() - 1000});
+    conn.replyCallback(&rac, &r, nullptr);
+    EXPECT_EQ(ack_latency.count(), 2);
+    EXPECT_GE(ack_latency.sum(), 0.004);
+
+    conn.publishMetrics();
+    EXPECT_EQ(registry.counter("weir_redis_commands_sent_total", "", {{"server", "127.0.0.1:1234"}}).value(), 3);
+    EXPECT_EQ(registry.counter("weir_redis_replies_total", "", {{"server", "127.0.0.1:1234"}}).value(), 3);
+    EXPECT_EQ(registry.gauge("weir_redis_pending_replies", "", {{"server", "127.0.0.1:1234"}}).value(), 0);
+}
+
 } // namespace test
 } // namespace syslogsrv
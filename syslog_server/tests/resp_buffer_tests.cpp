@@ -0,0 +1,54 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <gtest/gtest.h>
+#include <limits>
+#include <string>
+
+#include "resp_buffer.h"
+
+namespace syslogsrv {
+namespace test {
+
+TEST(resp_buffer, serializes_string_and_integer_arguments) {
+    RespBuffer buffer;
+    const std::string key = "verb_1_user_a$dev";
+    buffer.appendCommand("hincrby", key, std::string_view("GET"), -12);
+
+    EXPECT_EQ(buffer.commandCount(), 1);
+    EXPECT_EQ(buffer.data(), "*4\r\n$7\r\nhincrby\r\n$17\r\nverb_1_user_a$dev\r\n$3\r\nGET\r\n$3\r\n-12\r\n");
+}
+
+TEST(resp_buffer, serializes_empty_and_large_arguments) {
+    RespBuffer buffer;
+    buffer.appendCommand("set", "", std::numeric_limits<int64_t>::min());
+
+    EXPECT_EQ(buffer.data(), "*3\r\n$3\r\nset\r\n$0\r\n\r\n$20\r\n-9223372036854775808\r\n");
+}
+
+TEST(resp_buffer, commands_are_stored_back_to_back) {
+    RespBuffer buffer;
+    EXPECT_TRUE(buffer.empty());
+    buffer.appendCommand("get", "a");
+    buffer.appendCommand("expire", "a", 60);
+
+    ASSERT_EQ(buffer.commandCount(), 2);
+    EXPECT_EQ(buffer.command(0), "*2\r\n$3\r\nget\r\n$1\r\na\r\n");
+    EXPECT_EQ(buffer.command(1), "*3\r\n$6\r\nexpire\r\n$1\r\na\r\n$2\r\n60\r\n");
+    EXPECT_EQ(buffer.data(), std::string(buffer.command(0)) + std::string(buffer.command(1)));
+}
+
+TEST(resp_buffer, clear_removes_all_commands) {
+    RespBuffer buffer;
+    buffer.appendCommand("get", "a");
+    buffer.clear();
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.data(), "");
+
+    buffer.appendCommand("get", "b");
+    ASSERT_EQ(buffer.commandCount(), 1);
+    EXPECT_EQ(buffer.command(0), "*2\r\n$3\r\nget\r\n$1\r\nb\r\n");
+}
+
+} // namespace test
+} // namespace syslogsrv
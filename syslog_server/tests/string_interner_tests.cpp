@@ -0,0 +1,72 @@
+// Copyright 2024 Bloomberg Finance L.P.
+// Distributed under the terms of the Apache 2.0 license.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "string_interner.h"
+
+namespace syslogsrv {
+namespace test {
+
+TEST(string_interner, same_string_gets_same_id) {
+    StringInterner interner(10);
+    const auto get = interner.intern("GET");
+    const auto put = interner.intern("PUT");
+    EXPECT_NE(get, put);
+    EXPECT_EQ(interner.intern(std::string("GET")), get);
+    EXPECT_EQ(interner.lookup(get), "GET");
+    EXPECT_EQ(interner.lookup(put), "PUT");
+    EXPECT_EQ(interner.size(), 2);
+}
+
+TEST(string_interner, lookups_survive_growth) {
+    StringInterner interner(10);
+    const auto first = interner.intern("a string that is too long for the small string optimisation");
+    for (int i = 0; i < 10000; ++i) {
+        interner.intern(std::to_string(i));
+    }
+    EXPECT_EQ(interner.lookup(first), "a string that is too long for the small string optimisation");
+    EXPECT_EQ(interner.intern("1234"), interner.intern(std::string("1234")));
+    EXPECT_EQ(interner.lookup(interner.intern("1234")), "1234");
+}
+
+TEST(string_interner, evicts_idle_strings) {
+    StringInterner interner(2);
+    const auto idle = interner.intern("idle");
+    const auto busy = interner.intern("busy");
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_EQ(interner.intern("busy"), busy);
+        interner.endPeriod();
+    }
+    EXPECT_EQ(interner.size(), 1);
+    EXPECT_EQ(interner.lookup(busy), "busy");
+
+    // the evicted id is reused
+    EXPECT_EQ(interner.intern("new"), idle);
+    EXPECT_EQ(interner.lookup(idle), "new");
+}
+
+TEST(string_interner, touched_strings_are_kept) {
+    StringInterner interner(1);
+    const auto id = interner.intern("kept");
+    for (int i = 0; i < 5; ++i) {
+        interner.touch(id);
+        interner.endPeriod();
+    }
+    EXPECT_EQ(interner.size(), 1);
+    EXPECT_EQ(interner.intern("kept"), id);
+}
+
+TEST(string_interner, strings_used_in_the_last_period_are_kept) {
+    StringInterner interner(1);
+    const auto id = interner.intern("recent");
+    EXPECT_TRUE(interner.endPeriod().empty());
+    EXPECT_EQ(interner.size(), 1);
+    EXPECT_EQ(interner.endPeriod(), std::vector<StringInterner::Id>{id});
+    EXPECT_EQ(interner.size(), 0);
+}
+
+} // namespace test
+} // namespace syslogsrv
@@ -1,9 +1,18 @@
 // Copyright 2024 Bloomberg Finance L.P.
 // Distributed under the terms of the Apache 2.0 license.
 
+#include <binary_event.h>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <io_uring_receiver.h>
+#include <netinet/in.h>
+#include <recv_batch.h>
+#include <spdlog/sinks/null_sink.h>
 #include <string>
 #include <syslog_server.h>
+#include <thread>
+#include <unistd.h>
 
 #include "test_common.h"
 
@@ -17,7 +26,9 @@ class MockSysCallClass : public SystemInterface {
     MOCK_METHOD(int, setsockopt, (int, int, int, const void*, socklen_t), (override));
     MOCK_METHOD(int, bind, (int, const struct sockaddr*, socklen_t), (override));
     MOCK_METHOD(ssize_t, recvfrom, (int, void*, size_t, int, struct sockaddr*, socklen_t*), (override));
+    MOCK_METHOD(int, recvmmsg, (int, mmsghdr*, unsigned int, int, timespec*), (override));
     MOCK_METHOD(std::string, getRmemMaxPath, (), (override));
+    MOCK_METHOD(bool, ioUringAvailable, (), (override));
 };
 
 // getRmemMax
@@ -166,5 +177,317 @@ TEST_F(MockLog, createSocketFailBind) {
         << "the last log line is: " << line << std::endl;
 }
 
+// RecvBatch
+TEST(RecvBatchTest, ReceivesMultipleDatagramsPerCall) {
+    MockSysCallClass mock_sys_call;
+    RecvBatch batch(4, 16);
+    EXPECT_CALL(mock_sys_call, recvmmsg(7, testing::_, 4, MSG_WAITFORONE, nullptr))
+        .WillOnce([](int, mmsghdr* msgvec, unsigned int, int, timespec*) {
+            const char* msgs[] = {"first", "second"};
+            for (int i = 0; i < 2; ++i) {
+                memcpy(msgvec[i].msg_hdr.msg_iov[0].iov_base, msgs[i], strlen(msgs[i]));
+                msgvec[i].msg_len = strlen(msgs[i]);
+                msgvec[i].msg_hdr.msg_flags = 0;
+            }
+            return 2;
+        });
+
+    EXPECT_EQ(batch.receive(7, mock_sys_call), 2);
+    EXPECT_EQ(batch.datagram(0), "first");
+    EXPECT_EQ(batch.datagram(1), "second");
+    EXPECT_FALSE(batch.truncated(0));
+    EXPECT_FALSE(batch.truncated(1));
+}
+TEST(RecvBatchTest, FlagsTruncatedDatagrams) {
+    MockSysCallClass mock_sys_call;
+    RecvBatch batch(2, 4);
+    EXPECT_CALL(mock_sys_call, recvmmsg).WillOnce([](int, mmsghdr* msgvec, unsigned int vlen, int, timespec*) {
+        EXPECT_EQ(msgvec[0].msg_hdr.msg_iov[0].iov_len, 4);
+        memcpy(msgvec[0].msg_hdr.msg_iov[0].iov_base, "abcd", 4);
+        msgvec[0].msg_len = 4;
+        msgvec[0].msg_hdr.msg_flags = MSG_TRUNC;
+        return 1;
+    });
+
+    EXPECT_EQ(batch.receive(1, mock_sys_call), 1);
+    EXPECT_EQ(batch.datagram(0), "abcd");
+    EXPECT_TRUE(batch.truncated(0));
+}
+TEST(RecvBatchTest, SlotsDoNotOverlap) {
+    RecvBatch batch(3, 8);
+    EXPECT_EQ(batch.batchSize(), 3);
+    EXPECT_EQ(batch.slotSize(), 8);
+    EXPECT_EQ(batch.datagram(1).data() - batch.datagram(0).data(), 8);
+    EXPECT_EQ(batch.datagram(2).data() - batch.datagram(1).data(), 8);
+}
+
+// selectRecvBackend
+TEST_F(MockLog, selectRecvBackendSocket) {
+    MockSysCallClass mock_sys_call;
+    EXPECT_CALL(mock_sys_call, ioUringAvailable).Times(0);
+
+    EXPECT_EQ(selectRecvBackend("socket", 1, mock_sys_call), RecvBackend::RecvFrom);
+    EXPECT_EQ(selectRecvBackend("socket", 64, mock_sys_call), RecvBackend::RecvMmsg);
+}
+TEST_F(MockLog, selectRecvBackendIoUring) {
+    MockSysCallClass mock_sys_call;
+    EXPECT_CALL(mock_sys_call, ioUringAvailable).WillOnce(testing::Return(true));
+
+    EXPECT_EQ(selectRecvBackend("io_uring", 1, mock_sys_call), RecvBackend::IoUring);
+}
+TEST_F(MockLog, selectRecvBackendIoUringUnavailable) {
+    MockSysCallClass mock_sys_call;
+    EXPECT_CALL(mock_sys_call, ioUringAvailable).WillRepeatedly(testing::Return(false));
+
+    EXPECT_EQ(selectRecvBackend("io_uring", 1, mock_sys_call), RecvBackend::RecvFrom);
+    EXPECT_EQ(selectRecvBackend("io_uring", 64, mock_sys_call), RecvBackend::RecvMmsg);
+}
+TEST_F(MockLog, selectRecvBackendUnknown) {
+    MockSysCallClass mock_sys_call;
+    EXPECT_EQ(selectRecvBackend("carrier_pigeon", 1, mock_sys_call), RecvBackend::RecvFrom);
+
+    auto logger = spdlog::get(SERVER_NAME);
+    logger->flush();
+    std::ifstream log(MOCK_LOG);
+    std::string line;
+    std::getline(log, line);
+
+    EXPECT_TRUE(line.find("Unknown receive backend 'carrier_pigeon'") != std::string::npos);
+}
+
+// IoUringReceiver
+namespace {
+
+// Builds with io_uring are tested with WEIR_SYSLOGSRV_REQUIRE_IO_URING set, so that its tests fail rather than skip
+bool ioUringRequired() {
+    const char* required = std::getenv("WEIR_SYSLOGSRV_REQUIRE_IO_URING");
+    return (required != nullptr) && (std::string_view(required) != "0");
+}
+
+} // namespace
+
+TEST(IoUringReceiverTest, RoundsBufferCountToPowerOfTwo) {
+    EXPECT_EQ(IoUringReceiver(100, 16).bufferCount(), 128);
+    EXPECT_EQ(IoUringReceiver(0, 16).bufferCount(), 1);
+    EXPECT_EQ(IoUringReceiver(1000000, 16).bufferCount(), 32768);
+    EXPECT_EQ(IoUringReceiver(4, 16).bufferSize(), 16);
+}
+TEST(IoUringReceiverTest, ReceivesDatagramsOverLoopback) {
+    if (!ioUringSupported()) {
+        ASSERT_FALSE(ioUringRequired()) << "io_uring is not available";
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    const int recv_sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const int send_sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ASSERT_GE(recv_sock, 0);
+    ASSERT_GE(send_sock, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(::bind(recv_sock, (sockaddr*)&addr, addr_len), 0);
+    ASSERT_EQ(::getsockname(recv_sock, (sockaddr*)&addr, &addr_len), 0);
+
+    IoUringReceiver receiver(4, 8);
+    if (!receiver.start(recv_sock)) {
+        ASSERT_FALSE(ioUringRequired()) << "io_uring receives could not be set up: " << strerror(errno);
+        GTEST_SKIP() << "io_uring receives could not be set up: " << strerror(errno);
+    }
+
+    const std::string msgs[] = {"first", "second", "too long for it"};
+    for (const auto& msg : msgs) {
+        ASSERT_EQ(::sendto(send_sock, msg.data(), msg.size(), 0, (sockaddr*)&addr, addr_len), msg.size());
+    }
+
+    std::vector<std::pair<std::string, bool>> received;
+    const auto handler = [&](std::string_view datagram, bool truncated) {
+        received.emplace_back(std::string(datagram), truncated);
+    };
+    while (received.size() < 3) {
+        ASSERT_GE(receiver.receive(handler), 0);
+    }
+    EXPECT_EQ(received[0], std::make_pair(std::string("first"), false));
+    EXPECT_EQ(received[1], std::make_pair(std::string("second"), false));
+    EXPECT_TRUE(received[2].second);
+
+    ::close(send_sock);
+    ::close(recv_sock);
+}
+TEST(IoUringReceiverTest, DrainLosesNoDatagrams) {
+    if (!ioUringSupported()) {
+        ASSERT_FALSE(ioUringRequired()) << "io_uring is not available";
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    const int recv_sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const int send_sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ASSERT_GE(recv_sock, 0);
+    ASSERT_GE(send_sock, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(::bind(recv_sock, (sockaddr*)&addr, addr_len), 0);
+    ASSERT_EQ(::getsockname(recv_sock, (sockaddr*)&addr, &addr_len), 0);
+
+    IoUringReceiver receiver(4, 8);
+    if (!receiver.start(recv_sock)) {
+        ASSERT_FALSE(ioUringRequired()) << "io_uring receives could not be set up: " << strerror(errno);
+        GTEST_SKIP() << "io_uring receives could not be set up: " << strerror(errno);
+    }
+
+    const std::string msgs[] = {"first", "second", "third"};
+    for (const auto& msg : msgs) {
+        ASSERT_EQ(::sendto(send_sock, msg.data(), msg.size(), 0, (sockaddr*)&addr, addr_len), msg.size());
+    }
+
+    // Whatever the receive didn't get to before being cancelled is left on the socket
+    std::vector<std::string> received;
+    const auto handler = [&](std::string_view datagram, bool) { received.emplace_back(datagram); };
+    ASSERT_GE(receiver.drain(handler), 0);
+    char buffer[8];
+    ssize_t len;
+    while ((len = ::recv(recv_sock, buffer, sizeof(buffer), MSG_DONTWAIT)) >= 0) {
+        received.emplace_back(buffer, len);
+    }
+    EXPECT_EQ(received, std::vector<std::string>(std::begin(msgs), std::end(msgs)));
+
+    ::close(send_sock);
+    ::close(recv_sock);
+}
+
+// setIncomingCpu
+TEST_F(MockLog, setIncomingCpuSetsSocketOption) {
+    MockSysCallClass mock_sys_call;
+    EXPECT_CALL(mock_sys_call, setsockopt(3, SOL_SOCKET, SO_INCOMING_CPU, testing::_, sizeof(int)))
+        .WillOnce([](int, int, int, const void* optval, socklen_t) {
+            EXPECT_EQ(*static_cast<const int*>(optval), 5);
+            return 0;
+        });
+    setIncomingCpu(3, 5, mock_sys_call);
+}
+
+TEST_F(MockLog, setIncomingCpuFailureIsNotFatal) {
+    MockSysCallClass mock_sys_call;
+    EXPECT_CALL(mock_sys_call, setsockopt).WillOnce(testing::Return(-1));
+    setIncomingCpu(3, 5, mock_sys_call);
+
+    auto logger = spdlog::get(SERVER_NAME);
+    logger->flush();
+    std::ifstream log(MOCK_LOG);
+    std::string line;
+    std::getline(log, line);
+    EXPECT_TRUE(line.find("setsockopt SO_INCOMING_CPU failed") != std::string::npos);
+}
+
+// configuredCpuSet
+TEST_F(MockLog, configuredCpuSetPicksTheWorkersEntry) {
+    const YAML::Node config = YAML::Load("{ cpu_affinity: ['0-1', '4'] }");
+    EXPECT_EQ(configuredCpuSet(config, 0), CpuSet({0, 1}));
+    EXPECT_EQ(configuredCpuSet(config, 1), CpuSet({4}));
+    EXPECT_EQ(configuredCpuSet(config, 2), CpuSet({0, 1}));
+}
+
+TEST_F(MockLog, configuredCpuSetWithoutAffinity) {
+    EXPECT_FALSE(configuredCpuSet(YAML::Load("{ port: 1 }"), 0));
+    EXPECT_FALSE(configuredCpuSet(YAML::Load("{ cpu_affinity: '0-1' }"), 0));
+    EXPECT_FALSE(configuredCpuSet(YAML::Load("{ cpu_affinity: ['1-0'] }"), 0));
+}
+
+// dispatchDatagram
+TEST_F(MockLog, dispatchDatagramQueuesControlMessages) {
+    auto logger = spdlog::get(SERVER_NAME);
+    spdlog::logger access_logger("test_access_log", std::make_shared<spdlog::sinks::null_sink_mt>());
+    PartitionedMessageQueue queues(1, 4);
+
+    EXPECT_EQ(dispatchDatagram("<134>Jan  1 00:00:00 haproxy[1]: req~|~1.2.3.4:1~|~KEY~|~GET~|~dwn~|~inst~|~1~|~\n",
+                               queues, *logger, access_logger),
+              DispatchResult::Queued);
+    EXPECT_EQ(dispatchDatagram("{\"json\": \"access log\"}", queues, *logger, access_logger),
+              DispatchResult::AccessLog);
+    EXPECT_EQ(dispatchDatagram("\n", queues, *logger, access_logger), DispatchResult::Logged);
+
+    MessageQueue& queue = queues.partition(0);
+    QueuedMessage msg;
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.view(), "req~|~1.2.3.4:1~|~KEY~|~GET~|~dwn~|~inst~|~1~|~");
+    EXPECT_FALSE(queue.tryDequeue(msg));
+}
+
+TEST_F(MockLog, dispatchDatagramReportsDroppedMessages) {
+    auto logger = spdlog::get(SERVER_NAME);
+    spdlog::logger access_logger("test_access_log", std::make_shared<spdlog::sinks::null_sink_mt>());
+    PartitionedMessageQueue queues(1, 1, 40);
+
+    EXPECT_EQ(dispatchDatagram("data_xfer~|~1.2.3.4:1~|~KEY~|~dwn~|~10", queues, *logger, access_logger),
+              DispatchResult::Queued);
+    EXPECT_EQ(dispatchDatagram("data_xfer~|~1.2.3.4:1~|~KEY~|~dwn~|~20", queues, *logger, access_logger),
+              DispatchResult::QueueFull);
+    EXPECT_EQ(dispatchDatagram("data_xfer~|~1.2.3.4:1~|~A_MUCH_LONGER_KEY~|~dwn~|~10", queues, *logger,
+                               access_logger),
+              DispatchResult::TooBig);
+}
+
+TEST_F(MockLog, dispatchDatagramQueuesBinaryRecords) {
+    auto logger = spdlog::get(SERVER_NAME);
+    spdlog::logger access_logger("test_access_log", std::make_shared<spdlog::sinks::null_sink_mt>());
+    PartitionedMessageQueue queues(1, 4);
+
+    // a record ending in a newline byte, which mustn't be stripped as it would be from text
+    const std::string record = encodeBinaryRecord(BINARY_TYPE_DATA_XFER, 0, '\n', {"KEY"}, '\n');
+    EXPECT_EQ(dispatchDatagram(record, queues, *logger, access_logger), DispatchResult::Queued);
+    EXPECT_EQ(dispatchDatagram(encodeBinaryRecord(9, 0, 1, {"KEY"}), queues, *logger, access_logger),
+              DispatchResult::Logged);
+
+    MessageQueue& queue = queues.partition(0);
+    QueuedMessage msg;
+    ASSERT_TRUE(queue.tryDequeue(msg));
+    EXPECT_EQ(msg.m_type, EventType::DataXfer);
+    EXPECT_EQ(msg.view(), record);
+    EXPECT_FALSE(queue.tryDequeue(msg));
+}
+
+TEST_F(MockLog, dispatchDatagramPartitionsMessagesByUser) {
+    auto logger = spdlog::get(SERVER_NAME);
+    spdlog::logger access_logger("test_access_log", std::make_shared<spdlog::sinks::null_sink_mt>());
+    PartitionedMessageQueue queues(4, 16);
+
+    for (const std::string user : {"KEY0", "KEY1", "KEY2", "KEY3", "KEY4", "KEY5"}) {
+        dispatchDatagram("haproxy[1]: req~|~1.2.3.4:1~|~" + user + "~|~GET~|~dwn~|~inst~|~1~|~", queues, *logger,
+                         access_logger);
+        dispatchDatagram("haproxy[1]: data_xfer~|~1.2.3.4:1~|~" + user + "~|~dwn~|~10", queues, *logger,
+                         access_logger);
+        dispatchDatagram("haproxy[1]: active_reqs~|~inst~|~" + user + "~|~dwn~|~1", queues, *logger, access_logger);
+        dispatchDatagram(encodeBinaryRecord(BINARY_TYPE_DATA_XFER, 0, 10, {user}), queues, *logger, access_logger);
+    }
+    EXPECT_EQ(queues.sizeApprox(), 24);
+
+    // every event of a user ends up in that user's queue
+    for (size_t i = 0; i < queues.partitionCount(); ++i) {
+        MessageQueue& queue = queues.partition(i);
+        QueuedMessage msg;
+        while (queue.tryDequeue(msg)) {
+            const std::string_view user =
+                isBinaryEvent(msg.view()) ? classifyBinaryEvent(msg.view()).m_user_key : eventUserKey(msg.view());
+            EXPECT_EQ(&queues.partitionFor(user), &queue) << user;
+        }
+    }
+}
+
+TEST(ServerStartupTest, WaitsForEveryServerToReceive) {
+    ServerStartup startup(2);
+    std::jthread first([&] { startup.receiving(); });
+    std::jthread second([&] { startup.receiving(); });
+    EXPECT_TRUE(startup.wait());
+}
+
+TEST(ServerStartupTest, FailsIfAnyServerFails) {
+    ServerStartup startup(2);
+    std::jthread first([&] { startup.receiving(); });
+    std::jthread second([&] { startup.failed(); });
+    EXPECT_FALSE(startup.wait());
+}
+
 } // namespace test
 } // namespace syslogsrv